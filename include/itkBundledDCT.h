@@ -0,0 +1,436 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkBundledDCT_h
+#define itkBundledDCT_h
+
+#include "itkMultiThreader.h"
+#include "itkThreadedRangeLoop.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace itk
+{
+
+/** \class BundledDCT
+ *  \ingroup ITKPhase
+ * \brief Header-only, multithreaded real-to-real DCT, used when FFTW is not.
+ *
+ * Computes the same unnormalized transforms as FFTW's REDFT10 (DCT-II, the
+ * forward transform of DCTImageFilter) and REDFT01 (DCT-III, the reverse
+ * transform), so that Forward followed by Reverse scales the data by
+ * DCTImageFilter::GetNormalizationFactor() whichever backend is used.
+ *
+ * A multidimensional transform is computed one axis at a time.  Each line
+ * along an axis is reordered and passed through a complex FFT of the same
+ * length (Makhoul's algorithm), and the lines are split across the threads.
+ * The FFT is a mixed radix Cooley-Tukey with butterflies for radices 2 and 4
+ * and a generic butterfly for the remaining factors, so any length may be
+ * transformed, but lengths with large prime factors cost in proportion to
+ * those factors.  DCTImageFilter::GetEfficientSize() gives the sizes this
+ * class, like FFTW, transforms fastest.
+ *
+ * The layout arguments of Transform() are those of
+ * DCTImageFilter::TransformBatch().
+ *
+ * [1] "A fast cosine transform in one and two dimensions" by John Makhoul,
+ * IEEE Transactions on Acoustics, Speech and Signal Processing 28(1), 1980.
+ */
+template< typename TPixel >
+class BundledDCT
+{
+public:
+
+  typedef TPixel                  PixelType;
+  typedef std::complex< TPixel >  ComplexType;
+
+  /** Transform numberOfTransforms arrays of rank dimensions with the given
+   * size (fastest axis first).  Array t starts at t*distance, and consecutive
+   * elements of an array are stride apart.  If in == out the transform is
+   * computed in place. */
+  static void Transform( unsigned int rank,
+                         const SizeValueType * size,
+                         SizeValueType numberOfTransforms,
+                         SizeValueType stride,
+                         SizeValueType distance,
+                         const PixelType * in,
+                         PixelType * out,
+                         bool reverse,
+                         int numberOfThreads )
+    {
+
+    const ThreadIdType threads = ( numberOfThreads > 1 ) ? numberOfThreads : 1;
+    MultiThreader::Pointer threader = MultiThreader::New();
+
+    SizeValueType numberOfElements = 1;
+    for (unsigned int d = 0; d < rank; ++d)
+      {
+      numberOfElements *= size[d];
+      }
+    if ( 0 == numberOfElements || 0 == numberOfTransforms )
+      {
+      return;
+      }
+
+    // The first axis reads the input and later axes transform the output
+    // in place, since every pass visits each element exactly once.
+    const PixelType * source = in;
+    SizeValueType step = 1;
+    for (unsigned int d = 0; d < rank; ++d)
+      {
+
+      const Plan plan( size[d] );
+
+      LineFunctor functor;
+      functor.LinePlan = &plan;
+      functor.In = source;
+      functor.Out = out;
+      functor.Rank = rank;
+      functor.Axis = d;
+      functor.Size = size;
+      functor.LinesPerTransform = numberOfElements / size[d];
+      functor.Step = step * stride;
+      functor.Stride = stride;
+      functor.Distance = distance;
+      functor.Reverse = reverse;
+
+      ThreadedRangeLoop< LineFunctor >::Run( threader,
+                                             threads,
+                                             numberOfTransforms * functor.LinesPerTransform,
+                                             functor );
+
+      source = out;
+      step *= size[d];
+
+      }
+
+    }
+
+private:
+
+  typedef BundledDCT Self;
+
+  // Factors and twiddles for a complex FFT of length N, and the quarter
+  // sample shifts of the DCT
+  struct Plan
+    {
+    explicit Plan( SizeValueType n ) :
+      N(n)
+      {
+
+      SizeValueType remainder = n;
+      SizeValueType p = 4;
+      while ( remainder > 1 )
+        {
+        while ( remainder % p )
+          {
+          p = ( 4 == p ) ? 2 : ( 2 == p ) ? 3 : p + 2;
+          if ( p * p > remainder )
+            {
+            p = remainder;
+            }
+          }
+        remainder /= p;
+        this->Factors.push_back( p );
+        this->Factors.push_back( remainder );
+        }
+
+      // Evaluated in long double, so float twiddles are correctly rounded
+      const long double pi = 3.141592653589793238462643383279502884L;
+      this->Twiddles.resize( n );
+      this->Shifts.resize( n );
+      for (SizeValueType k = 0; k < n; ++k)
+        {
+        const long double a = -2 * pi * k / n;
+        const long double b = -pi * k / ( 2 * n );
+        this->Twiddles[k] = ComplexType( static_cast< PixelType >( std::cos( a ) ),
+                                         static_cast< PixelType >( std::sin( a ) ) );
+        this->Shifts[k] = ComplexType( static_cast< PixelType >( std::cos( b ) ),
+                                       static_cast< PixelType >( std::sin( b ) ) );
+        }
+
+      }
+
+    SizeValueType                  N;
+    std::vector< SizeValueType >   Factors;  // (radix, remaining length) pairs
+    std::vector< ComplexType >     Twiddles; // exp(-2 pi i k / N)
+    std::vector< ComplexType >     Shifts;   // exp(-pi i k / 2N)
+    };
+
+  // Transforms the lines [first, last) along one axis of the batch
+  struct LineFunctor
+    {
+    void operator()( SizeValueType first, SizeValueType last ) const
+      {
+
+      const SizeValueType n = this->LinePlan->N;
+      std::vector< PixelType >   line( n );
+      std::vector< ComplexType > v( n );
+      std::vector< ComplexType > V( n );
+      std::vector< ComplexType > scratch( this->LargestFactor() );
+
+      for (SizeValueType l = first; l < last; ++l)
+        {
+
+        // Offset of the line: its transform, then its index on the other axes
+        SizeValueType remainder = l % this->LinesPerTransform;
+        SizeValueType offset = ( l / this->LinesPerTransform ) * this->Distance;
+        SizeValueType axisStep = this->Stride;
+        for (unsigned int e = 0; e < this->Rank; ++e)
+          {
+          if ( e != this->Axis )
+            {
+            offset += ( remainder % this->Size[e] ) * axisStep;
+            remainder /= this->Size[e];
+            }
+          axisStep *= this->Size[e];
+          }
+
+        for (SizeValueType j = 0; j < n; ++j)
+          {
+          line[j] = this->In[offset + j * this->Step];
+          }
+
+        if ( this->Reverse )
+          {
+          Self::TransformLineReverse( *this->LinePlan, &line[0], &v[0], &V[0], &scratch[0] );
+          }
+        else
+          {
+          Self::TransformLineForward( *this->LinePlan, &line[0], &v[0], &V[0], &scratch[0] );
+          }
+
+        for (SizeValueType j = 0; j < n; ++j)
+          {
+          this->Out[offset + j * this->Step] = line[j];
+          }
+
+        }
+
+      }
+
+    SizeValueType LargestFactor() const
+      {
+      SizeValueType largest = 1;
+      for (size_t f = 0; f < this->LinePlan->Factors.size(); f += 2)
+        {
+        largest = std::max( largest, this->LinePlan->Factors[f] );
+        }
+      return largest;
+      }
+
+    const Plan *          LinePlan;
+    const PixelType *     In;
+    PixelType *           Out;
+    unsigned int          Rank;
+    unsigned int          Axis;
+    const SizeValueType * Size;
+    SizeValueType         LinesPerTransform;
+    SizeValueType         Step;     // between elements of a line
+    SizeValueType         Stride;   // between elements of an array
+    SizeValueType         Distance; // between arrays
+    bool                  Reverse;
+    };
+
+  // REDFT10: y_k = 2 sum_j x_j cos(pi (2j+1) k / 2N).  The even samples,
+  // followed by the odd samples reversed, are transformed, and each
+  // coefficient is shifted by a quarter sample.
+  static void TransformLineForward( const Plan & plan,
+                                    PixelType * x,
+                                    ComplexType * v,
+                                    ComplexType * V,
+                                    ComplexType * scratch )
+    {
+
+    const SizeValueType n = plan.N;
+    if ( 1 == n )
+      {
+      x[0] *= 2;
+      return;
+      }
+
+    for (SizeValueType j = 0; 2 * j < n; ++j)
+      {
+      v[j] = x[2 * j];
+      }
+    for (SizeValueType j = 0; 2 * j + 1 < n; ++j)
+      {
+      v[n - 1 - j] = x[2 * j + 1];
+      }
+
+    Self::FFT( plan, V, v, 1, &plan.Factors[0], scratch );
+
+    for (SizeValueType k = 0; k < n; ++k)
+      {
+      x[k] = 2 * std::real( plan.Shifts[k] * V[k] );
+      }
+
+    }
+
+  // REDFT01: y_k = x_0 + 2 sum_{j>0} x_j cos(pi j (2k+1) / 2N), which is 2N
+  // times the inverse of REDFT10.  The spectrum of the reordered samples is
+  // rebuilt from x_k and x_{N-k}, and inverted by conjugating a forward FFT.
+  static void TransformLineReverse( const Plan & plan,
+                                    PixelType * x,
+                                    ComplexType * v,
+                                    ComplexType * V,
+                                    ComplexType * scratch )
+    {
+
+    const SizeValueType n = plan.N;
+    if ( 1 == n )
+      {
+      return;
+      }
+
+    v[0] = ComplexType( x[0], 0 );
+    for (SizeValueType k = 1; k < n; ++k)
+      {
+      // conj( conj(shift) (x_k - i x_{N-k}) )
+      v[k] = plan.Shifts[k] * ComplexType( x[k], x[n - k] );
+      }
+
+    Self::FFT( plan, V, v, 1, &plan.Factors[0], scratch );
+
+    for (SizeValueType j = 0; 2 * j < n; ++j)
+      {
+      x[2 * j] = std::real( V[j] );
+      }
+    for (SizeValueType j = 0; 2 * j + 1 < n; ++j)
+      {
+      x[2 * j + 1] = std::real( V[n - 1 - j] );
+      }
+
+    }
+
+  // Forward complex FFT of f (elements fstride apart) into out, recursing
+  // over the factors of the length
+  static void FFT( const Plan & plan,
+                   ComplexType * out,
+                   const ComplexType * f,
+                   SizeValueType fstride,
+                   const SizeValueType * factors,
+                   ComplexType * scratch )
+    {
+
+    const SizeValueType p = factors[0];
+    const SizeValueType m = factors[1];
+    ComplexType * const begin = out;
+    ComplexType * const end = out + p * m;
+
+    if ( 1 == m )
+      {
+      for (; out != end; ++out, f += fstride)
+        {
+        *out = *f;
+        }
+      }
+    else
+      {
+      for (; out != end; out += m, f += fstride)
+        {
+        Self::FFT( plan, out, f, fstride * p, factors + 2, scratch );
+        }
+      }
+
+    switch ( p )
+      {
+      case 2:
+        Self::Butterfly2( plan, begin, fstride, m );
+        break;
+      case 4:
+        Self::Butterfly4( plan, begin, fstride, m );
+        break;
+      default:
+        Self::ButterflyGeneric( plan, begin, fstride, m, p, scratch );
+        break;
+      }
+
+    }
+
+  static void Butterfly2( const Plan & plan, ComplexType * out, SizeValueType fstride, SizeValueType m )
+    {
+    for (SizeValueType k = 0; k < m; ++k)
+      {
+      const ComplexType t = out[m + k] * plan.Twiddles[k * fstride];
+      out[m + k] = out[k] - t;
+      out[k] += t;
+      }
+    }
+
+  static void Butterfly4( const Plan & plan, ComplexType * out, SizeValueType fstride, SizeValueType m )
+    {
+    for (SizeValueType k = 0; k < m; ++k)
+      {
+      const ComplexType s0 = out[k + m] * plan.Twiddles[k * fstride];
+      const ComplexType s1 = out[k + 2 * m] * plan.Twiddles[2 * k * fstride];
+      const ComplexType s2 = out[k + 3 * m] * plan.Twiddles[3 * k * fstride];
+      const ComplexType s3 = s0 + s2;
+      const ComplexType s4 = s0 - s2;
+      const ComplexType s5 = out[k] - s1;
+      const ComplexType s6 = out[k] + s1;
+      // -i s4
+      const ComplexType r( std::imag( s4 ), -std::real( s4 ) );
+      out[k] = s6 + s3;
+      out[k + 2 * m] = s6 - s3;
+      out[k + m] = s5 + r;
+      out[k + 3 * m] = s5 - r;
+      }
+    }
+
+  static void ButterflyGeneric( const Plan & plan,
+                                ComplexType * out,
+                                SizeValueType fstride,
+                                SizeValueType m,
+                                SizeValueType p,
+                                ComplexType * scratch )
+    {
+    const SizeValueType n = plan.N;
+    for (SizeValueType u = 0; u < m; ++u)
+      {
+      for (SizeValueType q = 0; q < p; ++q)
+        {
+        scratch[q] = out[u + q * m];
+        }
+      for (SizeValueType q = 0; q < p; ++q)
+        {
+        const SizeValueType k = u + q * m;
+        const SizeValueType increment = ( fstride * k ) % n;
+        SizeValueType t = 0;
+        ComplexType sum = scratch[0];
+        for (SizeValueType r = 1; r < p; ++r)
+          {
+          t += increment;
+          if ( t >= n )
+            {
+            t -= n;
+            }
+          sum += scratch[r] * plan.Twiddles[t];
+          }
+        out[k] = sum;
+        }
+      }
+    }
+
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,141 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkDCTBackend_h
+#define itkDCTBackend_h
+
+#include "itkPhaseConfigure.h"
+#include "itkMacro.h"
+#include "itksys/SystemTools.hxx"
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+#include "itkFFTWGlobalConfiguration.h"
+#endif
+#include <string>
+
+namespace itk
+{
+
+/** \class DCTBackend
+ *  \ingroup ITKPhase
+ * \brief Process-wide selection of the library which computes the DCTs.
+ *
+ * Every DCT of this module is computed by DCTImageFilter::TransformBatch(),
+ * which calls either FFTW or BundledDCT, the header-only transform shipped
+ * with the module.  The default is configured by the CMake variable
+ * ITKPhase_DCT_BACKEND, may be overridden by the environment variable of the
+ * same name ("FFTW" or "Bundled"), which is read on first use, and may be
+ * changed at run time with SetBackend().  Like the plan rigor of
+ * FFTWGlobalConfiguration, the setting applies to all filters, and should not
+ * be changed while a filter is updating.
+ *
+ * FFTW is used only for the precisions ITK was built with (ITK_USE_FFTWF for
+ * float, ITK_USE_FFTWD for double, and ITKPhase_USE_FFTWL for long double);
+ * other pixel types are always transformed by BundledDCT.  If ITK was built
+ * without FFTW, BundledDCT is used throughout, and the plan rigor of the DCT
+ * filters is ignored.
+ */
+class DCTBackend
+{
+public:
+
+  typedef enum { FFTW=0, Bundled=1 } BackendEnumType;
+
+  static BackendEnumType GetBackend()
+    {
+    return Self::Backend();
+    }
+
+  static void SetBackend( BackendEnumType backend )
+    {
+    Self::Backend() = backend;
+    }
+
+  /** Whether ITK provides FFTW in float or double precision. */
+  static bool IsFFTWAvailable()
+    {
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+    return true;
+#else
+    return false;
+#endif
+    }
+
+  static const char * GetBackendName( BackendEnumType backend )
+    {
+    return ( FFTW == backend ) ? "FFTW" : "Bundled";
+    }
+
+  /** Default plan rigor of the DCT filters: that of FFTWGlobalConfiguration,
+   * or 0 without FFTW. */
+  static int GetPlanRigor()
+    {
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+    return FFTWGlobalConfiguration::GetPlanRigor();
+#else
+    return 0;
+#endif
+    }
+
+  static std::string GetPlanRigorName( int planRigor )
+    {
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+    return FFTWGlobalConfiguration::GetPlanRigorName( planRigor );
+#else
+    (void) planRigor;
+    return "Unused";
+#endif
+    }
+
+private:
+
+  typedef DCTBackend Self;
+
+  static BackendEnumType & Backend()
+    {
+    static BackendEnumType backend = Self::InitialBackend();
+    return backend;
+    }
+
+  static BackendEnumType InitialBackend()
+    {
+#if defined(ITKPhase_DCT_BACKEND_BUNDLED)
+    BackendEnumType backend = Bundled;
+#else
+    BackendEnumType backend = FFTW;
+#endif
+    std::string name;
+    if ( itksys::SystemTools::GetEnv( "ITKPhase_DCT_BACKEND", name ) )
+      {
+      name = itksys::SystemTools::UpperCase( name );
+      if ( "FFTW" == name )
+        {
+        backend = FFTW;
+        }
+      else if ( "BUNDLED" == name )
+        {
+        backend = Bundled;
+        }
+      }
+    return backend;
+    }
+
+};
+
+} // end namespace itk
+
+#endif
@@ -19,16 +19,13 @@
 #ifndef itkDCTImageFilter_h 
 #define itkDCTImageFilter_h 
 
-#include "itkFFTWGlobalConfiguration.h"
-#ifndef ITK_USE_FFTWD
-#error "itkDCTImageFilter.h is dependent upon the double precision fftw library.  In order to use this filter, please rebuild itk, setting the cmake variable ITK_USE_FFTWD to ON."
-#endif
-
+#include "itkDCTBackend.h"
+#include "itkBundledDCT.h"
+#include "itkFFTWDCTCommon.h"
 #include "itkImage.h" // Common
-#include "itkImageToImageFilter.h" // Common
-#include "itkDivideImageFilter.h" // ImageIntensity 
+#include "itkInPlaceImageFilter.h" // Common
 #include "itkConceptChecking.h" // Common
-#include <fftw3.h>
+#include "itkFFTWDCTPlanCache.h"
 
 namespace itk {
 
@@ -36,16 +33,53 @@ namespace itk {
  *  \ingroup ITKPhase
  * \brief Calculates discrete cosine transform of an image.
  *
- * This class makes use of the FFTW library's real to real transform.
- * Please ensure that ITK was built with USE_FFTWD before using this class.
- * USE_FFTWD can be turned on as an advanced option during the CMake configuration
- * of the ITK library, prior to the build.
+ * The transform is computed by one of two backends, selected process-wide
+ * through DCTBackend: the FFTW library's real to real transform, or
+ * BundledDCT, a header-only implementation shipped with this module which
+ * needs no external library.  Both operate directly on the image buffer, in
+ * the precision of the pixel type.  With FFTW, float images use fftwf, double
+ * images use fftw and long double images use fftwl, which requires ITK to be
+ * built with USE_FFTWF and/or USE_FFTWD (as appropriate), and long double
+ * additionally requires this module to be configured with ITKPhase_USE_FFTWL.
+ * Precisions which FFTW does not provide are transformed by BundledDCT, as is
+ * everything when ITK was built without FFTW.  The backend default is
+ * configured by the CMake variable ITKPhase_DCT_BACKEND.
  *
  * Currently, the forward transform uses FFTW_REDFT10, and the reverse transform
  * uses FFTW_REDFT01.  In the future, the filter could be extended to allow for
  * FFTW_REDFT11 and FFTW_REDFT00, as well as odd transforms.  Note that these may
  * require different normalization procedures for the reverse transform.
  *
+ * The reverse transform is normalized to the logical (reflected) array size,
+ * NUMPIX*2^Dimension, by scaling the output buffer in place.  Callers which
+ * already make a pass over the data (e.g. a spectral step) may turn
+ * normalization off and fold the factor into that pass instead.
+ *
+ * The filter may run in place (see InPlaceImageFilter), in which case the
+ * output buffer aliases the input buffer and no output image is allocated.
+ * In-place operation is off by default, since the input is overwritten.
+ *
+ * With FFTW, the planner rigor may be raised from the FFTW_ESTIMATE default through
+ * SetPlanRigor().  Expensive plans can be saved to and restored from a wisdom
+ * file with ExportWisdomFile() and ImportWisdomFile(), or automatically through
+ * the wisdom cache settings of FFTWGlobalConfiguration.
+ *
+ * The transform is multithreaded by the backend using GetNumberOfThreads() threads,
+ * which defaults to MultiThreader::GetGlobalDefaultNumberOfThreads().  Filters
+ * which contain a DCTImageFilter forward their own number of threads to it.
+ *
+ * With BatchAlongLastAxis on, the last axis of the image indexes a series of
+ * same-sized frames (e.g. the time points of a 4D acquisition or the echoes of
+ * a multi-echo stack), and each frame is transformed independently over the
+ * remaining axes in one call (with FFTW, one fftw_plan_many_r2r plan).  The
+ * normalization then excludes the last axis.  TransformBatch() also accepts
+ * interleaved layouts, such as the components of a VectorImage buffer.
+ *
+ * FFTW plans are obtained from the process-wide FFTWDCTPlanCache, so repeated updates
+ * on images of the same size (and by other instances of this filter) do not
+ * re-plan the transform.  Use FFTWDCTPlanCache::Clear() or
+ * FFTWDCTPlanCache::SetMaximumNumberOfPlans() to release or bound the plans.
+ *
  * Note also that the licensing for FFTW differs from that of ITK.  Filters making
  * use of the FFTW library must conform to the General Public License (GPL).  Please
  * consult http://www.fftw.org/ for documentation of the DCT as well as for
@@ -55,16 +89,21 @@ namespace itk {
 
 template < typename TInputImage, typename TOutputImage = TInputImage > 
 class DCTImageFilter : 
-public ImageToImageFilter< TInputImage, TOutputImage > 
+public InPlaceImageFilter< TInputImage, TOutputImage > 
 { 
 public: 
 
   //  Standard declarations 
   typedef DCTImageFilter                                  Self; 
-  typedef ImageToImageFilter< TInputImage, TOutputImage > Superclass; 
+  typedef InPlaceImageFilter< TInputImage, TOutputImage > Superclass; 
   typedef SmartPointer<Self>                              Pointer; 
   typedef SmartPointer<const Self>                        ConstPointer; 
 
+  typedef typename TInputImage::PixelType                 PixelType;
+  typedef typename TInputImage::SizeType                  SizeType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TInputImage::ImageDimension);
+
   // Transform DIRECTION
   typedef  enum { Forward=0, Reverse=1 } TransformDirectionEnumType;
   
@@ -79,17 +118,89 @@ public:
                    
   itkConceptMacro( OutputFloatingPointCheck,
                    ( Concept::IsFloatingPoint< typename TOutputImage::PixelType > ) );
+
+  // FFTW transforms between buffers of a single precision.
+  itkConceptMacro( SamePixelTypeCheck,
+                   ( Concept::SameType< typename TInputImage::PixelType,
+                   typename TOutputImage::PixelType > ) );
   // End concept checking
 #endif
   
   itkSetMacro(TransformDirection, TransformDirectionEnumType);
   itkGetConstMacro(TransformDirection, TransformDirectionEnumType);
 
+  /** Set/Get whether the reverse transform is normalized (default true). */
+  itkSetMacro(Normalize, bool);
+  itkGetConstMacro(Normalize, bool);
+  itkBooleanMacro(Normalize);
+
+  /** Set/Get the FFTW planner rigor: FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT
+   * or FFTW_EXHAUSTIVE.  Defaults to DCTBackend::GetPlanRigor().  Ignored by
+   * BundledDCT. */
+  itkSetMacro(PlanRigor, int);
+  itkGetConstMacro(PlanRigor, int);
+
+  /** Set/Get whether the last axis indexes a batch of frames which are
+   * transformed independently.  Default is off. */
+  itkSetMacro(BatchAlongLastAxis, bool);
+  itkGetConstMacro(BatchAlongLastAxis, bool);
+  itkBooleanMacro(BatchAlongLastAxis);
+
+  /** Import/export FFTW wisdom from/to a file, so that plans measured with an
+   * expensive rigor may be reused by later processes.  Return true on success,
+   * and false if FFTW does not provide this precision. */
+  static bool ImportWisdomFile( const std::string & path );
+  static bool ExportWisdomFile( const std::string & path );
+
+  /** Backend which transforms this pixel type: DCTBackend::GetBackend(),
+   * unless that is FFTW and FFTW does not provide this precision. */
+  static DCTBackend::BackendEnumType GetBackend();
+
+  /** Transform a buffer laid out as an image of the given size, without the
+   * pipeline.  If in == out the transform is computed in place.  The reverse
+   * transform is not normalized; see GetNormalizationFactor().  This allows
+   * filters which own their buffers (e.g. DCTPoissonSolverImageFilter) to
+   * chain transforms without intermediate images. */
+  static void TransformBuffer( const SizeType & size,
+                               PixelType * in,
+                               PixelType * out,
+                               TransformDirectionEnumType direction,
+                               int planRigor,
+                               int numberOfThreads,
+                               bool batchAlongLastAxis = false );
+
+  /** Transform numberOfTransforms arrays of rank dimensions with the given
+   * size (fastest axis first) through a single batched plan.  Array t starts
+   * at in + t*distance, and consecutive elements of an array are stride
+   * apart: a series of contiguous frames has stride 1 and distance equal to
+   * the frame size, and the components of a VectorImage have stride equal to
+   * the number of components and distance 1.  Not normalized. */
+  static void TransformBatch( unsigned int rank,
+                              const SizeValueType * size,
+                              SizeValueType numberOfTransforms,
+                              SizeValueType stride,
+                              SizeValueType distance,
+                              PixelType * in,
+                              PixelType * out,
+                              TransformDirectionEnumType direction,
+                              int planRigor,
+                              int numberOfThreads );
+
+  /** Factor by which Forward followed by Reverse scales the data: the
+   * logical (reflected) array size, NUMPIX*2^Dimension.  When batching along
+   * the last axis, that axis is excluded. */
+  static double GetNormalizationFactor( const SizeType & size, bool batchAlongLastAxis = false );
+
+  /** Smallest size, no smaller than size along any axis, whose extents have
+   * no prime factors other than 2, 3, 5 and 7.  FFTW transforms such sizes
+   * with its fastest algorithms; large prime factors are much slower. */
+  static SizeType GetEfficientSize( const SizeType & size );
+
   /** Method for creation through object factory */
   itkNewMacro(Self);
 
   /** Run-time type information */
-  itkTypeMacro(DCTImageFilter, ImageToImageFilter);
+  itkTypeMacro(DCTImageFilter, InPlaceImageFilter);
 
   /** Display */
   void PrintSelf( std::ostream& os, Indent indent ) const ITK_OVERRIDE;
@@ -102,8 +213,16 @@ protected:
   // Transform DIRECTION
   TransformDirectionEnumType m_TransformDirection;
 
-  //  Declare the component filter types:
-  typedef DivideImageFilter< TInputImage, TInputImage, TInputImage > DivideType;
+  // Normalize the reverse transform
+  bool m_Normalize;
+
+  // FFTW planner rigor
+  int m_PlanRigor;
+
+  // Transform each frame along the last axis independently
+  bool m_BatchAlongLastAxis;
+
+  typedef fftw::DCTProxy< PixelType >   FFTWProxyType;
         
   void GenerateData() ITK_OVERRIDE;
 
@@ -111,9 +230,32 @@ private:
 
   ITK_DISALLOW_COPY_AND_ASSIGN(DCTImageFilter);
 
-//  Component filters are declared as data members, all using the smart 
-//  pointer types.
-  typename DivideType::Pointer m_Divide = ITK_NULLPTR;
+  // Selects at compile time whether TransformBatchFFTW() calls FFTW or, for a
+  // precision which FFTW does not provide, BundledDCT
+  template< bool TFFTWAvailable > struct FFTWAvailability {};
+
+  static void TransformBatchFFTW( unsigned int rank,
+                                  const SizeValueType * size,
+                                  SizeValueType numberOfTransforms,
+                                  SizeValueType stride,
+                                  SizeValueType distance,
+                                  PixelType * in,
+                                  PixelType * out,
+                                  TransformDirectionEnumType direction,
+                                  int planRigor,
+                                  int numberOfThreads,
+                                  FFTWAvailability< true > );
+  static void TransformBatchFFTW( unsigned int rank,
+                                  const SizeValueType * size,
+                                  SizeValueType numberOfTransforms,
+                                  SizeValueType stride,
+                                  SizeValueType distance,
+                                  PixelType * in,
+                                  PixelType * out,
+                                  TransformDirectionEnumType direction,
+                                  int planRigor,
+                                  int numberOfThreads,
+                                  FFTWAvailability< false > );
 
 }; 
 
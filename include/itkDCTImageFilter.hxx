@@ -28,8 +28,28 @@ DCTImageFilter< TInputImage, TOutputImage >
 ::DCTImageFilter()
 :
 m_TransformDirection(Forward),
-m_Divide(DivideType::New())
-{} 
+m_Normalize(true),
+m_PlanRigor(DCTBackend::GetPlanRigor()),
+m_BatchAlongLastAxis(false)
+{
+  this->InPlaceOff();
+} 
+
+template < typename TInputImage, typename TOutputImage >
+bool
+DCTImageFilter< TInputImage, TOutputImage >
+::ImportWisdomFile( const std::string & path )
+{
+  return FFTWProxyType::ImportWisdomFile( path );
+}
+
+template < typename TInputImage, typename TOutputImage >
+bool
+DCTImageFilter< TInputImage, TOutputImage >
+::ExportWisdomFile( const std::string & path )
+{
+  return FFTWProxyType::ExportWisdomFile( path );
+}
 
 template < typename TInputImage, typename TOutputImage > 
 void 
@@ -39,59 +59,225 @@ DCTImageFilter< TInputImage, TOutputImage >
 
   // Configure the I/O
   typename TInputImage::ConstPointer input = this->GetInput();
-  typename TInputImage::Pointer output = this->GetOutput();
+  typename TOutputImage::Pointer output = this->GetOutput();
+
+  if ( this->m_BatchAlongLastAxis && ImageDimension < 2 )
+    {
+    itkExceptionMacro( "Batching along the last axis requires at least two dimensions." );
+    }
 
+  // When running in place, the output is grafted onto the input buffer.
   this->AllocateOutputs();
   
   const typename TInputImage::SizeValueType NUMPIX
     = input->GetLargestPossibleRegion().GetNumberOfPixels();
 
-  typename TInputImage::PixelType *in, *out;
-  in = (typename TInputImage::PixelType*)
-    fftw_malloc(sizeof(typename TInputImage::PixelType) * NUMPIX);
-  out = (typename TInputImage::PixelType*)
-    fftw_malloc(sizeof(typename TInputImage::PixelType) * NUMPIX);
+  // in == out when running in place, which selects an in-place plan.
+  PixelType * in = const_cast< PixelType * >( input->GetBufferPointer() );
+  PixelType * out = output->GetBufferPointer();
 
-  in = (typename TInputImage::PixelType*)input->GetBufferPointer();
-  out = (typename TInputImage::PixelType*)output->GetBufferPointer();
+  Self::TransformBuffer( input->GetLargestPossibleRegion().GetSize(),
+                         in,
+                         out,
+                         this->m_TransformDirection,
+                         this->m_PlanRigor,
+                         this->GetNumberOfThreads(),
+                         this->m_BatchAlongLastAxis );
+  
+  if (Reverse == this->m_TransformDirection && this->m_Normalize)
+    {
 
-  fftw_r2r_kind kind[TInputImage::ImageDimension];
-  int n[TInputImage::ImageDimension];
+    // Normalize to the LOGICAL array size.
+    const PixelType scale = static_cast< PixelType >(
+      1.0 / Self::GetNormalizationFactor( input->GetLargestPossibleRegion().GetSize(), this->m_BatchAlongLastAxis ) );
+    for (typename TInputImage::SizeValueType i = 0; i < NUMPIX; ++i)
+      {
+      out[i] *= scale;
+      }
+    
+    }
+
+} 
 
-  for (unsigned int d = 0; d < TInputImage::ImageDimension; ++d)
+template < typename TInputImage, typename TOutputImage > 
+void 
+DCTImageFilter< TInputImage, TOutputImage >
+::TransformBuffer( const SizeType & size,
+                   PixelType * in,
+                   PixelType * out,
+                   TransformDirectionEnumType direction,
+                   int planRigor,
+                   int numberOfThreads,
+                   bool batchAlongLastAxis )
+{
+
+  if ( !batchAlongLastAxis )
+    {
+    Self::TransformBatch( ImageDimension, size.GetSize(), 1, 1, 0,
+                          in, out, direction, planRigor, numberOfThreads );
+    return;
+    }
+
+  // Each frame along the last axis is contiguous
+  SizeValueType frame = 1;
+  for (unsigned int d = 0; d + 1 < ImageDimension; ++d)
+    {
+    frame *= size[d];
+    }
+  Self::TransformBatch( ImageDimension - 1, size.GetSize(), size[ImageDimension - 1], 1, frame,
+                        in, out, direction, planRigor, numberOfThreads );
+
+}
+
+template < typename TInputImage, typename TOutputImage > 
+void 
+DCTImageFilter< TInputImage, TOutputImage >
+::TransformBatch( unsigned int rank,
+                  const SizeValueType * size,
+                  SizeValueType numberOfTransforms,
+                  SizeValueType stride,
+                  SizeValueType distance,
+                  PixelType * in,
+                  PixelType * out,
+                  TransformDirectionEnumType direction,
+                  int planRigor,
+                  int numberOfThreads )
+{
+
+  if ( DCTBackend::FFTW == Self::GetBackend() )
+    {
+    Self::TransformBatchFFTW( rank, size, numberOfTransforms, stride, distance,
+                              in, out, direction, planRigor, numberOfThreads,
+                              FFTWAvailability< FFTWProxyType::IsAvailable >() );
+    return;
+    }
+
+  BundledDCT< PixelType >::Transform( rank, size, numberOfTransforms, stride, distance,
+                                      in, out, Reverse == direction, numberOfThreads );
+
+}
+
+template < typename TInputImage, typename TOutputImage > 
+DCTBackend::BackendEnumType
+DCTImageFilter< TInputImage, TOutputImage >
+::GetBackend()
+{
+  return FFTWProxyType::IsAvailable ? DCTBackend::GetBackend() : DCTBackend::Bundled;
+}
+
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+template < typename TInputImage, typename TOutputImage > 
+void 
+DCTImageFilter< TInputImage, TOutputImage >
+::TransformBatchFFTW( unsigned int rank,
+                      const SizeValueType * size,
+                      SizeValueType numberOfTransforms,
+                      SizeValueType stride,
+                      SizeValueType distance,
+                      PixelType * in,
+                      PixelType * out,
+                      TransformDirectionEnumType direction,
+                      int planRigor,
+                      int numberOfThreads,
+                      FFTWAvailability< true > )
+{
+
+  typedef FFTWDCTPlanCache< PixelType > PlanCacheType;
+
+  fftw_r2r_kind kind[ImageDimension];
+  int n[ImageDimension];
+
+  for (unsigned int d = 0; d < rank; ++d)
     {
 
     // Why is this backwards?  I thought that both c++ and fftw were row order.
-    n[TInputImage::ImageDimension - 1 - d] = input->GetLargestPossibleRegion().GetSize()[d];
-    kind[d] = (Reverse == this->m_TransformDirection) ? FFTW_REDFT01 : FFTW_REDFT10;
+    n[rank - 1 - d] = size[d];
+    kind[d] = (Reverse == direction) ? FFTW_REDFT01 : FFTW_REDFT10;
 
     }
 
-  fftw_plan p = fftw_plan_r2r( TInputImage::ImageDimension, // rank
-                               n, // pointer to array of rank integers
-                               in,
-                               out,
-                               kind,
-                               FFTW_ESTIMATE);
-  fftw_execute(p);
-  fftw_destroy_plan(p);
-  
-  if (Reverse == this->m_TransformDirection)
+  // Plans are shared through the cache, and executed on the current buffers.
+  // The proxy selects fftwf/fftw/fftwl to match PixelType.
+  typename PlanCacheType::PlanPointer p =
+    PlanCacheType::GetPlan( rank,
+                            n, // pointer to array of rank integers
+                            kind,
+                            in,
+                            out,
+                            planRigor,
+                            numberOfThreads,
+                            numberOfTransforms,
+                            stride,
+                            distance );
+  p->Execute( in, out );
+
+}
+#endif
+
+template < typename TInputImage, typename TOutputImage > 
+void 
+DCTImageFilter< TInputImage, TOutputImage >
+::TransformBatchFFTW( unsigned int rank,
+                      const SizeValueType * size,
+                      SizeValueType numberOfTransforms,
+                      SizeValueType stride,
+                      SizeValueType distance,
+                      PixelType * in,
+                      PixelType * out,
+                      TransformDirectionEnumType direction,
+                      int,
+                      int numberOfThreads,
+                      FFTWAvailability< false > )
+{
+  BundledDCT< PixelType >::Transform( rank, size, numberOfTransforms, stride, distance,
+                                      in, out, Reverse == direction, numberOfThreads );
+}
+
+template < typename TInputImage, typename TOutputImage > 
+typename DCTImageFilter< TInputImage, TOutputImage >::SizeType
+DCTImageFilter< TInputImage, TOutputImage >
+::GetEfficientSize( const SizeType & size )
+{
+
+  SizeType efficient;
+  for (unsigned int d = 0; d < ImageDimension; ++d)
     {
+    SizeValueType n = ( size[d] > 0 ) ? size[d] : 1;
+    for (;; ++n)
+      {
+      SizeValueType remainder = n;
+      while ( 0 == remainder % 2 ) remainder /= 2;
+      while ( 0 == remainder % 3 ) remainder /= 3;
+      while ( 0 == remainder % 5 ) remainder /= 5;
+      while ( 0 == remainder % 7 ) remainder /= 7;
+      if ( 1 == remainder )
+        {
+        break;
+        }
+      }
+    efficient[d] = n;
+    }
+  return efficient;
 
-    // Normalize to the LOGICAL array size.
-    // Since the logical array is reflected along each
-    // dimension, multiply NUMPIX by two^dimension. 
-    const double NORM = NUMPIX*pow(2, TInputImage::ImageDimension);
-
-    this->m_Divide->SetInput( output );
-    this->m_Divide->SetConstant( NORM );
-    this->m_Divide->Update();
-    this->GetOutput()->Graft( this->m_Divide->GetOutput() );
-    
+}
+
+template < typename TInputImage, typename TOutputImage > 
+double
+DCTImageFilter< TInputImage, TOutputImage >
+::GetNormalizationFactor( const SizeType & size, bool batchAlongLastAxis )
+{
+
+  // Since the logical array is reflected along each
+  // dimension, multiply NUMPIX by two^dimension. 
+  const unsigned int rank = batchAlongLastAxis ? ImageDimension - 1 : ImageDimension;
+  double NORM = 1.0;
+  for (unsigned int d = 0; d < rank; ++d)
+    {
+    NORM *= 2.0 * size[d];
     }
+  return NORM;
 
-} 
+}
 
 //  PrintSelf method prints parameters 
 
@@ -104,6 +290,10 @@ DCTImageFilter< TInputImage, TOutputImage >
   Superclass::PrintSelf(os,indent); 
 
   os << indent << "Transform Direction: " << m_TransformDirection << std::endl;
+  os << indent << "Normalize: " << m_Normalize << std::endl;
+  os << indent << "Backend: " << DCTBackend::GetBackendName( Self::GetBackend() ) << std::endl;
+  os << indent << "Plan Rigor: " << DCTBackend::GetPlanRigorName(m_PlanRigor) << std::endl;
+  os << indent << "Batch Along Last Axis: " << m_BatchAlongLastAxis << std::endl;
   
 }
 
@@ -0,0 +1,173 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkDCTOutOfCorePoissonSolverImageFilter_h
+#define itkDCTOutOfCorePoissonSolverImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkDCTImageFilter.h"
+#include "itkMemoryMappedScratchBuffer.h"
+#include "itkThreadedRangeLoop.h"
+#include <string>
+#include <vector>
+
+namespace itk {
+
+/** \class DCTOutOfCorePoissonSolverImageFilter
+ *  \ingroup ITKPhase
+ * \brief Solves the Poisson equation with the DCT for images larger than memory.
+ *
+ * Computes the same solution as DCTPoissonSolverImageFilter, but holds the
+ * spectrum in a memory-mapped scratch file (see MemoryMappedScratchBuffer) and
+ * works on it in pieces whose size is bounded by MemoryBudget:
+ *
+ * -# The input is streamed from the upstream pipeline in slabs along the last
+ *    axis; each slab is copied to the scratch file and transformed over the
+ *    remaining axes (one 2D transform per slice of a 3D volume).
+ * -# The scratch file is then traversed in tiles which span the whole last
+ *    axis: each tile is gathered into memory, transformed along the last axis,
+ *    divided by the eigenvalues of the Laplacian, inverse transformed and
+ *    scattered back.
+ * -# Each slab is inverse transformed over the remaining axes.
+ *
+ * The output may be streamed (e.g. by an ImageFileWriter with several stream
+ * divisions): the solution is computed once, on the first request, and each
+ * requested region is copied from the scratch file.  It is recomputed only
+ * when the filter or its upstream pipeline is modified.  The scratch file is
+ * created in ScratchDirectory, which defaults to TMPDIR (TEMP on Windows), and
+ * must have room for one pixel per input pixel.
+ *
+ * MemoryBudget bounds the memory used for the slabs and tiles, in bytes, not
+ * counting the requested output region.  A slab holds at least one slice, so
+ * the budget should allow two slices of the image.
+ *
+ * As in DCTPoissonSolverImageFilter, UseImageSpacing scales each axis by the
+ * inverse square of its spacing.
+ *
+ */
+
+template < typename TInputImage, typename TOutputImage = TInputImage >
+class DCTOutOfCorePoissonSolverImageFilter:
+public ImageToImageFilter< TInputImage, TOutputImage >
+{
+public:
+
+//  Standard declarations
+//  Used for object creation with the object factory:
+
+  typedef DCTOutOfCorePoissonSolverImageFilter            Self;
+  typedef ImageToImageFilter< TInputImage, TOutputImage > Superclass;
+  typedef SmartPointer<Self>                              Pointer;
+  typedef SmartPointer<const Self>                        ConstPointer;
+
+#ifdef ITK_USE_CONCEPT_CHECKING
+  // Begin concept checking
+  itkConceptMacro( SameDimensionCheck,
+                   ( Concept::SameDimension< TInputImage::ImageDimension, TOutputImage::ImageDimension > ) );
+
+  itkConceptMacro( InputFloatingPointCheck,
+                   ( Concept::IsFloatingPoint< typename TInputImage::PixelType > ) );
+
+  itkConceptMacro( SamePixelTypeCheck,
+                   ( Concept::SameType< typename TInputImage::PixelType,
+                   typename TOutputImage::PixelType > ) );
+  // End concept checking
+#endif
+
+  /** Method for creation through object factory */
+  itkNewMacro(Self);
+
+  /** Run-time type information */
+  itkTypeMacro(DCTOutOfCorePoissonSolverImageFilter, ImageToImageFilter);
+
+  /** Set/Get the memory used for slabs and tiles, in bytes.  Default is 1 GiB. */
+  itkSetMacro(MemoryBudget, SizeValueType);
+  itkGetConstMacro(MemoryBudget, SizeValueType);
+
+  /** Set/Get the directory for the scratch file.  Empty selects the default. */
+  itkSetStringMacro(ScratchDirectory);
+  itkGetStringMacro(ScratchDirectory);
+
+  /** Set/Get the FFTW planner rigor. */
+  itkSetMacro(PlanRigor, int);
+  itkGetConstMacro(PlanRigor, int);
+
+  /** Set/Get whether the Laplacian is in physical units.  Default is off. */
+  itkSetMacro(UseImageSpacing, bool);
+  itkGetConstMacro(UseImageSpacing, bool);
+  itkBooleanMacro(UseImageSpacing);
+
+  /** Display */
+  void PrintSelf( std::ostream& os, Indent indent ) const ITK_OVERRIDE;
+
+protected:
+
+  DCTOutOfCorePoissonSolverImageFilter();
+  ~DCTOutOfCorePoissonSolverImageFilter(){}
+
+  typedef typename TOutputImage::PixelType PixelType;
+  typedef typename TInputImage::SizeType   SizeType;
+  typedef typename TInputImage::RegionType RegionType;
+
+  /** The input is streamed by GenerateData(); only its first slice is
+   * requested through the pipeline. */
+  void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  void GenerateData() ITK_OVERRIDE;
+
+  /** Solve into the scratch file. */
+  void Solve();
+
+private:
+
+  ITK_DISALLOW_COPY_AND_ASSIGN(DCTOutOfCorePoissonSolverImageFilter);
+
+  typedef itk::DCTImageFilter< TInputImage >        DCTType;
+  typedef MemoryMappedScratchBuffer< PixelType >    ScratchType;
+
+  // Divides a tile, laid out with the last axis slowest, by the eigenvalues
+  struct TileDivideFunctor
+    {
+    void operator()( SizeValueType first, SizeValueType last ) const;
+
+    PixelType *    Tile;
+    SizeValueType  Width;
+    const double * PlaneEigenvalues;
+    const double * LastAxisEigenvalues;
+    bool           ContainsZeroFrequency;
+    };
+
+  SizeValueType m_MemoryBudget;
+  std::string   m_ScratchDirectory;
+  int           m_PlanRigor;
+  bool          m_UseImageSpacing;
+
+  // The solution, and the region and time it was computed for
+  typename ScratchType::Pointer m_Scratch;
+  RegionType                    m_SolutionRegion;
+  TimeStamp                     m_SolutionTime;
+
+};
+
+}
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkDCTOutOfCorePoissonSolverImageFilter.hxx"
+#endif
+
+#endif
@@ -0,0 +1,323 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkDCTOutOfCorePoissonSolverImageFilter_hxx
+#define itkDCTOutOfCorePoissonSolverImageFilter_hxx
+
+#include "itkDCTOutOfCorePoissonSolverImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageScanlineIterator.h"
+#include <algorithm>
+
+namespace itk
+{
+
+template < typename TInputImage, typename TOutputImage >
+DCTOutOfCorePoissonSolverImageFilter< TInputImage, TOutputImage >
+::DCTOutOfCorePoissonSolverImageFilter() :
+m_MemoryBudget(1024*1024*1024),
+m_PlanRigor(DCTBackend::GetPlanRigor()),
+m_UseImageSpacing(false)
+{}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTOutOfCorePoissonSolverImageFilter< TInputImage, TOutputImage >
+::GenerateInputRequestedRegion()
+{
+
+  Superclass::GenerateInputRequestedRegion();
+
+  TInputImage * input = const_cast< TInputImage * >( this->GetInput() );
+  if ( !input )
+    {
+    return;
+    }
+
+  RegionType region = input->GetLargestPossibleRegion();
+  region.SetSize( TInputImage::ImageDimension - 1, 1 );
+  input->SetRequestedRegion( region );
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTOutOfCorePoissonSolverImageFilter< TInputImage, TOutputImage >
+::GenerateData()
+{
+
+  const TInputImage * input = this->GetInput();
+  typename TOutputImage::Pointer output = this->GetOutput();
+
+  // Only the requested region of the output is allocated
+  this->AllocateOutputs();
+
+  // Solve unless the solution is current
+  const ModifiedTimeType inputTime = input->GetSource() ? input->GetPipelineMTime() : input->GetMTime();
+  if ( this->m_Scratch.IsNull()
+       || this->m_SolutionRegion != input->GetLargestPossibleRegion()
+       || this->m_SolutionTime < this->GetMTime()
+       || this->m_SolutionTime < inputTime )
+    {
+    this->Solve();
+    }
+
+  // Copy the requested region from the scratch file
+  const RegionType largest = this->m_SolutionRegion;
+  const PixelType * solution = this->m_Scratch->GetBufferPointer();
+
+  SizeValueType first = this->m_Scratch->GetNumberOfPixels();
+  SizeValueType last = 0;
+
+  ImageScanlineIterator< TOutputImage > it( output, output->GetRequestedRegion() );
+  while ( !it.IsAtEnd() )
+    {
+    const typename TOutputImage::IndexType index = it.GetIndex();
+    SizeValueType offset = 0;
+    SizeValueType stride = 1;
+    for (unsigned int d = 0; d < TOutputImage::ImageDimension; ++d)
+      {
+      offset += ( index[d] - largest.GetIndex()[d] ) * stride;
+      stride *= largest.GetSize()[d];
+      }
+    first = std::min( first, offset );
+
+    while ( !it.IsAtEndOfLine() )
+      {
+      it.Set( solution[offset++] );
+      ++it;
+      }
+    last = std::max( last, offset );
+
+    it.NextLine();
+    }
+
+  if ( first < last )
+    {
+    this->m_Scratch->Release( first, last - first );
+    }
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTOutOfCorePoissonSolverImageFilter< TInputImage, TOutputImage >
+::Solve()
+{
+
+  TInputImage * input = const_cast< TInputImage * >( this->GetInput() );
+
+  const unsigned int LAST = TInputImage::ImageDimension - 1;
+  const RegionType largest = input->GetLargestPossibleRegion();
+  const SizeType size = largest.GetSize();
+  const int threads = this->GetNumberOfThreads();
+
+  // Pixels per slice, and slices along the last axis
+  SizeValueType plane = 1;
+  for (unsigned int d = 0; d < LAST; ++d)
+    {
+    plane *= size[d];
+    }
+  const SizeValueType depth = size[LAST];
+
+  // Half of the budget for a slab of slices (the upstream output and its copy)
+  // or for a tile (the tile and its eigenvalues)
+  const SizeValueType half = this->m_MemoryBudget / 2;
+
+  SizeValueType slabDepth = half / ( plane * sizeof( PixelType ) );
+  if ( slabDepth < 1 )
+    {
+    itkWarningMacro( "The memory budget of " << this->m_MemoryBudget
+                     << " bytes is smaller than two slices of the image; one slice is used." );
+    slabDepth = 1;
+    }
+  slabDepth = std::min( slabDepth, depth );
+
+  SizeValueType tileWidth = half / ( depth * sizeof( PixelType ) + sizeof( double ) );
+  tileWidth = std::max( tileWidth, static_cast< SizeValueType >( 1 ) );
+  tileWidth = std::min( tileWidth, plane );
+
+  // Per-axis eigenvalues of the Laplacian, scaled by the normalization
+  // See equation 5.60, p. 200
+  const double NORM = DCTType::GetNormalizationFactor( size );
+  std::vector< double > tables[TInputImage::ImageDimension];
+  for (unsigned int d = 0; d < TInputImage::ImageDimension; ++d)
+    {
+    double scale = NORM;
+    if ( this->m_UseImageSpacing )
+      {
+      scale /= input->GetSpacing()[d] * input->GetSpacing()[d];
+      }
+    tables[d].resize( size[d] );
+    for (SizeValueType k = 0; k < size[d]; ++k)
+      {
+      tables[d][k] = ( 2*std::cos( vnl_math::pi * k / size[d] ) - 2 ) * scale;
+      }
+    }
+
+  this->m_Scratch = ScratchType::New();
+  this->m_Scratch->Allocate( plane * depth, this->m_ScratchDirectory );
+  PixelType * data = this->m_Scratch->GetBufferPointer();
+
+  // 1. Stream the input in slabs, transforming each slice
+  for (SizeValueType z0 = 0; z0 < depth; z0 += slabDepth)
+    {
+
+    const SizeValueType dz = std::min( slabDepth, depth - z0 );
+
+    RegionType slab = largest;
+    slab.SetIndex( LAST, largest.GetIndex()[LAST] + z0 );
+    slab.SetSize( LAST, dz );
+
+    input->SetRequestedRegion( slab );
+    input->PropagateRequestedRegion();
+    input->UpdateOutputData();
+
+    PixelType * p = data + z0 * plane;
+    ImageRegionConstIterator< TInputImage > it( input, slab );
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+      {
+      *p++ = it.Get();
+      }
+
+    if ( LAST > 0 )
+      {
+      DCTType::TransformBatch( LAST, size.GetSize(), dz, 1, plane,
+                               data + z0 * plane, data + z0 * plane,
+                               DCTType::Forward, this->m_PlanRigor, threads );
+      }
+
+    this->m_Scratch->Release( z0 * plane, dz * plane );
+
+    }
+
+  // 2. Transform along the last axis and divide, in tiles of the slice
+  std::vector< PixelType > tile( tileWidth * depth );
+  std::vector< double > planeEigenvalues( tileWidth );
+
+  for (SizeValueType p0 = 0; p0 < plane; p0 += tileWidth)
+    {
+
+    const SizeValueType dp = std::min( tileWidth, plane - p0 );
+
+    for (SizeValueType z = 0; z < depth; ++z)
+      {
+      std::copy( data + z * plane + p0, data + z * plane + p0 + dp, &tile[z * dp] );
+      }
+
+    DCTType::TransformBatch( 1, &depth, dp, dp, 1,
+                             &tile[0], &tile[0],
+                             DCTType::Forward, this->m_PlanRigor, threads );
+
+    // Sum of the eigenvalues of the other axes for each pixel of the tile
+    for (SizeValueType p = 0; p < dp; ++p)
+      {
+      SizeValueType remainder = p0 + p;
+      planeEigenvalues[p] = 0.0;
+      for (unsigned int d = 0; d < LAST; ++d)
+        {
+        planeEigenvalues[p] += tables[d][remainder % size[d]];
+        remainder /= size[d];
+        }
+      }
+
+    TileDivideFunctor divide;
+    divide.Tile = &tile[0];
+    divide.Width = dp;
+    divide.PlaneEigenvalues = &planeEigenvalues[0];
+    divide.LastAxisEigenvalues = &tables[LAST][0];
+    divide.ContainsZeroFrequency = ( 0 == p0 );
+    ThreadedRangeLoop< TileDivideFunctor >::Run( this->GetMultiThreader(), threads, depth, divide );
+
+    DCTType::TransformBatch( 1, &depth, dp, dp, 1,
+                             &tile[0], &tile[0],
+                             DCTType::Reverse, this->m_PlanRigor, threads );
+
+    for (SizeValueType z = 0; z < depth; ++z)
+      {
+      std::copy( &tile[z * dp], &tile[z * dp] + dp, data + z * plane + p0 );
+      }
+    this->m_Scratch->Release( p0, dp, plane, depth );
+
+    }
+
+  // 3. Inverse transform each slab over the remaining axes
+  if ( LAST > 0 )
+    {
+    for (SizeValueType z0 = 0; z0 < depth; z0 += slabDepth)
+      {
+      const SizeValueType dz = std::min( slabDepth, depth - z0 );
+      DCTType::TransformBatch( LAST, size.GetSize(), dz, 1, plane,
+                               data + z0 * plane, data + z0 * plane,
+                               DCTType::Reverse, this->m_PlanRigor, threads );
+      this->m_Scratch->Release( z0 * plane, dz * plane );
+      }
+    }
+
+  this->m_SolutionRegion = largest;
+  this->m_SolutionTime.Modified();
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTOutOfCorePoissonSolverImageFilter< TInputImage, TOutputImage >
+::TileDivideFunctor
+::operator()( SizeValueType first, SizeValueType last ) const
+{
+
+  for (SizeValueType z = first; z < last; ++z)
+    {
+
+    PixelType * p = this->Tile + z * this->Width;
+    const double base = this->LastAxisEigenvalues[z];
+
+    // The zero frequency is undetermined; set it to "0"
+    SizeValueType start = 0;
+    if ( 0 == z && this->ContainsZeroFrequency )
+      {
+      p[0] = 0;
+      start = 1;
+      }
+
+    for (SizeValueType i = start; i < this->Width; ++i)
+      {
+      p[i] = static_cast< PixelType >( p[i] / ( base + this->PlaneEigenvalues[i] ) );
+      }
+
+    }
+
+}
+
+//  PrintSelf method prints parameters
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTOutOfCorePoissonSolverImageFilter< TInputImage, TOutputImage >
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf(os,indent);
+
+  os << indent << "Memory Budget: " << m_MemoryBudget << std::endl;
+  os << indent << "Scratch Directory: " << m_ScratchDirectory << std::endl;
+  os << indent << "Plan Rigor: " << DCTBackend::GetPlanRigorName(m_PlanRigor) << std::endl;
+  os << indent << "Use Image Spacing: " << (m_UseImageSpacing ? "On" : "Off") << std::endl;
+}
+
+} /* end namespace itk */
+
+#endif
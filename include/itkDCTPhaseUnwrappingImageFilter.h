@@ -21,9 +21,14 @@
 
 #include "itkPhaseImageToImageFilter.h"
 #include "itkWrappedPhaseLaplacianImageFilter.h"
-#include "itkStatisticsImageFilter.h"
-#include "itkSubtractImageFilter.h"
 #include "itkDCTPoissonSolverImageFilter.h"
+#include "itkDCTOutOfCorePoissonSolverImageFilter.h"
+#include "itkMultigridPoissonSolverImageFilter.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkResampleImageFilter.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkNearestNeighborExtrapolateImageFunction.h"
+#include <vector>
 
 namespace itk {
 
@@ -32,10 +37,50 @@ namespace itk {
  * \brief Calculates calculates the L2-norm unwrapped phase.
  *
  * This filter uses the discrete cosine transform to calculate the L2-norm
- * unwrapped phase.  The DCT is computed using the FFTW library.  There are no restrictions
+ * unwrapped phase.  The DCT is computed by DCTImageFilter, with FFTW or BundledDCT
+ * (see DCTBackend).  There are no restrictions
  * on the dimensions of the input image.  The filter assumes a phase image wrapped into
  * the range of -pi to pi.  Output is not congruent with the input phase.
  *
+ * The mean of the wrapped Laplacian is not subtracted explicitly: it only
+ * contributes to the zero frequency term, which the Poisson solver sets to
+ * zero, so the solution is the same.
+ *
+ * For volumes larger than memory, set a nonzero MemoryBudget: the Poisson
+ * equation is then solved out of core by DCTOutOfCorePoissonSolverImageFilter,
+ * the input is streamed from the upstream pipeline in slabs, and the output
+ * may be streamed to disk.  PadToEfficientSize is ignored in that mode, and
+ * BatchAlongLastAxis is not supported.
+ *
+ * Setting PoissonSolver to MultigridSolver solves the same equation in memory
+ * by MultigridPoissonSolverImageFilter instead of the DCT, which agrees with it
+ * to within the multigrid tolerance.  The FFTW options are then ignored.
+ *
+ * When a mask is set, the equation is solved only over the bounding box of
+ * the mask, padded by MaskMargin pixels, which saves the transforms of the
+ * background.  The Laplacian is not weighted, so the pixels of the box outside
+ * the mask still take part in the solve, but they are set to zero in the
+ * output, as is everything outside the box.
+ *
+ * With NumberOfLevels greater than one, the unwrap is progressive.  The
+ * wrapped phase is downsampled by two along each axis, level by level, by
+ * averaging exp(i phi) over each block, and the coarsest level is solved
+ * first.  At each finer level, the upsampled coarser solution u is refined by
+ * solving for wrap(phi - u), and the sum is made congruent with the wrapped
+ * phase of that level.  After each level but the finest, an IterationEvent is
+ * invoked; GetPreview() then returns the current solution, upsampled to the
+ * full size and made congruent with the input.  An observer may call
+ * StopRefinement(), and the preview becomes the output.  The progressive
+ * output is congruent with the input.
+ *
+ * With NumberOfCongruentIterations above zero, the solution u is refined by
+ * u += unwrap(wrap(phi - u)), reusing the same buffers and transform plans.
+ * After each step u is rounded to the nearest value congruent with phi, and
+ * iteration stops once no more than ChangedPixelsThreshold pixels change
+ * their multiple of 2 pi.  The rounded solution is the output.  (Rounding
+ * first would leave nothing to unwrap, since the wrapped residual of a
+ * congruent solution is zero.)
+ *
  */
 
 template < typename TInputImage, typename TOutputImage = TInputImage >
@@ -51,6 +96,8 @@ public:
   typedef PhaseImageToImageFilter< TInputImage, TOutputImage > Superclass;
   typedef SmartPointer<Self>                                   Pointer;
   typedef SmartPointer<const Self>                             ConstPointer;
+
+  typedef enum {DCTSolver=0, MultigridSolver} PoissonSolverEnumType;
   
 #ifdef ITK_USE_CONCEPT_CHECKING
   // Begin concept checking
@@ -72,6 +119,92 @@ public:
   /** Run-time type information */
   itkTypeMacro(DCTPhaseUnwrappingImageFilter, PhaseImageToImageFilter);
 
+  /** Set/Get the Poisson solver.  Default is DCTSolver. */
+  itkSetMacro(PoissonSolver, PoissonSolverEnumType);
+  itkGetConstMacro(PoissonSolver, PoissonSolverEnumType);
+
+  /** Set/Get the FFTW planner rigor passed to the underlying DCTImageFilter. */
+  itkSetMacro(PlanRigor, int);
+  itkGetConstMacro(PlanRigor, int);
+
+  /** Set/Get whether the Poisson solve is padded to an FFT friendly size.
+   * See DCTPoissonSolverImageFilter::SetPadToEfficientSize(). */
+  itkSetMacro(PadToEfficientSize, bool);
+  itkGetConstMacro(PadToEfficientSize, bool);
+  itkBooleanMacro(PadToEfficientSize);
+
+  /** Set/Get whether the last axis indexes a series of independent frames
+   * (e.g. the echoes of a multi-echo stack) which are unwrapped in one pass.
+   * Default is off. */
+  itkSetMacro(BatchAlongLastAxis, bool);
+  itkGetConstMacro(BatchAlongLastAxis, bool);
+  itkBooleanMacro(BatchAlongLastAxis);
+
+  typedef typename Superclass::MaskImageType MaskImageType;
+
+  /** Set/Get an optional mask of the pixels to unwrap. */
+  void SetMaskImage( const MaskImageType * mask )
+    {
+    this->SetNthInput( 1, const_cast< MaskImageType * >( mask ) );
+    }
+  const MaskImageType * GetMaskImage() const
+    {
+    return dynamic_cast< const MaskImageType * >( this->ProcessObject::GetInput( 1 ) );
+    }
+
+  /** Set/Get the number of pixels by which the bounding box of the mask is
+   * padded.  Default is 2. */
+  itkSetMacro(MaskMargin, SizeValueType);
+  itkGetConstMacro(MaskMargin, SizeValueType);
+
+  /** Set/Get the maximum number of levels of a progressive unwrap.  Levels
+   * stop before an axis would fall below 4 pixels.  Default is 1, which
+   * solves at full resolution only. */
+  itkSetMacro(NumberOfLevels, unsigned int);
+  itkGetConstMacro(NumberOfLevels, unsigned int);
+
+  /** The level being refined, zero being the full resolution.  Valid during
+   * an IterationEvent. */
+  itkGetConstMacro(CurrentLevel, unsigned int);
+
+  /** The solution of the current level at full resolution.  Valid during an
+   * IterationEvent. */
+  const TInputImage * GetPreview() const
+    {
+    return this->m_Preview.GetPointer();
+    }
+
+  /** Called from an IterationEvent observer, ends a progressive unwrap with
+   * the current preview as the output. */
+  void StopRefinement()
+    {
+    this->m_RefinementStopped = true;
+    }
+
+  /** Set/Get the maximum number of congruent refinement iterations.  Default
+   * is 0, which returns the least squares solution. */
+  itkSetMacro(NumberOfCongruentIterations, unsigned int);
+  itkGetConstMacro(NumberOfCongruentIterations, unsigned int);
+
+  /** Set/Get the number of changed pixels at or below which the congruent
+   * refinement stops.  Default is 0. */
+  itkSetMacro(ChangedPixelsThreshold, SizeValueType);
+  itkGetConstMacro(ChangedPixelsThreshold, SizeValueType);
+
+  /** The congruent iterations run, and the pixels changed by the last of
+   * them, in the last Update(). */
+  itkGetConstMacro(ElapsedCongruentIterations, unsigned int);
+  itkGetConstMacro(NumberOfChangedPixels, SizeValueType);
+
+  /** Set/Get the memory budget, in bytes, for an out-of-core solve.  Zero
+   * (the default) solves in memory. */
+  itkSetMacro(MemoryBudget, SizeValueType);
+  itkGetConstMacro(MemoryBudget, SizeValueType);
+
+  /** Set/Get the directory for the scratch file of an out-of-core solve. */
+  itkSetStringMacro(ScratchDirectory);
+  itkGetStringMacro(ScratchDirectory);
+
   /** Display */
   void PrintSelf( std::ostream& os, Indent indent ) const ITK_OVERRIDE;
 
@@ -80,22 +213,74 @@ protected:
   DCTPhaseUnwrappingImageFilter();
   ~DCTPhaseUnwrappingImageFilter(){}
   
+  /** In an out-of-core solve, the input is streamed by the solver. */
+  void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
   void GenerateData() ITK_OVERRIDE;
 
+  typedef typename TInputImage::Pointer      InputImagePointer;
+  typedef typename TInputImage::ConstPointer InputImageConstPointer;
+
+  /** Solves for the unwrapped phase of phase in memory, by the selected
+   * Poisson solver.  The result is owned by the solver. */
+  const TInputImage * SolveInCore( const TInputImage * phase );
+
+  /** Unwraps phase level by level, coarse to fine. */
+  InputImagePointer SolveProgressively( const TInputImage * phase );
+
+  /** Halves the resolution of a wrapped phase by complex averaging.  The last
+   * axis is kept when batching. */
+  InputImagePointer Downsample( const TInputImage * phase ) const;
+
+  /** Interpolates image onto the grid of reference. */
+  InputImagePointer Upsample( const TInputImage * image, const TInputImage * reference ) const;
+
+  /** Adds to estimate the wrapped difference of phase from it. */
+  static void MakeCongruent( TInputImage * estimate, const TInputImage * phase );
+
+  /** Refines solution by unwrapping its wrapped residual until its multiples
+   * of 2 pi settle, and returns it congruent with phase. */
+  InputImagePointer RefineCongruently( const TInputImage * phase, const TInputImage * solution );
+
 private:
 
   ITK_DISALLOW_COPY_AND_ASSIGN(DCTPhaseUnwrappingImageFilter);
   
   // Component filter types
   typedef itk::WrappedPhaseLaplacianImageFilter< TInputImage > PType;
-  typedef itk::StatisticsImageFilter< TInputImage >            StatsType;
-  typedef itk::SubtractImageFilter< TInputImage >              SubtractType;
   typedef itk::DCTPoissonSolverImageFilter< TInputImage >      SolverType;
+  typedef itk::DCTOutOfCorePoissonSolverImageFilter< TInputImage > OutOfCoreSolverType;
+  typedef itk::MultigridPoissonSolverImageFilter< TInputImage >    MultigridSolverType;
+  typedef itk::RegionOfInterestImageFilter< TInputImage, TInputImage > CropType;
+  typedef itk::ResampleImageFilter< TInputImage, TInputImage >         ResampleType;
+  typedef itk::LinearInterpolateImageFunction< TInputImage >           InterpolatorType;
+  typedef itk::NearestNeighborExtrapolateImageFunction< TInputImage >  ExtrapolatorType;
 
   typename PType::Pointer        m_P = ITK_NULLPTR;
-  typename StatsType::Pointer    m_Stats = ITK_NULLPTR;
-  typename SubtractType::Pointer m_Subtract = ITK_NULLPTR;
   typename SolverType::Pointer   m_Solver = ITK_NULLPTR;
+  typename OutOfCoreSolverType::Pointer m_OutOfCoreSolver = ITK_NULLPTR;
+  typename MultigridSolverType::Pointer m_MultigridSolver = ITK_NULLPTR;
+
+  PoissonSolverEnumType m_PoissonSolver;
+
+  int  m_PlanRigor;
+  bool m_PadToEfficientSize;
+  bool m_BatchAlongLastAxis;
+
+  SizeValueType m_MaskMargin;
+
+  unsigned int      m_NumberOfLevels;
+  unsigned int      m_CurrentLevel;
+  InputImagePointer m_Preview;
+  bool              m_RefinementStopped;
+
+  unsigned int  m_NumberOfCongruentIterations;
+  SizeValueType m_ChangedPixelsThreshold;
+  unsigned int  m_ElapsedCongruentIterations;
+  SizeValueType m_NumberOfChangedPixels;
+
+  SizeValueType m_MemoryBudget;
+  std::string   m_ScratchDirectory;
   
 };
 
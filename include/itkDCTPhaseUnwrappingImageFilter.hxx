@@ -19,6 +19,9 @@
 #define itkDCTPhaseUnwrappingImageFilter_hxx
 
 #include "itkDCTPhaseUnwrappingImageFilter.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkContinuousIndex.h"
+#include <cmath>
 
 namespace itk
 {
@@ -27,10 +30,60 @@ template < typename TInputImage, typename TOutputImage >
 DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
 ::DCTPhaseUnwrappingImageFilter() :
 m_P(PType::New()),
-m_Stats(StatsType::New()),
-m_Subtract(SubtractType::New()),
-m_Solver(SolverType::New())
-{}
+m_Solver(SolverType::New()),
+m_OutOfCoreSolver(OutOfCoreSolverType::New()),
+m_MultigridSolver(MultigridSolverType::New()),
+m_PoissonSolver(DCTSolver),
+m_PlanRigor(DCTBackend::GetPlanRigor()),
+m_PadToEfficientSize(false),
+m_BatchAlongLastAxis(false),
+m_MaskMargin(2),
+m_NumberOfLevels(1),
+m_CurrentLevel(0),
+m_RefinementStopped(false),
+m_NumberOfCongruentIterations(0),
+m_ChangedPixelsThreshold(0),
+m_ElapsedCongruentIterations(0),
+m_NumberOfChangedPixels(0),
+m_MemoryBudget(0)
+{
+  // The wrapped phase Laplacian is computed in index units
+  this->m_Solver->UseImageSpacingOff();
+  this->m_OutOfCoreSolver->UseImageSpacingOff();
+  this->m_MultigridSolver->UseImageSpacingOff();
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::GenerateInputRequestedRegion()
+{
+
+  Superclass::GenerateInputRequestedRegion();
+
+  // The bounding box is found over the whole mask
+  MaskImageType * mask = const_cast< MaskImageType * >( this->GetMaskImage() );
+  if ( mask )
+    {
+    mask->SetRequestedRegionToLargestPossibleRegion();
+    }
+
+  if ( 0 == this->m_MemoryBudget )
+    {
+    return;
+    }
+
+  TInputImage * input = const_cast< TInputImage * >( this->GetInput() );
+  if ( !input )
+    {
+    return;
+    }
+
+  typename TInputImage::RegionType region = input->GetLargestPossibleRegion();
+  region.SetSize( TInputImage::ImageDimension - 1, 1 );
+  input->SetRequestedRegion( region );
+
+}
 
 template < typename TInputImage, typename TOutputImage >
 void
@@ -38,22 +91,419 @@ DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
 ::GenerateData()
 {
   
-  // Calculate the Laplacian
-  this->m_P->SetInput( this->GetInput() );
+  // Calculate the Laplacian, over the bounding box of the mask if there is one
+  const MaskImageType * mask = this->GetMaskImage();
+  typename Superclass::InputImageRegionType maskRegion;
+  InputImageConstPointer phase = this->GetInput();
 
-  // Subtract Constant bias
-  this->m_Stats->SetInput( this->m_P->GetOutput() );
-  this->m_Stats->Update();
-  
-  const double BIAS = this->m_Stats->GetMean();
-  
-  this->m_Subtract->SetInput1( this->m_P->GetOutput() );
-  this->m_Subtract->SetConstant2( BIAS );
+  if ( mask )
+    {
 
-  this->m_Solver->SetInput( this->m_Subtract->GetOutput() );
+    if ( this->m_MemoryBudget > 0 )
+      {
+      itkExceptionMacro( "A mask is not supported by the out-of-core solve." );
+      }
+
+    maskRegion = Self::GetMaskBoundingRegion( mask, this->m_MaskMargin );
+    if ( 0 == maskRegion.GetNumberOfPixels() )
+      {
+      this->AllocateOutputs();
+      this->GetOutput()->FillBuffer( 0 );
+      return;
+      }
+
+    typename CropType::Pointer crop = CropType::New();
+    crop->SetInput( this->GetInput() );
+    crop->SetRegionOfInterest( maskRegion );
+    crop->Update();
+    phase = crop->GetOutput();
+
+    }
+
+  this->m_P->SetBatchAlongLastAxis( this->m_BatchAlongLastAxis );
+
+  if ( this->m_MemoryBudget > 0 )
+    {
+
+    if ( this->m_BatchAlongLastAxis )
+      {
+      itkExceptionMacro( "BatchAlongLastAxis is not supported by the out-of-core solve." );
+      }
+    if ( MultigridSolver == this->m_PoissonSolver )
+      {
+      itkExceptionMacro( "The out-of-core solve requires the DCT solver." );
+      }
+    if ( this->m_NumberOfLevels > 1 || this->m_NumberOfCongruentIterations > 0 )
+      {
+      itkExceptionMacro( "The out-of-core solve is neither progressive nor iterative." );
+      }
+
+    // The solver zeroes the DC term, so the bias need not be subtracted, and
+    // the Laplacian is streamed through it slab by slab
+    this->m_P->SetInput( phase );
+    this->m_OutOfCoreSolver->SetMemoryBudget( this->m_MemoryBudget );
+    this->m_OutOfCoreSolver->SetScratchDirectory( this->m_ScratchDirectory );
+    this->m_OutOfCoreSolver->SetPlanRigor( this->m_PlanRigor );
+    this->m_OutOfCoreSolver->SetNumberOfThreads( this->GetNumberOfThreads() );
+    this->m_OutOfCoreSolver->SetInput( this->m_P->GetOutput() );
+    this->m_OutOfCoreSolver->GetOutput()->SetRequestedRegion( this->GetOutput()->GetRequestedRegion() );
+    this->m_OutOfCoreSolver->GetOutput()->Update();
+
+    this->GraftSolution( this->m_OutOfCoreSolver->GetOutput() );
+    return;
+
+    }
+
+  InputImageConstPointer solution;
+  if ( this->m_NumberOfLevels > 1 )
+    {
+    solution = this->SolveProgressively( phase );
+    }
+  else
+    {
+    solution = this->SolveInCore( phase );
+    }
+
+  this->m_ElapsedCongruentIterations = 0;
+  this->m_NumberOfChangedPixels = 0;
+  if ( this->m_NumberOfCongruentIterations > 0 )
+    {
+    solution = this->RefineCongruently( phase, solution );
+    }
+
+  if ( !mask )
+    {
+    this->GraftSolution( solution.GetPointer() );
+    return;
+    }
+
+  // Paste the solution of the bounding box back
+  this->AllocateOutputs();
+  this->GetOutput()->FillBuffer( 0 );
+  Self::PasteMaskedSolution( solution.GetPointer(), mask, maskRegion, this->GetOutput() );
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+const TInputImage *
+DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::SolveInCore( const TInputImage * phase )
+{
+
+  this->m_P->SetInput( phase );
+
+  if ( MultigridSolver == this->m_PoissonSolver )
+    {
+
+    this->m_MultigridSolver->SetBatchAlongLastAxis( this->m_BatchAlongLastAxis );
+    this->m_MultigridSolver->SetNumberOfThreads( this->GetNumberOfThreads() );
+    this->m_MultigridSolver->SetInput( this->m_P->GetOutput() );
+    this->m_MultigridSolver->Update();
+    return this->m_MultigridSolver->GetOutput();
+
+    }
+
+  // A constant bias only changes the DC term of the spectrum, which the
+  // solver zeroes, so the Laplacian is solved directly
+  this->m_Solver->SetPlanRigor( this->m_PlanRigor );
+  this->m_Solver->SetPadToEfficientSize( this->m_PadToEfficientSize );
+  this->m_Solver->SetBatchAlongLastAxis( this->m_BatchAlongLastAxis );
+  this->m_Solver->SetNumberOfThreads( this->GetNumberOfThreads() );
+  this->m_Solver->SetInput( this->m_P->GetOutput() );
   this->m_Solver->Update();
-  
-  this->GetOutput()->Graft( this->m_Solver->GetOutput() );
+  return this->m_Solver->GetOutput();
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+typename DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >::InputImagePointer
+DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::SolveProgressively( const TInputImage * phase )
+{
+
+  const unsigned int numberOfAxes = TInputImage::ImageDimension - ( this->m_BatchAlongLastAxis ? 1 : 0 );
+
+  // The wrapped phase at each level, finest first
+  std::vector< InputImageConstPointer > pyramid( 1, phase );
+  while ( pyramid.size() < this->m_NumberOfLevels )
+    {
+    const typename TInputImage::SizeType size = pyramid.back()->GetLargestPossibleRegion().GetSize();
+    bool coarsen = true;
+    for (unsigned int d = 0; d < numberOfAxes; ++d)
+      {
+      coarsen = coarsen && size[d] >= 8;
+      }
+    if ( !coarsen )
+      {
+      break;
+      }
+    pyramid.push_back( this->Downsample( pyramid.back() ).GetPointer() );
+    }
+
+  this->m_RefinementStopped = false;
+
+  InputImagePointer estimate;
+  for (unsigned int level = pyramid.size(); level-- > 0; )
+    {
+
+    this->m_CurrentLevel = level;
+    const TInputImage * wrapped = pyramid[level];
+    const typename TInputImage::RegionType region = wrapped->GetLargestPossibleRegion();
+
+    InputImagePointer refined = TInputImage::New();
+    refined->CopyInformation( wrapped );
+    refined->SetRegions( region );
+    refined->Allocate();
+
+    if ( estimate )
+      {
+
+      // Solve for what the coarser solution misses
+      InputImagePointer upsampled = this->Upsample( estimate, wrapped );
+
+      InputImagePointer residual = TInputImage::New();
+      residual->CopyInformation( wrapped );
+      residual->SetRegions( region );
+      residual->Allocate();
+
+      typename Superclass::WrapFunctorType wrap;
+      ImageRegionConstIterator< TInputImage > wIt( wrapped, region );
+      ImageRegionConstIterator< TInputImage > uIt( upsampled, region );
+      ImageRegionIterator< TInputImage > rIt( residual, region );
+      for (wIt.GoToBegin(), uIt.GoToBegin(), rIt.GoToBegin(); !rIt.IsAtEnd(); ++wIt, ++uIt, ++rIt)
+        {
+        rIt.Set( wrap( wIt.Get() - uIt.Get() ) );
+        }
+
+      const TInputImage * correction = this->SolveInCore( residual );
+
+      ImageRegionConstIterator< TInputImage > cIt( correction, region );
+      ImageRegionIterator< TInputImage > oIt( refined, region );
+      for (uIt.GoToBegin(), cIt.GoToBegin(), oIt.GoToBegin(); !oIt.IsAtEnd(); ++uIt, ++cIt, ++oIt)
+        {
+        oIt.Set( uIt.Get() + cIt.Get() );
+        }
+
+      }
+    else
+      {
+      ImageAlgorithm::Copy( this->SolveInCore( wrapped ), refined.GetPointer(), region, region );
+      }
+
+    Self::MakeCongruent( refined, wrapped );
+    estimate = refined;
+
+    if ( 0 == level )
+      {
+      break;
+      }
+
+    // Preview at full resolution
+    this->m_Preview = this->Upsample( estimate, phase );
+    Self::MakeCongruent( this->m_Preview, phase );
+    this->InvokeEvent( IterationEvent() );
+
+    if ( this->m_RefinementStopped )
+      {
+      estimate = this->m_Preview;
+      break;
+      }
+
+    }
+
+  this->m_Preview = ITK_NULLPTR;
+  return estimate;
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+typename DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >::InputImagePointer
+DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::Downsample( const TInputImage * phase ) const
+{
+
+  const unsigned int Dimension = TInputImage::ImageDimension;
+
+  const typename TInputImage::RegionType fineRegion = phase->GetLargestPossibleRegion();
+  const typename TInputImage::IndexType fineLower = fineRegion.GetIndex();
+  const typename TInputImage::IndexType fineUpper = fineRegion.GetUpperIndex();
+
+  typename TInputImage::SizeType size;
+  typename TInputImage::SpacingType spacing = phase->GetSpacing();
+  ContinuousIndex< double, Dimension > corner;
+  IndexValueType factor[Dimension];
+  for (unsigned int d = 0; d < Dimension; ++d)
+    {
+    factor[d] = ( this->m_BatchAlongLastAxis && d == Dimension - 1 ) ? 1 : 2;
+    size[d] = ( fineRegion.GetSize()[d] + factor[d] - 1 ) / factor[d];
+    spacing[d] *= factor[d];
+    // Each coarse pixel is centred on its block
+    corner[d] = fineLower[d] + 0.5 * ( factor[d] - 1 );
+    }
+
+  typename TInputImage::PointType origin;
+  phase->TransformContinuousIndexToPhysicalPoint( corner, origin );
+
+  InputImagePointer coarse = TInputImage::New();
+  coarse->SetRegions( size );
+  coarse->SetSpacing( spacing );
+  coarse->SetOrigin( origin );
+  coarse->SetDirection( phase->GetDirection() );
+  coarse->Allocate();
+
+  // The phase of the mean of exp(i phi) over each block
+  ImageRegionIteratorWithIndex< TInputImage > it( coarse, coarse->GetLargestPossibleRegion() );
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+
+    double re = 0.0;
+    double im = 0.0;
+    for (unsigned int child = 0; child < ( 1u << Dimension ); ++child)
+      {
+      typename TInputImage::IndexType index;
+      bool inside = true;
+      for (unsigned int d = 0; d < Dimension && inside; ++d)
+        {
+        const IndexValueType bit = ( child >> d ) & 1;
+        index[d] = fineLower[d] + factor[d] * it.GetIndex()[d] + bit;
+        inside = bit < factor[d] && index[d] <= fineUpper[d];
+        }
+      if ( inside )
+        {
+        const double value = phase->GetPixel( index );
+        re += std::cos( value );
+        im += std::sin( value );
+        }
+      }
+
+    it.Set( static_cast< typename TInputImage::PixelType >( std::atan2( im, re ) ) );
+
+    }
+
+  return coarse;
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+typename DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >::InputImagePointer
+DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::Upsample( const TInputImage * image, const TInputImage * reference ) const
+{
+
+  // Beyond the outermost pixel centres the nearest value is taken
+  typename ResampleType::Pointer resample = ResampleType::New();
+  resample->SetInput( image );
+  resample->SetInterpolator( InterpolatorType::New() );
+  resample->SetExtrapolator( ExtrapolatorType::New() );
+  resample->SetReferenceImage( reference );
+  resample->UseReferenceImageOn();
+  resample->SetNumberOfThreads( this->GetNumberOfThreads() );
+  resample->Update();
+
+  InputImagePointer output = resample->GetOutput();
+  output->DisconnectPipeline();
+  return output;
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::MakeCongruent( TInputImage * estimate, const TInputImage * phase )
+{
+
+  typename Superclass::WrapFunctorType wrap;
+
+  const typename TInputImage::RegionType region = estimate->GetBufferedRegion();
+  ImageRegionIterator< TInputImage > eIt( estimate, region );
+  ImageRegionConstIterator< TInputImage > pIt( phase, region );
+  for (eIt.GoToBegin(), pIt.GoToBegin(); !eIt.IsAtEnd(); ++eIt, ++pIt)
+    {
+    eIt.Value() += wrap( pIt.Get() - eIt.Get() );
+    }
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+typename DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >::InputImagePointer
+DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::RefineCongruently( const TInputImage * phase, const TInputImage * solution )
+{
+
+  const typename TInputImage::RegionType region = phase->GetLargestPossibleRegion();
+  const double twoPi = 2.0 * vnl_math::pi;
+
+  typename Superclass::WrapFunctorType wrap;
+
+  // The estimate, the wrapped residual, and the multiple of 2 pi of each
+  // pixel are the only buffers, and are reused by every iteration
+  InputImagePointer estimate = TInputImage::New();
+  estimate->CopyInformation( phase );
+  estimate->SetRegions( region );
+  estimate->Allocate();
+  ImageAlgorithm::Copy( solution, estimate.GetPointer(), region, region );
+
+  InputImagePointer residual = TInputImage::New();
+  residual->CopyInformation( phase );
+  residual->SetRegions( region );
+  residual->Allocate();
+
+  std::vector< long > cycles( region.GetNumberOfPixels() );
+
+  ImageRegionConstIterator< TInputImage > pIt( phase, region );
+  ImageRegionIterator< TInputImage > eIt( estimate, region );
+  ImageRegionIterator< TInputImage > rIt( residual, region );
+
+  std::vector< long >::iterator cIt = cycles.begin();
+  for (pIt.GoToBegin(), eIt.GoToBegin(); !eIt.IsAtEnd(); ++pIt, ++eIt, ++cIt)
+    {
+    *cIt = static_cast< long >( std::floor( ( eIt.Get() - pIt.Get() ) / twoPi + 0.5 ) );
+    }
+
+  for (unsigned int i = 0; i < this->m_NumberOfCongruentIterations; ++i)
+    {
+
+    for (pIt.GoToBegin(), eIt.GoToBegin(), rIt.GoToBegin(); !rIt.IsAtEnd(); ++pIt, ++eIt, ++rIt)
+      {
+      rIt.Set( wrap( pIt.Get() - eIt.Get() ) );
+      }
+    residual->Modified();
+
+    const TInputImage * correction = this->SolveInCore( residual );
+
+    // Apply the correction, and count the pixels whose multiple of 2 pi moved
+    SizeValueType changed = 0;
+    ImageRegionConstIterator< TInputImage > dIt( correction, region );
+    for (pIt.GoToBegin(), eIt.GoToBegin(), dIt.GoToBegin(), cIt = cycles.begin();
+         !eIt.IsAtEnd();
+         ++pIt, ++eIt, ++dIt, ++cIt)
+      {
+      eIt.Value() += dIt.Get();
+      const long k = static_cast< long >( std::floor( ( eIt.Get() - pIt.Get() ) / twoPi + 0.5 ) );
+      if ( k != *cIt )
+        {
+        *cIt = k;
+        ++changed;
+        }
+      }
+
+    this->m_ElapsedCongruentIterations = i + 1;
+    this->m_NumberOfChangedPixels = changed;
+
+    if ( changed <= this->m_ChangedPixelsThreshold )
+      {
+      break;
+      }
+
+    }
+
+  // Round to the congruent solution, in place
+  for (pIt.GoToBegin(), eIt.GoToBegin(), cIt = cycles.begin(); !eIt.IsAtEnd(); ++pIt, ++eIt, ++cIt)
+    {
+    eIt.Set( static_cast< typename TInputImage::PixelType >( pIt.Get() + twoPi * ( *cIt ) ) );
+    }
+
+  return estimate;
 
 }
 
@@ -66,6 +516,17 @@ DCTPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
 {
   Superclass::PrintSelf(os,indent);
 
+  os << indent << "Poisson Solver: " << (m_PoissonSolver == MultigridSolver ? "Multigrid" : "DCT") << std::endl;
+  os << indent << "Plan Rigor: " << DCTBackend::GetPlanRigorName(m_PlanRigor) << std::endl;
+  os << indent << "Pad To Efficient Size: " << (m_PadToEfficientSize ? "On" : "Off") << std::endl;
+  os << indent << "Batch Along Last Axis: " << (m_BatchAlongLastAxis ? "On" : "Off") << std::endl;
+  os << indent << "Mask Margin: " << m_MaskMargin << std::endl;
+  os << indent << "Number Of Levels: " << m_NumberOfLevels << std::endl;
+  os << indent << "Number Of Congruent Iterations: " << m_NumberOfCongruentIterations << std::endl;
+  os << indent << "Changed Pixels Threshold: " << m_ChangedPixelsThreshold << std::endl;
+  os << indent << "Memory Budget: " << m_MemoryBudget << std::endl;
+  os << indent << "Scratch Directory: " << m_ScratchDirectory << std::endl;
+
 }
 
 } /* end namespace itk */
@@ -20,8 +20,10 @@
 #define itkDCTPoissonSolverImageFilter_h
 
 #include "itkImageToImageFilter.h"
-#include "itkImageRegionIteratorWithIndex.h"
 #include "itkDCTImageFilter.h"
+#include "itkThreadedRangeLoop.h"
+#include <vector>
+#include <algorithm>
 
 namespace itk {
 
@@ -31,10 +33,26 @@ namespace itk {
  *
  * The Laplacian (second-difference) image can be calculated using itkLaplacianImageFilter.h
  * This filter retrieves the original image (to an arbitrary constant) by solving the Poisson
- * equation using discrete cosine transform (DCT) methods.  The DCT is provided via the FFTW
- * library, and therefore is subject to the GPL license.  This can be useful for a variety of
+ * equation using discrete cosine transform (DCT) methods.  The DCT is provided by
+ * DCTImageFilter, and when computed by the FFTW library is subject to the GPL license
+ * (see DCTBackend).  This can be useful for a variety of
  * image processing applications, such as phase unwrapping and gradient-domain filtering.
  *
+ * The solve is fused: the forward DCT is computed from the input directly into the
+ * output buffer, the spectral division (including normalization of the inverse
+ * transform) is applied there, and the inverse DCT is computed in place.  No
+ * intermediate images are allocated.
+ *
+ * The eigenvalues of the discrete Laplacian are separable, so they are stored as
+ * one table per axis, rebuilt only when the image size or spacing changes.  The
+ * division is applied line by line along the first axis, with the lines split
+ * across threads.
+ *
+ * When UseImageSpacing is on, as in LaplacianImageFilter, the Laplacian is
+ * taken to be in physical units and each axis is scaled by the inverse square
+ * of its spacing.  It is off by default, so that the Laplacian is in index
+ * units, as in DCTPhaseUnwrappingImageFilter, and the spacing is ignored.
+ *
  */
 
 template < typename TInputImage, typename TOutputImage = TInputImage >
@@ -61,6 +79,11 @@ public:
                    
   itkConceptMacro( OutputFloatingPointCheck,
                    ( Concept::IsFloatingPoint< typename TOutputImage::PixelType > ) );
+
+  // The transforms run in the output buffer.
+  itkConceptMacro( SamePixelTypeCheck,
+                   ( Concept::SameType< typename TInputImage::PixelType,
+                   typename TOutputImage::PixelType > ) );
   // End concept checking
 #endif
   
@@ -70,6 +93,33 @@ public:
   /** Run-time type information */
   itkTypeMacro(DCTPoissonSolverImageFilter, ImageToImageFilter);
 
+  /** Set/Get the FFTW planner rigor passed to the underlying DCTImageFilter. */
+  itkSetMacro(PlanRigor, int);
+  itkGetConstMacro(PlanRigor, int);
+
+  /** Set/Get whether the Laplacian is in physical units.  Default is off. */
+  itkSetMacro(UseImageSpacing, bool);
+  itkGetConstMacro(UseImageSpacing, bool);
+  itkBooleanMacro(UseImageSpacing);
+
+  /** Set/Get whether to solve on a larger grid whose extents have only small
+   * prime factors (see DCTImageFilter::GetEfficientSize()).  The Laplacian is
+   * extended by reflection and the solution is cropped to the input extent.
+   * This is much faster for sizes with large prime factors; the solution is
+   * that of the reflected problem, so it differs slightly from the unpadded
+   * solution near the far boundaries.  Default is off. */
+  itkSetMacro(PadToEfficientSize, bool);
+  itkGetConstMacro(PadToEfficientSize, bool);
+  itkBooleanMacro(PadToEfficientSize);
+
+  /** Set/Get whether the last axis indexes a series of independent frames,
+   * e.g. the time points of a 4D acquisition.  Each frame is solved over the
+   * remaining axes, and all frames are transformed by one batched plan.
+   * Default is off. */
+  itkSetMacro(BatchAlongLastAxis, bool);
+  itkGetConstMacro(BatchAlongLastAxis, bool);
+  itkBooleanMacro(BatchAlongLastAxis);
+
   /** Display */
   void PrintSelf( std::ostream& os, Indent indent ) const ITK_OVERRIDE;
 
@@ -78,20 +128,64 @@ protected:
   DCTPoissonSolverImageFilter();
   ~DCTPoissonSolverImageFilter(){}
 
-  //  Iterators
-  typedef itk::ImageRegionIteratorWithIndex< TInputImage > ItType;
-  
+  typedef typename TOutputImage::PixelType   PixelType;
+  typedef typename TOutputImage::SizeType    SizeType;
+  typedef typename TOutputImage::SpacingType SpacingType;
+
   void GenerateData() ITK_OVERRIDE;
 
+  /** Rebuild the per-axis eigenvalue tables if the size or spacing changed. */
+  void UpdateEigenvalueTables( const SizeType & size, const SpacingType & spacing );
+
+  /** Divide a forward transformed buffer by the eigenvalues and invert it in place. */
+  void SolveSpectrum( PixelType * buffer, const SizeType & size, const SpacingType & spacing );
+
+  /** Number of lines along the first axis. */
+  static SizeValueType GetNumberOfLines( const SizeType & size );
+
+  /** Extend a buffer by half-sample reflection along every axis. */
+  static void MirrorPad( const PixelType * in, const SizeType & size, PixelType * out, const SizeType & paddedSize );
+
+  /** Copy the leading size region of a padded buffer. */
+  static void Crop( const PixelType * in, const SizeType & paddedSize, PixelType * out, const SizeType & size );
+
+  /** Half-sample reflection of index i into [0, n). */
+  static SizeValueType Reflect( SizeValueType i, SizeValueType n )
+    {
+    i %= 2 * n;
+    return ( i < n ) ? i : 2 * n - 1 - i;
+    }
+
 private:
 
   ITK_DISALLOW_COPY_AND_ASSIGN(DCTPoissonSolverImageFilter);
   
-  // Component filter types
+  // Transform type, used through DCTType::TransformBuffer()
   typedef itk::DCTImageFilter< TInputImage > DCTType;
 
-  typename DCTType::Pointer m_DCT_Forward = ITK_NULLPTR;
-  typename DCTType::Pointer m_DCT_Inverse = ITK_NULLPTR;
+  // Divides each line along the first axis by the sum of the eigenvalues
+  struct SpectralDivideFunctor
+    {
+    void operator()( SizeValueType firstLine, SizeValueType lastLine ) const;
+
+    PixelType *                   Buffer;
+    SizeType                      Size;
+    const std::vector< double > * Tables;
+    SizeValueType                 LinesPerFrame;
+    };
+
+  int  m_PlanRigor;
+  bool m_UseImageSpacing;
+  bool m_PadToEfficientSize;
+  bool m_BatchAlongLastAxis;
+
+  // Per-axis eigenvalues, scaled by the normalization of the inverse DCT, and
+  // the size, spacing and flags they were built for
+  std::vector< double > m_EigenvalueTables[TOutputImage::ImageDimension];
+  SizeType              m_EigenvalueTableSize;
+  SpacingType           m_EigenvalueTableSpacing;
+  bool                  m_EigenvalueTableUseImageSpacing;
+  bool                  m_EigenvalueTableBatchAlongLastAxis;
 
 };
 
@@ -26,12 +26,102 @@ namespace itk
 template < typename TInputImage, typename TOutputImage >
 DCTPoissonSolverImageFilter< TInputImage, TOutputImage >
 ::DCTPoissonSolverImageFilter() :
-m_DCT_Forward(DCTType::New()),
-m_DCT_Inverse(DCTType::New())
+m_PlanRigor(DCTBackend::GetPlanRigor()),
+m_UseImageSpacing(false),
+m_PadToEfficientSize(false),
+m_BatchAlongLastAxis(false),
+m_EigenvalueTableUseImageSpacing(false),
+m_EigenvalueTableBatchAlongLastAxis(false)
 {
+  this->m_EigenvalueTableSize.Fill( 0 );
+  this->m_EigenvalueTableSpacing.Fill( 0 );
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTPoissonSolverImageFilter< TInputImage, TOutputImage >
+::UpdateEigenvalueTables( const SizeType & size, const SpacingType & spacing )
+{
+
+  if ( size == this->m_EigenvalueTableSize
+       && spacing == this->m_EigenvalueTableSpacing
+       && this->m_UseImageSpacing == this->m_EigenvalueTableUseImageSpacing
+       && this->m_BatchAlongLastAxis == this->m_EigenvalueTableBatchAlongLastAxis )
+    {
+    return;
+    }
+
+  // Normalization of the inverse DCT is folded into the tables
+  const double NORM = DCTType::GetNormalizationFactor( size, this->m_BatchAlongLastAxis );
+
+  for (unsigned int d = 0; d < TOutputImage::ImageDimension; ++d)
+    {
+    // Frames along a batch axis are independent
+    if ( this->m_BatchAlongLastAxis && TOutputImage::ImageDimension - 1 == d )
+      {
+      this->m_EigenvalueTables[d].assign( size[d], 0.0 );
+      continue;
+      }
+
+    double scale = NORM;
+    if ( this->m_UseImageSpacing )
+      {
+      scale /= spacing[d] * spacing[d];
+      }
+
+    std::vector< double > & table = this->m_EigenvalueTables[d];
+    table.resize( size[d] );
+    for (SizeValueType k = 0; k < size[d]; ++k)
+      {
+      table[k] = ( 2*std::cos( vnl_math::pi * k / size[d] ) - 2 ) * scale;
+      }
+    }
+
+  this->m_EigenvalueTableSize = size;
+  this->m_EigenvalueTableSpacing = spacing;
+  this->m_EigenvalueTableUseImageSpacing = this->m_UseImageSpacing;
+  this->m_EigenvalueTableBatchAlongLastAxis = this->m_BatchAlongLastAxis;
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTPoissonSolverImageFilter< TInputImage, TOutputImage >
+::SpectralDivideFunctor
+::operator()( SizeValueType firstLine, SizeValueType lastLine ) const
+{
+
+  const SizeValueType lineLength = this->Size[0];
+  const double * firstAxis = &this->Tables[0][0];
+
+  for (SizeValueType line = firstLine; line < lastLine; ++line)
+    {
+
+    // Sum the eigenvalues of the remaining axes, which are constant along the line
+    double base = 0.0;
+    SizeValueType remainder = line;
+    for (unsigned int d = 1; d < TOutputImage::ImageDimension; ++d)
+      {
+      base += this->Tables[d][remainder % this->Size[d]];
+      remainder /= this->Size[d];
+      }
+
+    PixelType * p = this->Buffer + line * lineLength;
+
+    // The zero frequency of each frame is undetermined; set it to "0"
+    SizeValueType first = 0;
+    if ( 0 == line % this->LinesPerFrame )
+      {
+      p[0] = 0;
+      first = 1;
+      }
+
+    for (SizeValueType i = first; i < lineLength; ++i)
+      {
+      p[i] = static_cast< PixelType >( p[i] / ( base + firstAxis[i] ) );
+      }
 
-  this->m_DCT_Forward->SetTransformDirection( DCTType::Forward );
-  this->m_DCT_Inverse->SetTransformDirection( DCTType::Reverse );
+    }
 
 }
 
@@ -42,45 +132,172 @@ DCTPoissonSolverImageFilter< TInputImage, TOutputImage >
 {
   
   typename TInputImage::ConstPointer input = this->GetInput(); // Save input to variable
-  
-  // Calculate the forward DCT
-  this->m_DCT_Forward->SetInput( input );
-  this->m_DCT_Forward->Update();
+  typename TOutputImage::Pointer output = this->GetOutput();
+
+  if ( this->m_BatchAlongLastAxis && TOutputImage::ImageDimension < 2 )
+    {
+    itkExceptionMacro( "Batching along the last axis requires at least two dimensions." );
+    }
 
-  // Save the transformed data to an image for iteration 
-  typename TInputImage::Pointer transformed = TInputImage::New();
-  transformed->Graft( m_DCT_Forward->GetOutput() );
-  transformed->Update();
+  this->AllocateOutputs();
 
   // Get the dimensions of the image
-  const typename TInputImage::SizeType size = input->GetLargestPossibleRegion().GetSize();
-  const typename TInputImage::IndexType index = input->GetLargestPossibleRegion().GetIndex();
+  const SizeType size = input->GetLargestPossibleRegion().GetSize();
+  SizeType paddedSize = this->m_PadToEfficientSize ? DCTType::GetEfficientSize( size ) : size;
+  if ( this->m_BatchAlongLastAxis )
+    {
+    paddedSize[TOutputImage::ImageDimension - 1] = size[TOutputImage::ImageDimension - 1];
+    }
+
+  if ( paddedSize == size )
+    {
+
+    // Calculate the forward DCT directly into the output buffer
+    DCTType::TransformBuffer( size,
+                              const_cast< PixelType * >( input->GetBufferPointer() ),
+                              output->GetBufferPointer(),
+                              DCTType::Forward,
+                              this->m_PlanRigor,
+                              this->GetNumberOfThreads(),
+                              this->m_BatchAlongLastAxis );
+
+    this->SolveSpectrum( output->GetBufferPointer(), size, output->GetSpacing() );
+
+    return;
 
-  // Iterate through the temp image
+    }
+
+  // Mirror the Laplacian into a padded buffer; the reflection continues the
+  // Neumann boundary of the original extent
+  typename TOutputImage::Pointer padded = TOutputImage::New();
+  padded->SetRegions( typename TOutputImage::RegionType( paddedSize ) );
+  padded->Allocate();
+
+  Self::MirrorPad( input->GetBufferPointer(), size, padded->GetBufferPointer(), paddedSize );
+
+  DCTType::TransformBuffer( paddedSize,
+                            padded->GetBufferPointer(),
+                            padded->GetBufferPointer(),
+                            DCTType::Forward,
+                            this->m_PlanRigor,
+                            this->GetNumberOfThreads(),
+                            this->m_BatchAlongLastAxis );
+
+  this->SolveSpectrum( padded->GetBufferPointer(), paddedSize, output->GetSpacing() );
+
+  // Crop the solution back to the original extent
+  Self::Crop( padded->GetBufferPointer(), paddedSize, output->GetBufferPointer(), size );
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTPoissonSolverImageFilter< TInputImage, TOutputImage >
+::SolveSpectrum( PixelType * buffer, const SizeType & size, const SpacingType & spacing )
+{
+
+  // Divide by the eigenvalues of the Laplacian
   // See equation 5.60, p. 200
-  ItType it(transformed, transformed->GetLargestPossibleRegion() );
-  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  this->UpdateEigenvalueTables( size, spacing );
+
+  SpectralDivideFunctor divide;
+  divide.Buffer = buffer;
+  divide.Size = size;
+  divide.Tables = this->m_EigenvalueTables;
+
+  const SizeValueType numberOfLines = Self::GetNumberOfLines( size );
+  divide.LinesPerFrame = numberOfLines;
+  if ( this->m_BatchAlongLastAxis )
+    {
+    divide.LinesPerFrame /= size[TOutputImage::ImageDimension - 1];
+    }
+
+  ThreadedRangeLoop< SpectralDivideFunctor >::Run( this->GetMultiThreader(),
+                                                   this->GetNumberOfThreads(),
+                                                   numberOfLines,
+                                                   divide );
+
+  // Take the inverse DCT in place
+  DCTType::TransformBuffer( size,
+                            buffer,
+                            buffer,
+                            DCTType::Reverse,
+                            this->m_PlanRigor,
+                            this->GetNumberOfThreads(),
+                            this->m_BatchAlongLastAxis );
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+SizeValueType
+DCTPoissonSolverImageFilter< TInputImage, TOutputImage >
+::GetNumberOfLines( const SizeType & size )
+{
+  SizeValueType lines = 1;
+  for (unsigned int d = 1; d < TOutputImage::ImageDimension; ++d)
     {
+    lines *= size[d];
+    }
+  return lines;
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTPoissonSolverImageFilter< TInputImage, TOutputImage >
+::MirrorPad( const PixelType * in, const SizeType & size, PixelType * out, const SizeType & paddedSize )
+{
 
-    typename TInputImage::PixelType var = -2*static_cast<signed>(TInputImage::ImageDimension);
+  // Half-sample reflection, as in the implicit extension of the DCT
+  const SizeValueType lines = Self::GetNumberOfLines( paddedSize );
+  for (SizeValueType line = 0; line < lines; ++line)
+    {
 
-    for (unsigned int i = 0; i < TInputImage::ImageDimension; ++i)
+    SizeValueType remainder = line;
+    SizeValueType sourceLine = 0;
+    SizeValueType stride = 1;
+    for (unsigned int d = 1; d < TOutputImage::ImageDimension; ++d)
       {
-      var += 2*std::cos(vnl_math::pi*(it.GetIndex()[i] - index[i]) / size[i]);
-      } // 5.60, p.200
+      sourceLine += Self::Reflect( remainder % paddedSize[d], size[d] ) * stride;
+      remainder /= paddedSize[d];
+      stride *= size[d];
+      }
 
-    it.Value() /= var; // Divide by the result
+    const PixelType * source = in + sourceLine * size[0];
+    PixelType * target = out + line * paddedSize[0];
+    for (SizeValueType i = 0; i < paddedSize[0]; ++i)
+      {
+      target[i] = source[Self::Reflect( i, size[0] )];
+      }
 
     }
 
-  // Set the zero index to "0"
-  transformed->SetPixel( index, 0.0 );
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+DCTPoissonSolverImageFilter< TInputImage, TOutputImage >
+::Crop( const PixelType * in, const SizeType & paddedSize, PixelType * out, const SizeType & size )
+{
 
-  // Take the inverse DCT
-  this->m_DCT_Inverse->SetInput( transformed );
-  this->m_DCT_Inverse->Update();
-  
-  this->GetOutput()->Graft( this->m_DCT_Inverse->GetOutput() );
+  const SizeValueType lines = Self::GetNumberOfLines( size );
+  for (SizeValueType line = 0; line < lines; ++line)
+    {
+
+    SizeValueType remainder = line;
+    SizeValueType sourceLine = 0;
+    SizeValueType stride = 1;
+    for (unsigned int d = 1; d < TOutputImage::ImageDimension; ++d)
+      {
+      sourceLine += ( remainder % size[d] ) * stride;
+      remainder /= size[d];
+      stride *= paddedSize[d];
+      }
+
+    std::copy( in + sourceLine * paddedSize[0],
+               in + sourceLine * paddedSize[0] + size[0],
+               out + line * size[0] );
+
+    }
 
 }
 
@@ -93,7 +310,10 @@ DCTPoissonSolverImageFilter< TInputImage, TOutputImage >
 {
   Superclass::PrintSelf(os,indent);
 
-  os << indent << "No parameters." << std::endl;
+  os << indent << "Plan Rigor: " << DCTBackend::GetPlanRigorName(m_PlanRigor) << std::endl;
+  os << indent << "Use Image Spacing: " << (m_UseImageSpacing ? "On" : "Off") << std::endl;
+  os << indent << "Pad To Efficient Size: " << (m_PadToEfficientSize ? "On" : "Off") << std::endl;
+  os << indent << "Batch Along Last Axis: " << (m_BatchAlongLastAxis ? "On" : "Off") << std::endl;
 }
 
 } /* end namespace itk */
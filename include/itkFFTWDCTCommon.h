@@ -0,0 +1,343 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkFFTWDCTCommon_h
+#define itkFFTWDCTCommon_h
+
+#include "itkPhaseConfigure.h"
+#include <string>
+
+// Without FFTW, only the empty DCTProxy is defined, and the DCT filters use
+// BundledDCT (see DCTBackend).
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+#include "itkFFTWGlobalConfiguration.h"
+#include <fftw3.h>
+#endif
+
+namespace itk
+{
+namespace fftw
+{
+
+/** \class DCTProxy
+ *  \ingroup ITKPhase
+ * \brief Wrapper for the FFTW real-to-real API, specialized on the pixel type.
+ *
+ * The DCT filters are written against this class so that float, double and
+ * long double images are transformed by fftwf, fftw and fftwl respectively,
+ * without converting the pixel buffer.  Only the specializations for which
+ * the corresponding FFTW library is available are defined: float requires
+ * ITK_USE_FFTWF, double requires ITK_USE_FFTWD, and long double requires
+ * ITKPhase_USE_FFTWL, and all of them require ITK to have been built with
+ * FFTW.  IsAvailable tells the DCT filters whether a specialization exists;
+ * other pixel types are transformed by BundledDCT.
+ *
+ * This mirrors itk::fftw::Proxy (itkFFTWCommon.h), which does not wrap the
+ * real-to-real transforms.  As there, Plan_r2r() must be called while holding
+ * FFTWGlobalConfiguration::GetLockMutex(), and the number of threads used by
+ * the plan is set immediately before planning.
+ */
+template< typename TPixel >
+class DCTProxy
+{
+public:
+  // No FFTW library for this precision
+  static const bool IsAvailable = false;
+
+  static bool ImportWisdomFile( const std::string & )
+    {
+    return false;
+    }
+
+  static bool ExportWisdomFile( const std::string & )
+    {
+    return false;
+    }
+};
+
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+
+#if defined(ITK_USE_FFTWF)
+template<>
+class DCTProxy< float >
+{
+public:
+  typedef float         PixelType;
+  typedef fftwf_plan    PlanType;
+  typedef DCTProxy      Self;
+
+  static const bool IsAvailable = true;
+
+  static PlanType Plan_r2r( int rank,
+                            const int * n,
+                            PixelType * in,
+                            PixelType * out,
+                            const fftw_r2r_kind * kind,
+                            unsigned int flags,
+                            int threads )
+    {
+#ifndef ITK_USE_CUFFTW
+    fftwf_plan_with_nthreads( threads );
+#endif
+    return fftwf_plan_r2r( rank, n, in, out, kind, flags );
+    }
+
+  /** Plan howmany transforms of the same size, each starting distance
+   * elements after the previous one, with elements stride apart. */
+  static PlanType Plan_many_r2r( int rank,
+                                 const int * n,
+                                 int howmany,
+                                 PixelType * in,
+                                 PixelType * out,
+                                 int stride,
+                                 int distance,
+                                 const fftw_r2r_kind * kind,
+                                 unsigned int flags,
+                                 int threads )
+    {
+#ifndef ITK_USE_CUFFTW
+    fftwf_plan_with_nthreads( threads );
+#endif
+    return fftwf_plan_many_r2r( rank, n, howmany,
+                                in, ITK_NULLPTR, stride, distance,
+                                out, ITK_NULLPTR, stride, distance,
+                                kind, flags );
+    }
+
+  static void Execute_r2r( PlanType plan, PixelType * in, PixelType * out )
+    {
+    fftwf_execute_r2r( plan, in, out );
+    }
+
+  static void DestroyPlan( PlanType plan )
+    {
+    fftwf_destroy_plan( plan );
+    }
+
+  static void * Malloc( size_t bytes )
+    {
+    return fftwf_malloc( bytes );
+    }
+
+  static void Free( void * p )
+    {
+    fftwf_free( p );
+    }
+
+  static int AlignmentOf( PixelType * p )
+    {
+    return fftwf_alignment_of( p );
+    }
+
+  static bool ImportWisdomFile( const std::string & path )
+    {
+    return FFTWGlobalConfiguration::ImportWisdomFileFloat( path );
+    }
+
+  static bool ExportWisdomFile( const std::string & path )
+    {
+    return FFTWGlobalConfiguration::ExportWisdomFileFloat( path );
+    }
+};
+#endif
+
+#if defined(ITK_USE_FFTWD)
+template<>
+class DCTProxy< double >
+{
+public:
+  typedef double        PixelType;
+  typedef fftw_plan     PlanType;
+  typedef DCTProxy      Self;
+
+  static const bool IsAvailable = true;
+
+  static PlanType Plan_r2r( int rank,
+                            const int * n,
+                            PixelType * in,
+                            PixelType * out,
+                            const fftw_r2r_kind * kind,
+                            unsigned int flags,
+                            int threads )
+    {
+#ifndef ITK_USE_CUFFTW
+    fftw_plan_with_nthreads( threads );
+#endif
+    return fftw_plan_r2r( rank, n, in, out, kind, flags );
+    }
+
+  /** Plan howmany transforms of the same size, each starting distance
+   * elements after the previous one, with elements stride apart. */
+  static PlanType Plan_many_r2r( int rank,
+                                 const int * n,
+                                 int howmany,
+                                 PixelType * in,
+                                 PixelType * out,
+                                 int stride,
+                                 int distance,
+                                 const fftw_r2r_kind * kind,
+                                 unsigned int flags,
+                                 int threads )
+    {
+#ifndef ITK_USE_CUFFTW
+    fftw_plan_with_nthreads( threads );
+#endif
+    return fftw_plan_many_r2r( rank, n, howmany,
+                               in, ITK_NULLPTR, stride, distance,
+                               out, ITK_NULLPTR, stride, distance,
+                               kind, flags );
+    }
+
+  static void Execute_r2r( PlanType plan, PixelType * in, PixelType * out )
+    {
+    fftw_execute_r2r( plan, in, out );
+    }
+
+  static void DestroyPlan( PlanType plan )
+    {
+    fftw_destroy_plan( plan );
+    }
+
+  static void * Malloc( size_t bytes )
+    {
+    return fftw_malloc( bytes );
+    }
+
+  static void Free( void * p )
+    {
+    fftw_free( p );
+    }
+
+  static int AlignmentOf( PixelType * p )
+    {
+    return fftw_alignment_of( p );
+    }
+
+  static bool ImportWisdomFile( const std::string & path )
+    {
+    return FFTWGlobalConfiguration::ImportWisdomFileDouble( path );
+    }
+
+  static bool ExportWisdomFile( const std::string & path )
+    {
+    return FFTWGlobalConfiguration::ExportWisdomFileDouble( path );
+    }
+};
+#endif
+
+#if defined(ITKPhase_USE_FFTWL)
+template<>
+class DCTProxy< long double >
+{
+public:
+  typedef long double   PixelType;
+  typedef fftwl_plan    PlanType;
+  typedef DCTProxy      Self;
+
+  static const bool IsAvailable = true;
+
+  static PlanType Plan_r2r( int rank,
+                            const int * n,
+                            PixelType * in,
+                            PixelType * out,
+                            const fftw_r2r_kind * kind,
+                            unsigned int flags,
+                            int threads )
+    {
+    Self::InitializeThreads();
+    fftwl_plan_with_nthreads( threads );
+    return fftwl_plan_r2r( rank, n, in, out, kind, flags );
+    }
+
+  /** Plan howmany transforms of the same size, each starting distance
+   * elements after the previous one, with elements stride apart. */
+  static PlanType Plan_many_r2r( int rank,
+                                 const int * n,
+                                 int howmany,
+                                 PixelType * in,
+                                 PixelType * out,
+                                 int stride,
+                                 int distance,
+                                 const fftw_r2r_kind * kind,
+                                 unsigned int flags,
+                                 int threads )
+    {
+    Self::InitializeThreads();
+    fftwl_plan_with_nthreads( threads );
+    return fftwl_plan_many_r2r( rank, n, howmany,
+                                in, ITK_NULLPTR, stride, distance,
+                                out, ITK_NULLPTR, stride, distance,
+                                kind, flags );
+    }
+
+  static void Execute_r2r( PlanType plan, PixelType * in, PixelType * out )
+    {
+    fftwl_execute_r2r( plan, in, out );
+    }
+
+  static void DestroyPlan( PlanType plan )
+    {
+    fftwl_destroy_plan( plan );
+    }
+
+  static void * Malloc( size_t bytes )
+    {
+    return fftwl_malloc( bytes );
+    }
+
+  static void Free( void * p )
+    {
+    fftwl_free( p );
+    }
+
+  static int AlignmentOf( PixelType * p )
+    {
+    return fftwl_alignment_of( p );
+    }
+
+  // ITK initializes threading for fftwf and fftw only.  Called while
+  // holding the planner lock.
+  static void InitializeThreads()
+    {
+    static bool threadsInitialized = false;
+    if ( !threadsInitialized )
+      {
+      fftwl_init_threads();
+      threadsInitialized = true;
+      }
+    }
+
+  // FFTWGlobalConfiguration only manages float and double wisdom.
+  static bool ImportWisdomFile( const std::string & path )
+    {
+    return 0 != fftwl_import_wisdom_from_filename( path.c_str() );
+    }
+
+  static bool ExportWisdomFile( const std::string & path )
+    {
+    return 0 != fftwl_export_wisdom_to_filename( path.c_str() );
+    }
+};
+#endif
+
+#endif
+
+} // end namespace fftw
+} // end namespace itk
+
+#endif
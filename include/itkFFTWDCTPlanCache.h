@@ -0,0 +1,368 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkFFTWDCTPlanCache_h
+#define itkFFTWDCTPlanCache_h
+
+#include "itkFFTWDCTCommon.h"
+#include "itkLightObject.h"
+#include "itkObjectFactory.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
+#include <list>
+#include <vector>
+
+// The plans are those of FFTW, so nothing is defined without it.
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+
+namespace itk
+{
+
+/** \class FFTWDCTPlan
+ *  \ingroup ITKPhase
+ * \brief Reference counted owner of an FFTW real-to-real plan.
+ *
+ * The plan is destroyed when the last reference is released, so a plan which
+ * has been evicted from the FFTWDCTPlanCache remains valid for any filter
+ * which is still executing it.  The FFTW precision is selected by TPixel
+ * through fftw::DCTProxy.
+ */
+template< typename TPixel >
+class FFTWDCTPlan:
+public LightObject
+{
+public:
+
+  typedef FFTWDCTPlan                Self;
+  typedef LightObject                Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  typedef fftw::DCTProxy< TPixel >         FFTWProxyType;
+  typedef typename FFTWProxyType::PlanType PlanType;
+
+  /** Method for creation through object factory */
+  itkNewMacro(Self);
+
+  /** Run-time type information */
+  itkTypeMacro(FFTWDCTPlan, LightObject);
+
+  void SetPlan( PlanType plan )
+    {
+    this->m_Plan = plan;
+    }
+  PlanType GetPlan() const
+    {
+    return this->m_Plan;
+    }
+
+  /** Execute the plan on a new pair of arrays.  The arrays must have the same
+   * size, alignment and in-place/out-of-place relationship as those used to
+   * create the plan (see FFTWDCTPlanCache). */
+  void Execute( TPixel * in, TPixel * out ) const
+    {
+    FFTWProxyType::Execute_r2r( this->m_Plan, in, out );
+    }
+
+protected:
+
+  FFTWDCTPlan() : m_Plan( ITK_NULLPTR ) {}
+  ~FFTWDCTPlan()
+    {
+    if ( ITK_NULLPTR != this->m_Plan )
+      {
+      MutexLockHolder< SimpleFastMutexLock > lock( FFTWGlobalConfiguration::GetLockMutex() );
+      FFTWProxyType::DestroyPlan( this->m_Plan );
+      }
+    }
+
+private:
+
+  ITK_DISALLOW_COPY_AND_ASSIGN(FFTWDCTPlan);
+
+  PlanType m_Plan;
+
+};
+
+/** \class FFTWDCTPlanCache
+ *  \ingroup ITKPhase
+ * \brief Process-wide cache of FFTW real-to-real plans used by the DCT filters.
+ *
+ * Creating an FFTW plan is expensive relative to executing it, particularly
+ * for iterative solvers such as PCGPhaseUnwrappingImageFilter, which perform
+ * two transforms per iteration, and for series of identically sized images.
+ * Plans are keyed on the logical array size, the transform kind in each
+ * dimension (which encodes the transform direction), whether the transform
+ * is in-place, the SIMD alignment of the input and output arrays, the
+ * planner flags, the number of threads and, for batched transforms, the
+ * number of transforms and their layout.  Plans are shared across Update() calls and across filter
+ * instances, and are executed on new arrays through fftw_execute_r2r.
+ *
+ * Planner rigors other than FFTW_ESTIMATE measure candidate plans by running
+ * them; in that case the plan is created on scratch arrays of matching
+ * alignment so that the caller's data is preserved.  Plans measured in this
+ * way add to the FFTW wisdom, which may be saved and restored through
+ * FFTWGlobalConfiguration.
+ *
+ * The cache is bounded: once more than GetMaximumNumberOfPlans() plans have
+ * been created, the least recently used plan is released.  Setting the
+ * maximum to zero disables caching.  Clear() releases all cached plans.
+ *
+ * Each pixel type has its own cache, since fftwf, fftw and fftwl plans are
+ * distinct.
+ */
+template< typename TPixel >
+class FFTWDCTPlanCache
+{
+public:
+
+  typedef FFTWDCTPlanCache                 Self;
+  typedef FFTWDCTPlan< TPixel >            PlanType;
+  typedef typename PlanType::Pointer       PlanPointer;
+  typedef typename PlanType::FFTWProxyType FFTWProxyType;
+
+  /** Return a plan for the requested transform, creating it if necessary.
+   * When howmany is greater than one, the plan performs howmany transforms
+   * of the same size, each starting distance elements after the previous one,
+   * with the elements of each transform stride apart (see
+   * fftw_plan_many_r2r). */
+  static PlanPointer GetPlan( int rank,
+                              const int * n,
+                              const fftw_r2r_kind * kind,
+                              TPixel * in,
+                              TPixel * out,
+                              unsigned int flags,
+                              int threads = 1,
+                              int howmany = 1,
+                              int stride = 1,
+                              int distance = 0 )
+    {
+
+    const KeyType key( rank, n, kind, in, out, flags, threads, howmany, stride, distance );
+
+    // Look for an existing plan, moving it to the front of the list.
+      {
+      MutexLockHolder< SimpleFastMutexLock > lock( Self::GetCacheMutex() );
+      CacheType & cache = Self::GetCache();
+      for ( IteratorType it = cache.begin(); it != cache.end(); ++it )
+        {
+        if ( it->first == key )
+          {
+          cache.splice( cache.begin(), cache, it );
+          return cache.front().second;
+          }
+        }
+      }
+
+    // Create a new plan.  The FFTW planner is not thread safe.
+    PlanPointer plan = PlanType::New();
+      {
+      MutexLockHolder< SimpleFastMutexLock > lock( FFTWGlobalConfiguration::GetLockMutex() );
+      if ( Self::PlannerOverwritesArrays( flags ) )
+        {
+        // Plan on scratch arrays with the same alignment, so that measuring
+        // does not destroy the caller's data.
+        SizeValueType numberOfElements = 1;
+        for ( int d = 0; d < rank; ++d )
+          {
+          numberOfElements *= n[d];
+          }
+        const SizeValueType footprint
+          = ( howmany - 1 ) * static_cast< SizeValueType >( distance ) + ( numberOfElements - 1 ) * stride + 1;
+        const size_t bytes = sizeof( TPixel ) * footprint + 64;
+        char * scratchIn = static_cast< char * >( FFTWProxyType::Malloc( bytes ) );
+        char * scratchOut = ( in == out ) ? scratchIn : static_cast< char * >( FFTWProxyType::Malloc( bytes ) );
+        plan->SetPlan( Self::Plan( rank,
+                                   n,
+                                   kind,
+                                   reinterpret_cast< TPixel * >( scratchIn + key.InputAlignment ),
+                                   reinterpret_cast< TPixel * >( scratchOut + key.OutputAlignment ),
+                                   flags,
+                                   threads,
+                                   howmany,
+                                   stride,
+                                   distance ) );
+        if ( scratchOut != scratchIn )
+          {
+          FFTWProxyType::Free( scratchOut );
+          }
+        FFTWProxyType::Free( scratchIn );
+        FFTWGlobalConfiguration::SetNewWisdomAvailable( true );
+        }
+      else
+        {
+        plan->SetPlan( Self::Plan( rank, n, kind, in, out, flags, threads, howmany, stride, distance ) );
+        }
+      }
+
+    // Insert it, releasing the least recently used plans outside of the lock.
+    CacheType evicted;
+      {
+      MutexLockHolder< SimpleFastMutexLock > lock( Self::GetCacheMutex() );
+      CacheType & cache = Self::GetCache();
+      cache.push_front( EntryType( key, plan ) );
+      while ( cache.size() > Self::GetMaximumNumberOfPlansReference() )
+        {
+        evicted.splice( evicted.begin(), cache, --cache.end() );
+        }
+      }
+
+    return plan;
+
+    }
+
+  /** Release all cached plans. */
+  static void Clear()
+    {
+    CacheType evicted;
+    MutexLockHolder< SimpleFastMutexLock > lock( Self::GetCacheMutex() );
+    evicted.swap( Self::GetCache() );
+    }
+
+  /** Bound the number of cached plans.  Zero disables caching. */
+  static void SetMaximumNumberOfPlans( SizeValueType maximum )
+    {
+    CacheType evicted;
+    MutexLockHolder< SimpleFastMutexLock > lock( Self::GetCacheMutex() );
+    Self::GetMaximumNumberOfPlansReference() = maximum;
+    CacheType & cache = Self::GetCache();
+    while ( cache.size() > maximum )
+      {
+      evicted.splice( evicted.begin(), cache, --cache.end() );
+      }
+    }
+  static SizeValueType GetMaximumNumberOfPlans()
+    {
+    MutexLockHolder< SimpleFastMutexLock > lock( Self::GetCacheMutex() );
+    return Self::GetMaximumNumberOfPlansReference();
+    }
+
+  /** Number of plans currently held by the cache. */
+  static SizeValueType GetNumberOfPlans()
+    {
+    MutexLockHolder< SimpleFastMutexLock > lock( Self::GetCacheMutex() );
+    return Self::GetCache().size();
+    }
+
+private:
+
+  /** Call the planner; must hold the FFTW lock. */
+  static typename PlanType::PlanType Plan( int rank,
+                                           const int * n,
+                                           const fftw_r2r_kind * kind,
+                                           TPixel * in,
+                                           TPixel * out,
+                                           unsigned int flags,
+                                           int threads,
+                                           int howmany,
+                                           int stride,
+                                           int distance )
+    {
+    if ( 1 == howmany && 1 == stride )
+      {
+      return FFTWProxyType::Plan_r2r( rank, n, in, out, kind, flags, threads );
+      }
+    return FFTWProxyType::Plan_many_r2r( rank, n, howmany, in, out, stride, distance, kind, flags, threads );
+    }
+
+  /** Only FFTW_ESTIMATE and FFTW_WISDOM_ONLY leave the arrays untouched. */
+  static bool PlannerOverwritesArrays( unsigned int flags )
+    {
+    return !( flags & ( FFTW_ESTIMATE | FFTW_WISDOM_ONLY ) );
+    }
+
+  /** Everything which determines whether a plan may be reused. */
+  struct KeyType
+    {
+    KeyType( int rank,
+             const int * n,
+             const fftw_r2r_kind * kind,
+             TPixel * in,
+             TPixel * out,
+             unsigned int flags,
+             int threads,
+             int howmany,
+             int stride,
+             int distance ) :
+      Size( n, n + rank ),
+      Kind( kind, kind + rank ),
+      InPlace( in == out ),
+      InputAlignment( FFTWProxyType::AlignmentOf( in ) ),
+      OutputAlignment( FFTWProxyType::AlignmentOf( out ) ),
+      Flags( flags ),
+      Threads( threads ),
+      HowMany( howmany ),
+      Stride( stride ),
+      Distance( ( 1 == howmany ) ? 0 : distance )
+      {}
+
+    bool operator==( const KeyType & other ) const
+      {
+      return this->Size == other.Size
+        && this->Kind == other.Kind
+        && this->InPlace == other.InPlace
+        && this->InputAlignment == other.InputAlignment
+        && this->OutputAlignment == other.OutputAlignment
+        && this->Flags == other.Flags
+        && this->Threads == other.Threads
+        && this->HowMany == other.HowMany
+        && this->Stride == other.Stride
+        && this->Distance == other.Distance;
+      }
+
+    std::vector< int >           Size;
+    std::vector< fftw_r2r_kind > Kind;
+    bool                         InPlace;
+    int                          InputAlignment;
+    int                          OutputAlignment;
+    unsigned int                 Flags;
+    int                          Threads;
+    int                          HowMany;
+    int                          Stride;
+    int                          Distance;
+    };
+
+  typedef std::pair< KeyType, PlanPointer > EntryType;
+  typedef std::list< EntryType >            CacheType;
+  typedef typename CacheType::iterator      IteratorType;
+
+  // Function-local statics keep the cache shared by every translation unit
+  // without requiring a compiled library for this module.
+  static CacheType & GetCache()
+    {
+    static CacheType cache;
+    return cache;
+    }
+  static SimpleFastMutexLock & GetCacheMutex()
+    {
+    static SimpleFastMutexLock mutex;
+    return mutex;
+    }
+  static SizeValueType & GetMaximumNumberOfPlansReference()
+    {
+    static SizeValueType maximum = 32;
+    return maximum;
+    }
+
+};
+
+}
+
+#endif
+
+#endif
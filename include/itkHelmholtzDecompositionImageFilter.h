@@ -21,12 +21,11 @@
 
 /** ITK headers */
 #include "itkObjectFactory.h"
-#include "itkSubtractImageFilter.h"
 
 /** Custom headers */
 #include "itkPhaseImageToImageFilter.h"
 #include "itkDCTPhaseUnwrappingImageFilter.h"
-#include "itkWrapPhaseSymmetricImageFilter.h"
+#include "itkThreadedRangeLoop.h"
 
 namespace itk {
 
@@ -39,6 +38,11 @@ namespace itk {
  * and provides the rotational and irrotational components of the phase as outputs,
  * through the GetRotational() and GetIrrotational() methods, respectively.
  *
+ * The irrotational component is the wrapped DCT unwrapping solution, and the
+ * rotational component is the input less the irrotational, wrapped.  Both are
+ * written in one threaded pass over the solution, the irrotational in place
+ * in the solver's output buffer, so no temporaries are made.
+ *
  */
 
 template< typename TInputImage, typename TOutputImage = TInputImage >
@@ -72,6 +76,18 @@ public:
   /** Run-time type information (and related methods). */
   itkTypeMacro(HelmholtzDecompositionImageFilter, PhaseImageToImageFilter);
 
+  /** DCTSolver or MultigridSolver, see DCTPhaseUnwrappingImageFilter. */
+  typedef typename DCTPhaseUnwrappingImageFilter< TInputImage >::PoissonSolverEnumType PoissonSolverEnumType;
+
+  /** Set/Get the Poisson solver of the irrotational component.  Default is
+   * DCTSolver. */
+  itkSetMacro(PoissonSolver, PoissonSolverEnumType);
+  itkGetConstMacro(PoissonSolver, PoissonSolverEnumType);
+
+  /** Set/Get the FFTW planner rigor passed to the underlying DCTImageFilter. */
+  itkSetMacro(PlanRigor, int);
+  itkGetConstMacro(PlanRigor, int);
+
   /** Use this to retrieve the phase quality map. */
   TOutputImage* GetIrrotational();
 
@@ -86,13 +102,16 @@ protected:
   HelmholtzDecompositionImageFilter();
   ~HelmholtzDecompositionImageFilter(){}
 
+  /** The decomposition is global, so the whole input is needed and the
+   * whole outputs are generated. */
+  virtual void GenerateInputRequestedRegion() ITK_OVERRIDE;
+  virtual void EnlargeOutputRequestedRegion( DataObject * output ) ITK_OVERRIDE;
+
   /** Does the real work. */
   virtual void GenerateData() ITK_OVERRIDE;
 
   /** Declare component filter types */
   typedef DCTPhaseUnwrappingImageFilter< TInputImage > UnwrapType;
-  typedef SubtractImageFilter< TInputImage >           SubtractType;
-  typedef WrapPhaseSymmetricImageFilter< TInputImage > WrapType;
 
   /** Used to create the output images when the GetOutput(n) method is called. */
   DataObject::Pointer MakeOutput(long unsigned int idx); 
@@ -101,11 +120,22 @@ private:
 
   ITK_DISALLOW_COPY_AND_ASSIGN(HelmholtzDecompositionImageFilter);
   
+  // Wraps the solution in place into the irrotational component, and writes
+  // the wrapped difference from the input as the rotational component
+  struct DecomposeFunctor
+    {
+    void operator()( SizeValueType first, SizeValueType last ) const;
+
+    const typename TInputImage::PixelType * Wrapped;
+    typename TOutputImage::PixelType *      Irrotational;
+    typename TOutputImage::PixelType *      Rotational;
+    };
+
   /** Instantiate component filters */
   typename UnwrapType::Pointer   m_Unwrap;
-  typename SubtractType::Pointer m_Subtract;
-  typename WrapType::Pointer     m_WrapIrrot;
-  typename WrapType::Pointer     m_WrapRot;
+
+  int                   m_PlanRigor;
+  PoissonSolverEnumType m_PoissonSolver;
  
 };
 
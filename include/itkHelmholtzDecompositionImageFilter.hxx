@@ -24,7 +24,9 @@ namespace itk {
 
 template< typename TInputImage, typename TOutputImage >
 HelmholtzDecompositionImageFilter< TInputImage, TOutputImage >
-::HelmholtzDecompositionImageFilter()
+::HelmholtzDecompositionImageFilter() :
+m_PlanRigor(DCTBackend::GetPlanRigor()),
+m_PoissonSolver(UnwrapType::DCTSolver)
 {
   /** There are two required outputs for this filter. */
   this->SetNumberOfRequiredOutputs(2);
@@ -75,6 +77,31 @@ HelmholtzDecompositionImageFilter< TInputImage, TOutputImage >
   return dynamic_cast< TOutputImage * >( this->ProcessObject::GetOutput(1) );
 }
 
+template< typename TInputImage, typename TOutputImage >
+void
+HelmholtzDecompositionImageFilter< TInputImage, TOutputImage >
+::GenerateInputRequestedRegion()
+{
+
+  Superclass::GenerateInputRequestedRegion();
+
+  TInputImage * input = const_cast< TInputImage * >( this->GetInput() );
+  if ( input )
+    {
+    input->SetRequestedRegionToLargestPossibleRegion();
+    }
+
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+HelmholtzDecompositionImageFilter< TInputImage, TOutputImage >
+::EnlargeOutputRequestedRegion( DataObject * output )
+{
+  Superclass::EnlargeOutputRequestedRegion( output );
+  output->SetRequestedRegionToLargestPossibleRegion();
+}
+
 template< typename TInputImage, typename TOutputImage >
 void
 HelmholtzDecompositionImageFilter< TInputImage, TOutputImage >
@@ -82,30 +109,49 @@ HelmholtzDecompositionImageFilter< TInputImage, TOutputImage >
 {
 
   m_Unwrap = UnwrapType::New();
-  m_WrapIrrot = WrapType::New();
-  m_Subtract = SubtractType::New();
-  m_WrapRot = WrapType::New();
   
+  m_Unwrap->SetPlanRigor( this->m_PlanRigor );
+  m_Unwrap->SetPoissonSolver( this->m_PoissonSolver );
+  m_Unwrap->SetNumberOfThreads( this->GetNumberOfThreads() );
   m_Unwrap->SetInput( this->GetInput() );
-  m_WrapIrrot->SetInput( m_Unwrap->GetOutput() );
-  
-  m_WrapIrrot->GraftOutput( this->GetIrrotational() ); // Irrotational
-  m_WrapIrrot->Update();
-  this->GraftNthOutput(0, m_WrapIrrot->GetOutput() );
-  
-  m_Subtract->SetInput1( this->GetInput() );
-  m_Subtract->SetInput2( m_WrapIrrot->GetOutput() );
-  
-  m_WrapRot->SetInput( m_Subtract->GetOutput() );
-  
-  m_WrapRot->GraftOutput( this->GetRotational() ); // Rotational
-  m_WrapRot->Update();
-  this->GraftNthOutput(1, m_WrapRot->GetOutput() );
-  
-  this->AllocateOutputs();
+  m_Unwrap->Update();
+
+  // The solution buffer becomes the irrotational output
+  this->GraftNthOutput( 0, m_Unwrap->GetOutput() );
+
+  TOutputImage * rotational = this->GetRotational();
+  rotational->SetBufferedRegion( rotational->GetRequestedRegion() );
+  rotational->Allocate();
+
+  DecomposeFunctor functor;
+  functor.Wrapped = this->GetInput()->GetBufferPointer();
+  functor.Irrotational = this->GetIrrotational()->GetBufferPointer();
+  functor.Rotational = rotational->GetBufferPointer();
+  ThreadedRangeLoop< DecomposeFunctor >::Run( this->GetMultiThreader(),
+                                              this->GetNumberOfThreads(),
+                                              rotational->GetBufferedRegion().GetNumberOfPixels(),
+                                              functor );
 
 } // end GenerateData()
 
+template< typename TInputImage, typename TOutputImage >
+void
+HelmholtzDecompositionImageFilter< TInputImage, TOutputImage >
+::DecomposeFunctor
+::operator()( SizeValueType first, SizeValueType last ) const
+{
+
+  typename Superclass::WrapFunctorType wrap;
+
+  for (SizeValueType p = first; p < last; ++p)
+    {
+    const typename TOutputImage::PixelType irrotational = wrap( this->Irrotational[p] );
+    this->Irrotational[p] = irrotational;
+    this->Rotational[p] = wrap( this->Wrapped[p] - irrotational );
+    }
+
+}
+
 template < typename TInputImage, typename TOutputImage >
 void
 HelmholtzDecompositionImageFilter< TInputImage, TOutputImage >
@@ -113,7 +159,8 @@ HelmholtzDecompositionImageFilter< TInputImage, TOutputImage >
 {
   Superclass::PrintSelf(os,indent);
 
-  os << indent << "No parameters." << std::endl;
+  os << indent << "Plan Rigor: " << DCTBackend::GetPlanRigorName(m_PlanRigor) << std::endl;
+  os << indent << "Poisson Solver: " << (m_PoissonSolver == UnwrapType::MultigridSolver ? "Multigrid" : "DCT") << std::endl;
 }
  
 } // end namespace itk
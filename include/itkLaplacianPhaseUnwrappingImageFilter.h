@@ -0,0 +1,164 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkLaplacianPhaseUnwrappingImageFilter_h
+#define itkLaplacianPhaseUnwrappingImageFilter_h
+
+#include "itkPhaseImageToImageFilter.h"
+#include "itkDCTPoissonSolverImageFilter.h"
+#include "itkThreadedRangeLoop.h"
+#include <vector>
+
+namespace itk {
+
+/** \class LaplacianPhaseUnwrappingImageFilter
+ *  \ingroup ITKPhase
+ * \brief Unwraps phase by the sin/cos Laplacian method.
+ *
+ * The Laplacian of the unwrapped phase is computed from the wrapped phase as
+ *
+ *   lap(phi) = cos(phi) lap(sin(phi)) - sin(phi) lap(cos(phi))
+ *
+ * and inverted by DCTPoissonSolverImageFilter [1].  No differences are wrapped
+ * and nothing is iterated, which makes this the usual fast unwrapper for MRI.
+ *
+ * The Laplacians are taken with the Neumann boundary of the DCT, which is
+ * exactly the operator the DCT eigenvalues diagonalize.  They are therefore
+ * computed by finite differences rather than by two further transform pairs,
+ * and the whole unwrap costs one forward and one inverse DCT.  Expanding the
+ * products, each neighbour n of a pixel c contributes
+ * cos(phi_c) sin(phi_n) - sin(phi_c) cos(phi_n), so sin and cos are evaluated
+ * once per pixel, in one threaded pass, and the Laplacian in a second.
+ *
+ * The solution has zero mean and, like DCTPhaseUnwrappingImageFilter, is not
+ * congruent with the input phase.
+ *
+ * [1] "Fast phase unwrapping algorithm for interferometric applications" by
+ * Marvin A. Schofield and Yimei Zhu, Optics Letters 28(14), 2003.
+ *
+ */
+
+template < typename TInputImage, typename TOutputImage = TInputImage >
+class LaplacianPhaseUnwrappingImageFilter:
+public PhaseImageToImageFilter< TInputImage, TOutputImage >
+{
+public:
+
+//  Standard declarations
+//  Used for object creation with the object factory:
+
+  typedef LaplacianPhaseUnwrappingImageFilter                  Self;
+  typedef PhaseImageToImageFilter< TInputImage, TOutputImage > Superclass;
+  typedef SmartPointer<Self>                                   Pointer;
+  typedef SmartPointer<const Self>                             ConstPointer;
+
+#ifdef ITK_USE_CONCEPT_CHECKING
+  // Begin concept checking
+  itkConceptMacro( SameDimensionCheck,
+                   ( Concept::SameDimension< TInputImage::ImageDimension,
+                   TOutputImage::ImageDimension > ) );
+
+  itkConceptMacro( InputFloatingPointCheck,
+                 ( Concept::IsFloatingPoint< typename TInputImage::PixelType > ) );
+
+  itkConceptMacro( OutputFloatingPointCheck,
+                 ( Concept::IsFloatingPoint< typename TOutputImage::PixelType > ) );
+  // End concept checking
+#endif
+
+  /** Method for creation through object factory */
+  itkNewMacro(Self);
+
+  /** Run-time type information */
+  itkTypeMacro(LaplacianPhaseUnwrappingImageFilter, PhaseImageToImageFilter);
+
+  /** Set/Get the FFTW planner rigor passed to the underlying DCTImageFilter. */
+  itkSetMacro(PlanRigor, int);
+  itkGetConstMacro(PlanRigor, int);
+
+  /** Set/Get whether the Poisson solve is padded to an FFT friendly size.
+   * See DCTPoissonSolverImageFilter::SetPadToEfficientSize(). */
+  itkSetMacro(PadToEfficientSize, bool);
+  itkGetConstMacro(PadToEfficientSize, bool);
+  itkBooleanMacro(PadToEfficientSize);
+
+  /** Set/Get whether the last axis indexes a series of independent frames,
+   * which are unwrapped in one pass.  Default is off. */
+  itkSetMacro(BatchAlongLastAxis, bool);
+  itkGetConstMacro(BatchAlongLastAxis, bool);
+  itkBooleanMacro(BatchAlongLastAxis);
+
+  /** Display */
+  void PrintSelf( std::ostream& os, Indent indent ) const ITK_OVERRIDE;
+
+protected:
+
+  LaplacianPhaseUnwrappingImageFilter();
+  ~LaplacianPhaseUnwrappingImageFilter(){}
+
+  typedef typename TInputImage::PixelType PixelType;
+  typedef typename TInputImage::SizeType  SizeType;
+
+  /** The solution is global, so the whole input is needed and the whole
+   * output is generated. */
+  void GenerateInputRequestedRegion() ITK_OVERRIDE;
+  void EnlargeOutputRequestedRegion( DataObject * output ) ITK_OVERRIDE;
+
+  void GenerateData() ITK_OVERRIDE;
+
+private:
+
+  ITK_DISALLOW_COPY_AND_ASSIGN(LaplacianPhaseUnwrappingImageFilter);
+
+  typedef DCTPoissonSolverImageFilter< TInputImage, TOutputImage > SolverType;
+
+  // Writes sin and cos of each pixel, interleaved
+  struct SinCosFunctor
+    {
+    void operator()( SizeValueType first, SizeValueType last ) const;
+
+    const PixelType * Phase;
+    PixelType *       SinCos;
+    };
+
+  // Sums cos(phi_c) sin(phi_n) - sin(phi_c) cos(phi_n) over the neighbours of
+  // each pixel, line by line along the first axis
+  struct LaplacianFunctor
+    {
+    void operator()( SizeValueType firstLine, SizeValueType lastLine ) const;
+
+    const PixelType * SinCos;
+    PixelType *       Laplacian;
+    SizeType          Size;
+    unsigned int      NumberOfAxes;
+    };
+
+  typename SolverType::Pointer m_Solver;
+
+  int  m_PlanRigor;
+  bool m_PadToEfficientSize;
+  bool m_BatchAlongLastAxis;
+
+};
+
+}
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkLaplacianPhaseUnwrappingImageFilter.hxx"
+#endif
+
+#endif
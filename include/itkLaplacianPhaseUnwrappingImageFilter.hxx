@@ -0,0 +1,216 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkLaplacianPhaseUnwrappingImageFilter_hxx
+#define itkLaplacianPhaseUnwrappingImageFilter_hxx
+
+#include "itkLaplacianPhaseUnwrappingImageFilter.h"
+#include <cmath>
+
+namespace itk
+{
+
+template < typename TInputImage, typename TOutputImage >
+LaplacianPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::LaplacianPhaseUnwrappingImageFilter() :
+m_Solver(SolverType::New()),
+m_PlanRigor(DCTBackend::GetPlanRigor()),
+m_PadToEfficientSize(false),
+m_BatchAlongLastAxis(false)
+{
+  // The Laplacian is computed in index units
+  this->m_Solver->UseImageSpacingOff();
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+LaplacianPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::GenerateInputRequestedRegion()
+{
+
+  Superclass::GenerateInputRequestedRegion();
+
+  TInputImage * input = const_cast< TInputImage * >( this->GetInput() );
+  if ( input )
+    {
+    input->SetRequestedRegionToLargestPossibleRegion();
+    }
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+LaplacianPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::EnlargeOutputRequestedRegion( DataObject * output )
+{
+  Superclass::EnlargeOutputRequestedRegion( output );
+  output->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+LaplacianPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::GenerateData()
+{
+
+  typename TInputImage::ConstPointer input = this->GetInput();
+
+  if ( this->m_BatchAlongLastAxis && TInputImage::ImageDimension < 2 )
+    {
+    itkExceptionMacro( "Batching along the last axis requires at least two dimensions." );
+    }
+
+  const typename TInputImage::RegionType region = input->GetLargestPossibleRegion();
+  const SizeValueType numberOfPixels = region.GetNumberOfPixels();
+
+  // sin and cos of every pixel, evaluated together
+  std::vector< PixelType > sinCos( 2 * numberOfPixels );
+
+  SinCosFunctor sinCosFunctor;
+  sinCosFunctor.Phase = input->GetBufferPointer();
+  sinCosFunctor.SinCos = &sinCos[0];
+  ThreadedRangeLoop< SinCosFunctor >::Run( this->GetMultiThreader(),
+                                           this->GetNumberOfThreads(),
+                                           numberOfPixels,
+                                           sinCosFunctor );
+
+  // Laplacian of the unwrapped phase, in index units
+  typename TInputImage::Pointer laplacian = TInputImage::New();
+  laplacian->CopyInformation( input );
+  laplacian->SetRegions( region );
+  laplacian->Allocate();
+
+  LaplacianFunctor laplacianFunctor;
+  laplacianFunctor.SinCos = &sinCos[0];
+  laplacianFunctor.Laplacian = laplacian->GetBufferPointer();
+  laplacianFunctor.Size = region.GetSize();
+  laplacianFunctor.NumberOfAxes = TInputImage::ImageDimension - ( this->m_BatchAlongLastAxis ? 1 : 0 );
+  ThreadedRangeLoop< LaplacianFunctor >::Run( this->GetMultiThreader(),
+                                              this->GetNumberOfThreads(),
+                                              numberOfPixels / region.GetSize()[0],
+                                              laplacianFunctor );
+
+  sinCos.clear();
+
+  // Invert it
+  this->m_Solver->SetPlanRigor( this->m_PlanRigor );
+  this->m_Solver->SetPadToEfficientSize( this->m_PadToEfficientSize );
+  this->m_Solver->SetBatchAlongLastAxis( this->m_BatchAlongLastAxis );
+  this->m_Solver->SetNumberOfThreads( this->GetNumberOfThreads() );
+  this->m_Solver->SetInput( laplacian );
+  this->m_Solver->Update();
+
+  this->GetOutput()->Graft( this->m_Solver->GetOutput() );
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+LaplacianPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::SinCosFunctor
+::operator()( SizeValueType first, SizeValueType last ) const
+{
+
+  for (SizeValueType p = first; p < last; ++p)
+    {
+    const double phase = this->Phase[p];
+    this->SinCos[2*p] = static_cast< PixelType >( std::sin( phase ) );
+    this->SinCos[2*p + 1] = static_cast< PixelType >( std::cos( phase ) );
+    }
+
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+LaplacianPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::LaplacianFunctor
+::operator()( SizeValueType firstLine, SizeValueType lastLine ) const
+{
+
+  const SizeValueType lineLength = this->Size[0];
+
+  SizeValueType stride[TInputImage::ImageDimension];
+  stride[0] = 1;
+  for (unsigned int d = 1; d < TInputImage::ImageDimension; ++d)
+    {
+    stride[d] = stride[d-1] * this->Size[d-1];
+    }
+
+  IndexValueType index[TInputImage::ImageDimension];
+
+  for (SizeValueType line = firstLine; line < lastLine; ++line)
+    {
+
+    SizeValueType remainder = line;
+    for (unsigned int d = 1; d < TInputImage::ImageDimension; ++d)
+      {
+      index[d] = remainder % this->Size[d];
+      remainder /= this->Size[d];
+      }
+
+    for (SizeValueType i = 0; i < lineLength; ++i)
+      {
+
+      const SizeValueType p = line * lineLength + i;
+      index[0] = i;
+
+      const double s = this->SinCos[2*p];
+      const double c = this->SinCos[2*p + 1];
+
+      // sin(phi_n - phi_c) for each neighbour; a missing neighbour contributes
+      // nothing, which is the Neumann boundary of the DCT
+      double sum = 0.0;
+      for (unsigned int d = 0; d < this->NumberOfAxes; ++d)
+        {
+        const IndexValueType n = this->Size[d];
+        if ( index[d] > 0 )
+          {
+          const PixelType * q = this->SinCos + 2 * ( p - stride[d] );
+          sum += c * q[0] - s * q[1];
+          }
+        if ( index[d] < n - 1 )
+          {
+          const PixelType * q = this->SinCos + 2 * ( p + stride[d] );
+          sum += c * q[0] - s * q[1];
+          }
+        }
+
+      this->Laplacian[p] = static_cast< PixelType >( sum );
+
+      }
+
+    }
+
+}
+
+//  PrintSelf method prints parameters
+
+template < typename TInputImage, typename TOutputImage >
+void
+LaplacianPhaseUnwrappingImageFilter< TInputImage, TOutputImage >
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf(os,indent);
+
+  os << indent << "Plan Rigor: " << DCTBackend::GetPlanRigorName(m_PlanRigor) << std::endl;
+  os << indent << "Pad To Efficient Size: " << (m_PadToEfficientSize ? "On" : "Off") << std::endl;
+  os << indent << "Batch Along Last Axis: " << (m_BatchAlongLastAxis ? "On" : "Off") << std::endl;
+}
+
+} /* end namespace itk */
+
+#endif
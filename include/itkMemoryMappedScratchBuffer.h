@@ -0,0 +1,284 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkMemoryMappedScratchBuffer_h
+#define itkMemoryMappedScratchBuffer_h
+
+#include "itkLightObject.h"
+#include "itkObjectFactory.h"
+#include "itkMacro.h"
+#include "itkIntTypes.h"
+
+#include <cstdlib>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+/** \class MemoryMappedScratchBuffer
+ *  \ingroup ITKPhase
+ * \brief Array of pixels backed by a temporary, memory-mapped file.
+ *
+ * Used by the out-of-core DCT solver to hold arrays larger than the available
+ * memory.  The file is created in GetScratchDirectory() and removed when the
+ * buffer is destroyed (on POSIX systems it is unlinked immediately, so it does
+ * not outlive the process).  Pages are read from the file on demand; once a
+ * range has been processed, Release() allows the operating system to drop it
+ * from memory, which keeps the resident size bounded by the range being worked
+ * on.
+ *
+ * Failures to create or map the file throw an ExceptionObject.
+ */
+template< typename TPixel >
+class MemoryMappedScratchBuffer:
+public LightObject
+{
+public:
+
+  typedef MemoryMappedScratchBuffer  Self;
+  typedef LightObject                Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through object factory */
+  itkNewMacro(Self);
+
+  /** Run-time type information */
+  itkTypeMacro(MemoryMappedScratchBuffer, LightObject);
+
+  /** Create and map a file holding numberOfPixels pixels in the given
+   * directory.  An empty directory selects TMPDIR (TEMP on Windows), or the
+   * current directory if that is not set. */
+  void Allocate( SizeValueType numberOfPixels, const std::string & directory )
+    {
+    this->Deallocate();
+    if ( 0 == numberOfPixels )
+      {
+      return;
+      }
+
+    const std::string dir = directory.empty() ? Self::GetDefaultScratchDirectory() : directory;
+    const size_t bytes = sizeof( TPixel ) * numberOfPixels;
+
+#if defined(_WIN32)
+    char path[MAX_PATH];
+    if ( 0 == GetTempFileNameA( dir.c_str(), "itk", 0, path ) )
+      {
+      itkGenericExceptionMacro( "Unable to create a scratch file in " << dir );
+      }
+    this->m_File = CreateFileA( path, GENERIC_READ | GENERIC_WRITE, 0, ITK_NULLPTR, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, ITK_NULLPTR );
+    if ( INVALID_HANDLE_VALUE == this->m_File )
+      {
+      itkGenericExceptionMacro( "Unable to open the scratch file " << path );
+      }
+    const unsigned long long size = bytes;
+    this->m_Mapping = CreateFileMappingA( this->m_File, ITK_NULLPTR, PAGE_READWRITE,
+                                          static_cast< DWORD >( size >> 32 ),
+                                          static_cast< DWORD >( size & 0xffffffffULL ), ITK_NULLPTR );
+    if ( ITK_NULLPTR == this->m_Mapping )
+      {
+      this->Deallocate();
+      itkGenericExceptionMacro( "Unable to extend the scratch file to " << bytes << " bytes." );
+      }
+    this->m_Buffer = static_cast< TPixel * >( MapViewOfFile( this->m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes ) );
+    if ( ITK_NULLPTR == this->m_Buffer )
+      {
+      this->Deallocate();
+      itkGenericExceptionMacro( "Unable to map " << bytes << " bytes of the scratch file." );
+      }
+#else
+    std::string path = dir + "/itkPhaseScratchXXXXXX";
+    this->m_File = mkstemp( &path[0] );
+    if ( this->m_File < 0 )
+      {
+      itkGenericExceptionMacro( "Unable to create a scratch file in " << dir );
+      }
+    unlink( path.c_str() );
+    if ( 0 != ftruncate( this->m_File, static_cast< off_t >( bytes ) ) )
+      {
+      this->Deallocate();
+      itkGenericExceptionMacro( "Unable to extend the scratch file to " << bytes << " bytes." );
+      }
+    void * buffer = mmap( ITK_NULLPTR, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, this->m_File, 0 );
+    if ( MAP_FAILED == buffer )
+      {
+      this->Deallocate();
+      itkGenericExceptionMacro( "Unable to map " << bytes << " bytes of the scratch file." );
+      }
+    this->m_Buffer = static_cast< TPixel * >( buffer );
+#endif
+
+    this->m_NumberOfPixels = numberOfPixels;
+    }
+
+  TPixel * GetBufferPointer()
+    {
+    return this->m_Buffer;
+    }
+
+  SizeValueType GetNumberOfPixels() const
+    {
+    return this->m_NumberOfPixels;
+    }
+
+  /** Let the operating system drop the pixels [first, first+count) from
+   * memory.  They are read back from the file when next used.  The page which
+   * holds first is dropped too, so the pixels before the range on that page
+   * should be finished with; a page which also holds pixels after the range
+   * is kept, unless the range reaches the end of the buffer.
+   *
+   * Nothing is written synchronously: dirty pages of a shared mapping stay in
+   * the file cache when they are dropped from the mapping, and are written back
+   * by the operating system. */
+  void Release( SizeValueType first, SizeValueType count )
+    {
+    this->Release( first, count, 0, 1 );
+    }
+
+  /** Release numberOfRanges ranges of count pixels, the first starting at
+   * first and each stride pixels after the previous one, such as the rows of
+   * a tile. */
+  void Release( SizeValueType first, SizeValueType count, SizeValueType stride, SizeValueType numberOfRanges )
+    {
+    if ( ITK_NULLPTR == this->m_Buffer || 0 == count )
+      {
+      return;
+      }
+#if defined(_WIN32)
+    for (SizeValueType r = 0; r < numberOfRanges; ++r)
+      {
+      char * begin = reinterpret_cast< char * >( this->m_Buffer + first + r * stride );
+      FlushViewOfFile( begin, count * sizeof( TPixel ) );
+      }
+#else
+    // Only whole pages may be released
+    char * base = reinterpret_cast< char * >( this->m_Buffer );
+    char * bufferEnd = reinterpret_cast< char * >( this->m_Buffer + this->m_NumberOfPixels );
+    const size_t page = static_cast< size_t >( sysconf( _SC_PAGESIZE ) );
+    for (SizeValueType r = 0; r < numberOfRanges; ++r)
+      {
+      char * begin = reinterpret_cast< char * >( this->m_Buffer + first + r * stride );
+      char * end = reinterpret_cast< char * >( this->m_Buffer + first + r * stride + count );
+      begin = base + ( ( begin - base ) / page ) * page;
+      if ( end < bufferEnd )
+        {
+        end = base + ( ( end - base ) / page ) * page;
+        }
+      if ( begin < end )
+        {
+        madvise( begin, end - begin, MADV_DONTNEED );
+        }
+      }
+#endif
+    }
+
+  static std::string GetDefaultScratchDirectory()
+    {
+#if defined(_WIN32)
+    const char * dir = std::getenv( "TEMP" );
+#else
+    const char * dir = std::getenv( "TMPDIR" );
+#endif
+    return ( ITK_NULLPTR != dir && '\0' != dir[0] ) ? std::string( dir ) : std::string( "." );
+    }
+
+protected:
+
+#if defined(_WIN32)
+  MemoryMappedScratchBuffer() :
+    m_Buffer( ITK_NULLPTR ),
+    m_NumberOfPixels( 0 ),
+    m_File( INVALID_HANDLE_VALUE ),
+    m_Mapping( ITK_NULLPTR )
+    {}
+#else
+  MemoryMappedScratchBuffer() :
+    m_Buffer( ITK_NULLPTR ),
+    m_NumberOfPixels( 0 ),
+    m_File( -1 )
+    {}
+#endif
+
+  ~MemoryMappedScratchBuffer()
+    {
+    this->Deallocate();
+    }
+
+  void Deallocate()
+    {
+#if defined(_WIN32)
+    if ( ITK_NULLPTR != this->m_Buffer )
+      {
+      UnmapViewOfFile( this->m_Buffer );
+      }
+    if ( ITK_NULLPTR != this->m_Mapping )
+      {
+      CloseHandle( this->m_Mapping );
+      }
+    if ( INVALID_HANDLE_VALUE != this->m_File )
+      {
+      CloseHandle( this->m_File );
+      }
+    this->m_Mapping = ITK_NULLPTR;
+    this->m_File = INVALID_HANDLE_VALUE;
+#else
+    if ( ITK_NULLPTR != this->m_Buffer )
+      {
+      munmap( this->m_Buffer, sizeof( TPixel ) * this->m_NumberOfPixels );
+      }
+    if ( this->m_File >= 0 )
+      {
+      close( this->m_File );
+      }
+    this->m_File = -1;
+#endif
+    this->m_Buffer = ITK_NULLPTR;
+    this->m_NumberOfPixels = 0;
+    }
+
+private:
+
+  ITK_DISALLOW_COPY_AND_ASSIGN(MemoryMappedScratchBuffer);
+
+  TPixel *      m_Buffer;
+  SizeValueType m_NumberOfPixels;
+
+#if defined(_WIN32)
+  HANDLE m_File;
+  HANDLE m_Mapping;
+#else
+  int    m_File;
+#endif
+
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,150 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMultigridPhaseUnwrappingImageFilter_h
+#define itkMultigridPhaseUnwrappingImageFilter_h
+
+#include "itkPhaseImageToImageFilter.h"
+#include "itkWrappedPhaseLaplacianImageFilter.h"
+#include "itkMultigridPoissonSolver.h"
+
+namespace itk
+{
+/** \class MultigridPhaseUnwrappingImageFilter
+ * \ingroup ITKPhase
+ * \brief Calculates the weighted least squares phase unwrapping solution by multigrid.
+ *
+ * Solves the same weighted Poisson equation as PCGPhaseUnwrappingImageFilter:
+ * the right hand side is the weighted wrapped phase Laplacian computed by
+ * WrappedPhaseLaplacianImageFilter, and the weight of the edge between two
+ * neighbouring pixels is min(w_c^2, w_n^2) of their quality.  Unlike PCG, whose
+ * iteration count grows with the image size, each multigrid cycle costs O(N)
+ * and reduces the residual by a factor which does not depend on the size
+ * (section 5.5 of [1]).
+ *
+ * The equation is solved by MultigridPoissonSolver, which describes the grid
+ * hierarchy and the cycles.  CycleType selects V cycles, W cycles, or a full
+ * multigrid (FMG) pass followed by V cycles.  Cycles are repeated until the
+ * norm of the residual, relative to that of the right hand side, falls below
+ * Tolerance, or NumberOfCycles have been performed.
+ *
+ * When Weighted is off every edge has unit weight, which gives the unweighted
+ * least squares solution of DCTPhaseUnwrappingImageFilter.
+ *
+ * [1] "2D Phase Unwrapping: Theory, Algorithms, and Software" by Dennis C Ghiglia
+ * and Mark D. Pritt.
+ */
+template< class TImage >
+class MultigridPhaseUnwrappingImageFilter:public PhaseImageToImageFilter< TImage, TImage >
+{
+public:
+  /** Standard class typedefs. */
+  typedef MultigridPhaseUnwrappingImageFilter       Self;
+  typedef PhaseImageToImageFilter< TImage, TImage > Superclass;
+  typedef SmartPointer< Self >                      Pointer;
+  typedef SmartPointer< const Self >                ConstPointer;
+
+  typedef enum {VCycle=0, WCycle, FullMultigrid} CycleEnumType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MultigridPhaseUnwrappingImageFilter, PhaseImageToImageFilter);
+
+  /** Display */
+  void PrintSelf( std::ostream& os, Indent indent ) const ITK_OVERRIDE;
+
+  /** Set/Get the cycle.  Default is VCycle. */
+  itkSetMacro( CycleType, CycleEnumType );
+  itkGetConstMacro( CycleType, CycleEnumType );
+
+  /** Set/Get the maximum number of cycles.  Default is 20. */
+  itkSetMacro( NumberOfCycles, unsigned int );
+  itkGetConstMacro( NumberOfCycles, unsigned int );
+
+  /** Set/Get the relative residual at which cycling stops.  Default is 1e-4. */
+  itkSetMacro( Tolerance, double );
+  itkGetConstMacro( Tolerance, double );
+
+  /** Set/Get the Gauss-Seidel sweeps before and after each coarse grid
+   * correction.  Default is 2 each. */
+  itkSetMacro( NumberOfPreSmoothingIterations, unsigned int );
+  itkGetConstMacro( NumberOfPreSmoothingIterations, unsigned int );
+  itkSetMacro( NumberOfPostSmoothingIterations, unsigned int );
+  itkGetConstMacro( NumberOfPostSmoothingIterations, unsigned int );
+
+  /** Set/Get the maximum number of grids, including the finest.  Zero (the
+   * default) coarsens as far as possible. */
+  itkSetMacro( MaximumNumberOfLevels, unsigned int );
+  itkGetConstMacro( MaximumNumberOfLevels, unsigned int );
+
+  /** Set/Get whether the edges are weighted by the phase quality.  Default is on. */
+  itkSetMacro( Weighted, bool );
+  itkGetConstMacro( Weighted, bool );
+  itkBooleanMacro( Weighted );
+
+  /** The number of cycles performed, and the relative residual after them.
+   * Valid after Update(). */
+  itkGetConstMacro( ElapsedCycles, unsigned int );
+  itkGetConstMacro( RelativeResidual, double );
+
+protected:
+
+  MultigridPhaseUnwrappingImageFilter();
+  ~MultigridPhaseUnwrappingImageFilter(){}
+
+  typedef WrappedPhaseLaplacianImageFilter< TImage, TImage > LaplacianType;
+  typedef typename TImage::PixelType                         PixelType;
+  typedef typename TImage::SizeType                          SizeType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TImage::ImageDimension);
+
+  typedef MultigridPoissonSolver< PixelType, TImage::ImageDimension > SolverType;
+
+  /** The solution is global, so the whole output is generated. */
+  void EnlargeOutputRequestedRegion( DataObject * output ) ITK_OVERRIDE;
+
+  /** Does the real work. */
+  void GenerateData() ITK_OVERRIDE;
+
+private:
+
+  ITK_DISALLOW_COPY_AND_ASSIGN(MultigridPhaseUnwrappingImageFilter);
+
+  typename LaplacianType::Pointer m_Laplacian;
+  typename SolverType::Pointer    m_Solver;
+
+  CycleEnumType m_CycleType;
+  unsigned int  m_NumberOfCycles;
+  double        m_Tolerance;
+  unsigned int  m_NumberOfPreSmoothingIterations;
+  unsigned int  m_NumberOfPostSmoothingIterations;
+  unsigned int  m_MaximumNumberOfLevels;
+  bool          m_Weighted;
+
+  unsigned int  m_ElapsedCycles;
+  double        m_RelativeResidual;
+
+};
+} //namespace ITK
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkMultigridPhaseUnwrappingImageFilter.hxx"
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMultigridPhaseUnwrappingImageFilter_hxx
+#define itkMultigridPhaseUnwrappingImageFilter_hxx
+
+#include "itkMultigridPhaseUnwrappingImageFilter.h"
+#include "itkImageRegionIterator.h"
+#include "itkImageRegionConstIterator.h"
+#include <algorithm>
+#include <vector>
+
+namespace itk {
+
+template< typename TImage >
+MultigridPhaseUnwrappingImageFilter< TImage >
+::MultigridPhaseUnwrappingImageFilter() :
+m_Laplacian(LaplacianType::New()),
+m_Solver(SolverType::New()),
+m_CycleType(VCycle),
+m_NumberOfCycles(20),
+m_Tolerance(1e-4),
+m_NumberOfPreSmoothingIterations(2),
+m_NumberOfPostSmoothingIterations(2),
+m_MaximumNumberOfLevels(0),
+m_Weighted(true),
+m_ElapsedCycles(0),
+m_RelativeResidual(0.0)
+{}
+
+template< typename TImage >
+void
+MultigridPhaseUnwrappingImageFilter< TImage >
+::EnlargeOutputRequestedRegion( DataObject * output )
+{
+  Superclass::EnlargeOutputRequestedRegion( output );
+  output->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template< typename TImage >
+void
+MultigridPhaseUnwrappingImageFilter< TImage >
+::GenerateData()
+{
+
+  typename TImage::ConstPointer input = this->GetInput();
+  typename TImage::Pointer output = this->GetOutput();
+  this->AllocateOutputs();
+
+  const typename TImage::RegionType region = input->GetLargestPossibleRegion();
+
+  // Right hand side, and the edge weights it was weighted with
+  this->m_Laplacian->SetInput( input );
+  this->m_Laplacian->SetWeighted( this->m_Weighted );
+  this->m_Laplacian->SetNumberOfThreads( this->GetNumberOfThreads() );
+  this->m_Laplacian->Update();
+
+  const SizeType size = region.GetSize();
+  const SizeValueType numberOfPixels = region.GetNumberOfPixels();
+
+  this->m_Solver->Allocate( size );
+
+  PixelType * rhs = this->m_Solver->GetRightHandSide();
+  ImageRegionConstIterator< TImage > rIt( this->m_Laplacian->GetOutput(), region );
+  for (rIt.GoToBegin(); !rIt.IsAtEnd(); ++rIt, ++rhs)
+    {
+    *rhs = rIt.Get();
+    }
+  rhs = this->m_Solver->GetRightHandSide();
+
+  PixelType * weights[ImageDimension];
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    weights[d] = this->m_Solver->GetWeights( d );
+    }
+
+  // The weighted Laplacian already has the symmetric Neumann form, so its
+  // edge weights are taken as they are
+  if ( this->m_Weighted )
+    {
+    const typename LaplacianType::OperatorType & weightedLaplacian
+      = this->m_Laplacian->GetWeightedLaplacianOperator();
+    for (unsigned int d = 0; d < ImageDimension; ++d)
+      {
+      std::copy( weightedLaplacian.GetWeights( d ), weightedLaplacian.GetWeights( d ) + numberOfPixels,
+                 weights[d] );
+      }
+    }
+  else
+    {
+
+    // The reflection of the unweighted Laplacian at the boundary makes its
+    // equation nonsymmetric.  Halving the equation of a pixel once per axis
+    // along which it lies on the boundary gives the symmetric Neumann form,
+    // with the edges which run along the boundary halved, and the same
+    // solution.
+    IndexValueType index[ImageDimension];
+    for (SizeValueType p = 0; p < numberOfPixels; ++p)
+      {
+
+      SizeValueType remainder = p;
+      double scale = 1.0;
+      for (unsigned int d = 0; d < ImageDimension; ++d)
+        {
+        index[d] = remainder % size[d];
+        remainder /= size[d];
+        if ( SolverType::IsOnBoundary( size, d, index[d] ) )
+          {
+          scale *= 0.5;
+          }
+        }
+      rhs[p] = static_cast< PixelType >( scale * rhs[p] );
+
+      for (unsigned int d = 0; d < ImageDimension; ++d)
+        {
+        // The last pixel along the axis has no successor
+        if ( index[d] == static_cast< IndexValueType >( size[d] ) - 1 )
+          {
+          continue;
+          }
+        double weight = 1.0;
+
+        // Both ends of the edge lie on the boundary of the other axes
+        for (unsigned int e = 0; e < ImageDimension; ++e)
+          {
+          if ( e != d && SolverType::IsOnBoundary( size, e, index[e] ) )
+            {
+            weight *= 0.5;
+            }
+          }
+        weights[d][p] = static_cast< PixelType >( weight );
+        }
+
+      }
+
+    }
+
+  this->m_Solver->SetCycleType( static_cast< typename SolverType::CycleEnumType >( this->m_CycleType ) );
+  this->m_Solver->SetNumberOfCycles( this->m_NumberOfCycles );
+  this->m_Solver->SetTolerance( this->m_Tolerance );
+  this->m_Solver->SetNumberOfPreSmoothingIterations( this->m_NumberOfPreSmoothingIterations );
+  this->m_Solver->SetNumberOfPostSmoothingIterations( this->m_NumberOfPostSmoothingIterations );
+  this->m_Solver->SetMaximumNumberOfLevels( this->m_MaximumNumberOfLevels );
+  this->m_Solver->Solve( this->GetMultiThreader(), this->GetNumberOfThreads() );
+
+  this->m_ElapsedCycles = this->m_Solver->GetElapsedCycles();
+  this->m_RelativeResidual = this->m_Solver->GetRelativeResidual();
+
+  ImageRegionIterator< TImage > oIt( output, region );
+  const PixelType * sol = this->m_Solver->GetSolution();
+  for (oIt.GoToBegin(); !oIt.IsAtEnd(); ++oIt, ++sol)
+    {
+    oIt.Set( *sol );
+    }
+
+  this->m_Solver->Release();
+
+}
+
+//  PrintSelf method prints parameters
+
+template < class TImage >
+void
+MultigridPhaseUnwrappingImageFilter< TImage >::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf(os,indent);
+
+  os << indent << "Cycle Type: " << m_CycleType << std::endl;
+  os << indent << "Number Of Cycles: " << m_NumberOfCycles << std::endl;
+  os << indent << "Tolerance: " << m_Tolerance << std::endl;
+  os << indent << "Number Of Pre Smoothing Iterations: " << m_NumberOfPreSmoothingIterations << std::endl;
+  os << indent << "Number Of Post Smoothing Iterations: " << m_NumberOfPostSmoothingIterations << std::endl;
+  os << indent << "Maximum Number Of Levels: " << m_MaximumNumberOfLevels << std::endl;
+  os << indent << "Weighted: " << (m_Weighted ? "On" : "Off") << std::endl;
+  os << indent << "Elapsed Cycles: " << m_ElapsedCycles << std::endl;
+  os << indent << "Relative Residual: " << m_RelativeResidual << std::endl;
+}
+
+}// end namespace itk
+
+#endif
@@ -0,0 +1,361 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMultigridPoissonSolver_h
+#define itkMultigridPoissonSolver_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkSize.h"
+#include "itkMultiThreader.h"
+#include "itkThreadedRangeLoop.h"
+#include <vector>
+
+namespace itk
+{
+/** \class MultigridPoissonSolver
+ * \ingroup ITKPhase
+ * \brief Solves a weighted Poisson equation with Neumann boundaries by multigrid.
+ *
+ * Solves sum_n w_cn (u_n - u_c) = f_c on a pixel buffer, where the sum runs over
+ * the neighbours n of each pixel c along every axis and w_cn >= 0 is the weight
+ * of the edge between them.  Edges which would leave the grid are absent
+ * (homogeneous Neumann boundary).  The equation is singular; the mean of the
+ * right hand side is removed, which makes it consistent, and the solution is
+ * returned with zero mean.
+ *
+ * The finest grid is set up by Allocate(), after which the right hand side and
+ * the edge weights are written through GetRightHandSide() and GetWeights().
+ * GetWeights( d )[p] is the weight of the edge between pixel p and its
+ * successor along axis d.  Solve() builds the grid hierarchy and cycles:
+ *
+ * - every axis longer than one pixel is halved, until no axis is longer than
+ *   two pixels or MaximumNumberOfLevels is reached, but not before every axis
+ *   is at most MaximumCoarsestGridLength pixels long;
+ * - the weight of a coarse edge is the mean of the fine edges crossing the face
+ *   between the two coarse cells, scaled to the coarse index units, computed
+ *   across threads by lines of the coarse grid;
+ * - corrections are prolongated by cell centred multilinear interpolation and
+ *   residuals are restricted by its transpose;
+ * - smoothing is red-black Gauss-Seidel, split across threads by lines along
+ *   the first axis; pre-smoothing sweeps red then black, and post-smoothing
+ *   black then red, so that with as many sweeps of each a cycle from zero is
+ *   a symmetric operator;
+ * - the coarsest grid is smoothed until its residual is negligible, or for at
+ *   most 16 + 2 n^2 sweeps, n being its longest axis.
+ *
+ * CycleType selects V cycles, W cycles, or a full multigrid (FMG) pass, which
+ * solves on the coarsest grid first and interpolates upwards, followed by V
+ * cycles.  Cycles are repeated until the norm of the residual, relative to
+ * that of the right hand side, falls below Tolerance, or NumberOfCycles have
+ * been performed.
+ *
+ * As a preconditioner, the solver applies a fixed linear operator: Setup()
+ * builds the hierarchy once, after which each ApplyCycle() runs a single
+ * cycle from a zero solution, reusing the coarse grids.
+ *
+ * When BatchAlongLastAxis is on, the last axis indexes independent frames: it
+ * is not coarsened, and the mean is removed from each frame separately.  The
+ * weights along the last axis should then be zero.
+ *
+ * This class is the engine of MultigridPoissonSolverImageFilter and
+ * MultigridPhaseUnwrappingImageFilter.
+ */
+template< typename TPixel, unsigned int VDimension >
+class MultigridPoissonSolver:public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef MultigridPoissonSolver     Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  typedef TPixel             PixelType;
+  typedef Size< VDimension > SizeType;
+
+  typedef enum {VCycle=0, WCycle, FullMultigrid} CycleEnumType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, VDimension);
+
+  /** The longest the coarsest grid may be along an axis which is coarsened.
+   * Gauss-Seidel takes O(n^2) sweeps on a grid n pixels long. */
+  itkStaticConstMacro(MaximumCoarsestGridLength, unsigned int, 16);
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MultigridPoissonSolver, Object);
+
+  /** Set/Get the cycle.  Default is VCycle. */
+  itkSetMacro( CycleType, CycleEnumType );
+  itkGetConstMacro( CycleType, CycleEnumType );
+
+  /** Set/Get the maximum number of cycles.  Default is 20. */
+  itkSetMacro( NumberOfCycles, unsigned int );
+  itkGetConstMacro( NumberOfCycles, unsigned int );
+
+  /** Set/Get the relative residual at which cycling stops.  Default is 1e-4. */
+  itkSetMacro( Tolerance, double );
+  itkGetConstMacro( Tolerance, double );
+
+  /** Set/Get the Gauss-Seidel sweeps before and after each coarse grid
+   * correction.  Default is 2 each. */
+  itkSetMacro( NumberOfPreSmoothingIterations, unsigned int );
+  itkGetConstMacro( NumberOfPreSmoothingIterations, unsigned int );
+  itkSetMacro( NumberOfPostSmoothingIterations, unsigned int );
+  itkGetConstMacro( NumberOfPostSmoothingIterations, unsigned int );
+
+  /** Set/Get the maximum number of grids, including the finest.  Zero (the
+   * default) coarsens as far as possible.  A cap which would leave the coarsest
+   * grid longer than MaximumCoarsestGridLength is raised. */
+  itkSetMacro( MaximumNumberOfLevels, unsigned int );
+  itkGetConstMacro( MaximumNumberOfLevels, unsigned int );
+
+  /** Set/Get whether the last axis indexes independent frames.  Default is off. */
+  itkSetMacro( BatchAlongLastAxis, bool );
+  itkGetConstMacro( BatchAlongLastAxis, bool );
+  itkBooleanMacro( BatchAlongLastAxis );
+
+  /** The number of cycles performed, and the relative residual after them.
+   * Valid after Solve(). */
+  itkGetConstMacro( ElapsedCycles, unsigned int );
+  itkGetConstMacro( RelativeResidual, double );
+
+  /** Allocate the finest grid, with a zero right hand side, solution and weights. */
+  void Allocate( const SizeType & size );
+
+  /** Buffers of the finest grid, in the order of an image buffer. */
+  PixelType * GetRightHandSide()
+    {
+    return &this->m_Levels[0].RightHandSide[0];
+    }
+  PixelType * GetSolution()
+    {
+    return &this->m_Levels[0].Solution[0];
+    }
+  PixelType * GetWeights( unsigned int d )
+    {
+    return &this->m_Levels[0].Weights[d][0];
+    }
+
+  /** Give every edge along axis d the weight weights[d], as for the plain
+   * Laplacian.  The last axis is left at zero when batched. */
+  void SetUniformWeights( const double * weights );
+
+  /** Solve, splitting the work across the given threads.  The solution of the
+   * finest grid is used as the initial guess, except by FullMultigrid. */
+  void Solve( MultiThreader * threader, ThreadIdType numberOfThreads );
+
+  /** Build the coarse grids from the weights of the finest grid, and keep
+   * them for ApplyCycle(), splitting the work across the given threads.  Call
+   * again after changing the weights. */
+  void Setup( MultiThreader * threader, ThreadIdType numberOfThreads );
+
+  /** Run one V or W cycle, as CycleType selects, from a zero solution of the
+   * finest grid, and remove its mean.  The grids built by Setup() are kept, so
+   * that repeated calls cost one cycle each.  ElapsedCycles and
+   * RelativeResidual are not updated. */
+  void ApplyCycle();
+
+  /** Free all grids. */
+  void Release()
+    {
+    this->m_Levels.clear();
+    }
+
+  /** Whether index x lies on the boundary of an axis longer than one pixel. */
+  static bool IsOnBoundary( const SizeType & size, unsigned int d, IndexValueType x )
+    {
+    return size[d] > 1 && ( 0 == x || static_cast< IndexValueType >( size[d] ) - 1 == x );
+    }
+
+protected:
+
+  MultigridPoissonSolver();
+  ~MultigridPoissonSolver(){}
+
+  void PrintSelf( std::ostream& os, Indent indent ) const ITK_OVERRIDE;
+
+private:
+
+  ITK_DISALLOW_COPY_AND_ASSIGN(MultigridPoissonSolver);
+
+  // One grid of the hierarchy.  Weights[d][p] is the weight of the edge
+  // between pixel p and its successor along axis d.
+  struct Level
+    {
+    SizeType                 Size;
+    SizeValueType            Stride[VDimension];
+    SizeValueType            NumberOfPixels;
+    unsigned int             Factor[VDimension];
+    std::vector< PixelType > Solution;
+    std::vector< PixelType > RightHandSide;
+    std::vector< PixelType > Residual;
+    std::vector< PixelType > Weights[VDimension];
+    };
+
+  // One red-black Gauss-Seidel half sweep over the pixels of one colour
+  struct SmoothFunctor
+    {
+    void operator()( SizeValueType firstLine, SizeValueType lastLine ) const;
+
+    Level *      Grid;
+    unsigned int Colour;
+    };
+
+  // Residual of the weighted Laplacian equation
+  struct ResidualFunctor
+    {
+    void operator()( SizeValueType firstLine, SizeValueType lastLine ) const;
+
+    Level * Grid;
+    };
+
+  // Restriction of the fine residual, by the transpose of the interpolation
+  struct RestrictFunctor
+    {
+    void operator()( SizeValueType firstLine, SizeValueType lastLine ) const;
+
+    const Level *     Fine;
+    const PixelType * FineValues;
+    Level *           Coarse;
+    };
+
+  // Edge weights of the coarse grid, restricted from those of the fine grid
+  struct CoarsenFunctor
+    {
+    void operator()( SizeValueType firstLine, SizeValueType lastLine ) const;
+
+    const Level * Fine;
+    Level *       Coarse;
+    };
+
+  // Multilinear interpolation of the coarse solution, added to or replacing
+  // the fine solution
+  struct ProlongateFunctor
+    {
+    void operator()( SizeValueType firstLine, SizeValueType lastLine ) const;
+
+    Level *       Fine;
+    const Level * Coarse;
+    bool          Add;
+    };
+
+  /** Build the coarse grid of a level, with its restricted edge weights. */
+  void Coarsen( const Level & fine, Level & coarse );
+
+  /** The fine pixels along axis d which contribute to a coarse pixel, and
+   * their weights.  Returns the number of pixels, at most four. */
+  static unsigned int GetRestrictionStencil( const Level & coarse, unsigned int d, SizeValueType parent,
+                                             SizeValueType fineSize, SizeValueType * children, double * weights );
+
+  /** The two coarse pixels along axis d which a fine pixel is interpolated
+   * from; the first has weight 3/4 and the second 1/4. */
+  static void GetInterpolationParents( const Level & coarse, unsigned int d, SizeValueType j,
+                                       SizeValueType & lower, SizeValueType & upper );
+
+  /** Sum over the neighbours along each axis of the edge weight and the weighted
+   * neighbour value. */
+  static void AccumulateNeighbours( const Level & grid, SizeValueType p,
+                                    const IndexValueType * index,
+                                    double & sumWeight, double & sumWeightedValue );
+
+  /** Subtract the mean of the right hand side of each frame of a grid, which
+   * makes the singular system consistent. */
+  void ProjectRightHandSide( Level & grid ) const;
+
+  /** Red-black sweeps, each black then red when reverse is on. */
+  void Smooth( Level & grid, unsigned int sweeps, bool reverse );
+  void SolveCoarsest( Level & grid );
+  void ComputeResidual( Level & grid );
+  void Restrict( const Level & fine, const PixelType * fineValues, Level & coarse );
+  void Prolongate( const Level & coarse, Level & fine, bool add );
+  void Cycle( unsigned int level, unsigned int gamma );
+
+  /** Build the coarse grids below the finest, splitting the work across the
+   * given threads, which are kept for the passes which follow. */
+  void BuildLevels( MultiThreader * threader, ThreadIdType numberOfThreads );
+
+  /** Subtract the mean of the solution of each frame of a grid. */
+  void RemoveSolutionMean( Level & grid ) const;
+
+  bool IsBatchAxis( unsigned int d ) const
+    {
+    return this->m_BatchAlongLastAxis && VDimension - 1 == d;
+    }
+
+  SizeValueType GetNumberOfFrames( const Level & grid ) const
+    {
+    return this->m_BatchAlongLastAxis ? grid.Size[VDimension - 1] : 1;
+    }
+
+  /** The longest axis which is coarsened. */
+  SizeValueType GetLongestAxis( const Level & grid ) const
+    {
+    SizeValueType longest = 0;
+    for (unsigned int d = 0; d < VDimension; ++d)
+      {
+      if ( !this->IsBatchAxis( d ) && grid.Size[d] > longest )
+        {
+        longest = grid.Size[d];
+        }
+      }
+    return longest;
+    }
+
+  static double GetSquaredNorm( const std::vector< PixelType > & values )
+    {
+    double sum = 0.0;
+    for (SizeValueType p = 0; p < values.size(); ++p)
+      {
+      sum += static_cast< double >( values[p] ) * values[p];
+      }
+    return sum;
+    }
+
+  static SizeValueType GetNumberOfLines( const Level & grid )
+    {
+    return grid.NumberOfPixels / grid.Size[0];
+    }
+
+  CycleEnumType m_CycleType;
+  unsigned int  m_NumberOfCycles;
+  double        m_Tolerance;
+  unsigned int  m_NumberOfPreSmoothingIterations;
+  unsigned int  m_NumberOfPostSmoothingIterations;
+  unsigned int  m_MaximumNumberOfLevels;
+  bool          m_BatchAlongLastAxis;
+
+  unsigned int  m_ElapsedCycles;
+  double        m_RelativeResidual;
+
+  std::vector< Level > m_Levels;
+
+  // Used by the threaded passes of Solve() and ApplyCycle()
+  MultiThreader * m_Threader;
+  ThreadIdType    m_NumberOfThreads;
+
+};
+} //namespace ITK
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkMultigridPoissonSolver.hxx"
+#endif
+
+#endif
@@ -0,0 +1,864 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMultigridPoissonSolver_hxx
+#define itkMultigridPoissonSolver_hxx
+
+#include "itkMultigridPoissonSolver.h"
+#include "itkNumericTraits.h"
+#include <algorithm>
+#include <cmath>
+
+namespace itk {
+
+template< typename TPixel, unsigned int VDimension >
+MultigridPoissonSolver< TPixel, VDimension >
+::MultigridPoissonSolver() :
+m_CycleType(VCycle),
+m_NumberOfCycles(20),
+m_Tolerance(1e-4),
+m_NumberOfPreSmoothingIterations(2),
+m_NumberOfPostSmoothingIterations(2),
+m_MaximumNumberOfLevels(0),
+m_BatchAlongLastAxis(false),
+m_ElapsedCycles(0),
+m_RelativeResidual(0.0),
+m_Threader(ITK_NULLPTR),
+m_NumberOfThreads(1)
+{}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::Allocate( const SizeType & size )
+{
+
+  this->m_Levels.assign( 1, Level() );
+  Level & finest = this->m_Levels[0];
+  finest.Size = size;
+  SizeValueType stride = 1;
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    finest.Stride[d] = stride;
+    finest.Factor[d] = 1;
+    stride *= size[d];
+    }
+  finest.NumberOfPixels = stride;
+
+  finest.Solution.assign( finest.NumberOfPixels, 0 );
+  finest.RightHandSide.assign( finest.NumberOfPixels, 0 );
+  finest.Residual.assign( finest.NumberOfPixels, 0 );
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    finest.Weights[d].assign( finest.NumberOfPixels, 0 );
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::SetUniformWeights( const double * weights )
+{
+
+  Level & finest = this->m_Levels[0];
+
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    std::fill( finest.Weights[d].begin(), finest.Weights[d].end(), 0 );
+    if ( this->IsBatchAxis( d ) || finest.Size[d] < 2 )
+      {
+      continue;
+      }
+
+    // Every pixel but the last along the axis has a successor
+    const SizeValueType n = finest.Size[d];
+    const SizeValueType s = finest.Stride[d];
+    for (SizeValueType p = 0; p < finest.NumberOfPixels; ++p)
+      {
+      if ( ( p / s ) % n != n - 1 )
+        {
+        finest.Weights[d][p] = static_cast< PixelType >( weights[d] );
+        }
+      }
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::Solve( MultiThreader * threader, ThreadIdType numberOfThreads )
+{
+
+  this->BuildLevels( threader, numberOfThreads );
+
+  Level & top = this->m_Levels[0];
+  this->ProjectRightHandSide( top );
+
+  const double rhsNorm = std::sqrt( Self::GetSquaredNorm( top.RightHandSide ) );
+
+  const unsigned int gamma = ( WCycle == this->m_CycleType ) ? 2 : 1;
+
+  this->m_ElapsedCycles = 0;
+  this->m_RelativeResidual = 0.0;
+
+  if ( rhsNorm > 0.0 )
+    {
+
+    // Full multigrid: solve on the coarsest grid, then interpolate each
+    // solution to the next finer grid as the initial guess of a V cycle
+    if ( FullMultigrid == this->m_CycleType && this->m_NumberOfCycles > 0 )
+      {
+      for (unsigned int l = 0; l + 1 < this->m_Levels.size(); ++l)
+        {
+        this->Restrict( this->m_Levels[l], &this->m_Levels[l].RightHandSide[0], this->m_Levels[l+1] );
+        this->ProjectRightHandSide( this->m_Levels[l+1] );
+        }
+      this->Cycle( this->m_Levels.size() - 1, 1 );
+      for (unsigned int l = this->m_Levels.size() - 1; l > 0; --l)
+        {
+        this->Prolongate( this->m_Levels[l], this->m_Levels[l-1], false );
+        this->Cycle( l - 1, 1 );
+        }
+      ++this->m_ElapsedCycles;
+      }
+
+    for (;;)
+      {
+      this->ComputeResidual( top );
+      this->m_RelativeResidual = std::sqrt( Self::GetSquaredNorm( top.Residual ) ) / rhsNorm;
+
+      if ( this->m_RelativeResidual <= this->m_Tolerance || this->m_ElapsedCycles >= this->m_NumberOfCycles )
+        {
+        break;
+        }
+
+      this->Cycle( 0, gamma );
+      ++this->m_ElapsedCycles;
+      }
+
+    }
+  else
+    {
+    std::fill( top.Solution.begin(), top.Solution.end(), 0 );
+    }
+
+  this->RemoveSolutionMean( top );
+
+  // Only the finest grid is kept, for the caller to read
+  this->m_Levels.resize( 1 );
+  this->m_Threader = ITK_NULLPTR;
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::Setup( MultiThreader * threader, ThreadIdType numberOfThreads )
+{
+
+  this->BuildLevels( threader, numberOfThreads );
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::ApplyCycle()
+{
+
+  Level & top = this->m_Levels[0];
+  this->ProjectRightHandSide( top );
+  std::fill( top.Solution.begin(), top.Solution.end(), 0 );
+
+  this->Cycle( 0, ( WCycle == this->m_CycleType ) ? 2 : 1 );
+
+  this->RemoveSolutionMean( top );
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::BuildLevels( MultiThreader * threader, ThreadIdType numberOfThreads )
+{
+
+  this->m_Threader = threader;
+  this->m_NumberOfThreads = numberOfThreads;
+
+  this->m_Levels.resize( 1 );
+  for (;;)
+    {
+    const SizeValueType longest = this->GetLongestAxis( this->m_Levels.back() );
+    if ( longest <= 2
+         || ( this->m_MaximumNumberOfLevels > 0 && this->m_Levels.size() >= this->m_MaximumNumberOfLevels
+              && longest <= MaximumCoarsestGridLength ) )
+      {
+      break;
+      }
+    // The coarse grid is built in place; the fine one is only referenced
+    // once the vector has grown
+    this->m_Levels.push_back( Level() );
+    const SizeValueType n = this->m_Levels.size();
+    this->Coarsen( this->m_Levels[n - 2], this->m_Levels[n - 1] );
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::RemoveSolutionMean( Level & grid ) const
+{
+
+  // The solution is defined up to a constant per frame
+  const SizeValueType frameSize = grid.NumberOfPixels / this->GetNumberOfFrames( grid );
+  for (SizeValueType first = 0; first < grid.NumberOfPixels; first += frameSize)
+    {
+    double mean = 0.0;
+    for (SizeValueType p = first; p < first + frameSize; ++p)
+      {
+      mean += grid.Solution[p];
+      }
+    mean /= frameSize;
+    for (SizeValueType p = first; p < first + frameSize; ++p)
+      {
+      grid.Solution[p] = static_cast< PixelType >( grid.Solution[p] - mean );
+      }
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::Cycle( unsigned int level, unsigned int gamma )
+{
+
+  Level & grid = this->m_Levels[level];
+
+  if ( level + 1 == this->m_Levels.size() )
+    {
+    this->SolveCoarsest( grid );
+    return;
+    }
+
+  Level & coarse = this->m_Levels[level + 1];
+
+  this->Smooth( grid, this->m_NumberOfPreSmoothingIterations, false );
+
+  this->ComputeResidual( grid );
+  this->Restrict( grid, &grid.Residual[0], coarse );
+  this->ProjectRightHandSide( coarse );
+
+  std::fill( coarse.Solution.begin(), coarse.Solution.end(), 0 );
+  for (unsigned int g = 0; g < gamma; ++g)
+    {
+    this->Cycle( level + 1, gamma );
+    }
+
+  this->Prolongate( coarse, grid, true );
+
+  this->Smooth( grid, this->m_NumberOfPostSmoothingIterations, true );
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::Smooth( Level & grid, unsigned int sweeps, bool reverse )
+{
+
+  SmoothFunctor smooth;
+  smooth.Grid = &grid;
+
+  for (unsigned int i = 0; i < sweeps; ++i)
+    {
+    for (unsigned int c = 0; c < 2; ++c)
+      {
+      smooth.Colour = reverse ? 1 - c : c;
+      ThreadedRangeLoop< SmoothFunctor >::Run( this->m_Threader, this->m_NumberOfThreads,
+                                               Self::GetNumberOfLines( grid ), smooth );
+      }
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::SolveCoarsest( Level & grid )
+{
+
+  // Enough sweeps for Gauss-Seidel to converge, checking the residual every
+  // few sweeps, which run forwards and then backwards to keep the cycle
+  // symmetric.  The grid is at most MaximumCoarsestGridLength long, unless
+  // the finest grid is, so the bound stays small.
+  const SizeValueType longest = this->GetLongestAxis( grid );
+  const SizeValueType maximumSweeps = 16 + 2 * longest * longest;
+  const unsigned int sweepsPerCheck = 4;
+
+  // Relative to the right hand side, as far as the pixel type resolves
+  const double tolerance = std::max( 1e-10, 10.0 * NumericTraits< PixelType >::epsilon() );
+  const double squaredBound = tolerance * tolerance * Self::GetSquaredNorm( grid.RightHandSide );
+
+  // Unless batched, the grid is too small for threads to pay off
+  const ThreadIdType numberOfThreads = this->m_NumberOfThreads;
+  if ( grid.NumberOfPixels < 4096 )
+    {
+    this->m_NumberOfThreads = 1;
+    }
+
+  for (SizeValueType sweeps = 0; sweeps < maximumSweeps; sweeps += sweepsPerCheck)
+    {
+    this->Smooth( grid, sweepsPerCheck / 2, false );
+    this->Smooth( grid, sweepsPerCheck / 2, true );
+    this->ComputeResidual( grid );
+    if ( Self::GetSquaredNorm( grid.Residual ) <= squaredBound )
+      {
+      break;
+      }
+    }
+
+  this->m_NumberOfThreads = numberOfThreads;
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::ComputeResidual( Level & grid )
+{
+
+  ResidualFunctor residual;
+  residual.Grid = &grid;
+  ThreadedRangeLoop< ResidualFunctor >::Run( this->m_Threader, this->m_NumberOfThreads,
+                                             Self::GetNumberOfLines( grid ), residual );
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::Restrict( const Level & fine, const PixelType * fineValues, Level & coarse )
+{
+
+  RestrictFunctor restriction;
+  restriction.Fine = &fine;
+  restriction.FineValues = fineValues;
+  restriction.Coarse = &coarse;
+  ThreadedRangeLoop< RestrictFunctor >::Run( this->m_Threader, this->m_NumberOfThreads,
+                                             Self::GetNumberOfLines( coarse ), restriction );
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::Prolongate( const Level & coarse, Level & fine, bool add )
+{
+
+  ProlongateFunctor prolongate;
+  prolongate.Fine = &fine;
+  prolongate.Coarse = &coarse;
+  prolongate.Add = add;
+  ThreadedRangeLoop< ProlongateFunctor >::Run( this->m_Threader, this->m_NumberOfThreads,
+                                               Self::GetNumberOfLines( fine ), prolongate );
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::Coarsen( const Level & fine, Level & coarse )
+{
+
+  SizeValueType stride = 1;
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    coarse.Factor[d] = ( fine.Size[d] > 1 && !this->IsBatchAxis( d ) ) ? 2 : 1;
+    coarse.Size[d] = ( fine.Size[d] + coarse.Factor[d] - 1 ) / coarse.Factor[d];
+    coarse.Stride[d] = stride;
+    stride *= coarse.Size[d];
+    }
+  coarse.NumberOfPixels = stride;
+
+  coarse.Solution.assign( coarse.NumberOfPixels, 0 );
+  coarse.RightHandSide.assign( coarse.NumberOfPixels, 0 );
+  coarse.Residual.assign( coarse.NumberOfPixels, 0 );
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    coarse.Weights[d].assign( coarse.NumberOfPixels, 0 );
+    }
+
+  CoarsenFunctor coarsen;
+  coarsen.Fine = &fine;
+  coarsen.Coarse = &coarse;
+  ThreadedRangeLoop< CoarsenFunctor >::Run( this->m_Threader, this->m_NumberOfThreads,
+                                            Self::GetNumberOfLines( coarse ), coarsen );
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::CoarsenFunctor
+::operator()( SizeValueType firstLine, SizeValueType lastLine ) const
+{
+
+  const Level & fine = *this->Fine;
+  Level & coarse = *this->Coarse;
+  const SizeValueType lineLength = coarse.Size[0];
+
+  // The weight of a coarse edge is the mean weight of the fine edges crossing
+  // the face between the two coarse cells.  Dividing by the square of the
+  // coarsening factor keeps the coarse equation on the scale of the fine one.
+  IndexValueType index[ImageDimension];
+  for (SizeValueType line = firstLine; line < lastLine; ++line)
+    {
+
+    SizeValueType remainder = line;
+    for (unsigned int e = 1; e < ImageDimension; ++e)
+      {
+      index[e] = remainder % coarse.Size[e];
+      remainder /= coarse.Size[e];
+      }
+
+    for (SizeValueType i = 0; i < lineLength; ++i)
+      {
+
+      index[0] = i;
+      const SizeValueType p = line * lineLength + i;
+
+      for (unsigned int d = 0; d < ImageDimension; ++d)
+        {
+
+        if ( coarse.Size[d] < 2 || index[d] == static_cast< IndexValueType >( coarse.Size[d] ) - 1 )
+          {
+          continue;
+          }
+
+        double sum = 0.0;
+        unsigned int count = 0;
+        for (unsigned int corner = 0; corner < ( 1u << ImageDimension ); ++corner)
+          {
+          if ( corner & ( 1u << d ) )
+            {
+            continue;
+            }
+          SizeValueType child = 0;
+          bool inside = true;
+          for (unsigned int e = 0; e < ImageDimension; ++e)
+            {
+            const unsigned int bit = ( corner >> e ) & 1u;
+            const SizeValueType j = coarse.Factor[e] * index[e] + ( ( e == d ) ? coarse.Factor[e] - 1 : bit );
+            if ( ( bit && coarse.Factor[e] == 1 ) || j >= fine.Size[e] )
+              {
+              inside = false;
+              break;
+              }
+            child += j * fine.Stride[e];
+            }
+          if ( inside )
+            {
+            sum += fine.Weights[d][child];
+            ++count;
+            }
+          }
+
+        coarse.Weights[d][p] = static_cast< PixelType >( sum / ( count * coarse.Factor[d] * coarse.Factor[d] ) );
+
+        }
+
+      }
+
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::AccumulateNeighbours( const Level & grid, SizeValueType p, const IndexValueType * index,
+                        double & sumWeight, double & sumWeightedValue )
+{
+
+  sumWeight = 0.0;
+  sumWeightedValue = 0.0;
+
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+
+    const IndexValueType n = grid.Size[d];
+    if ( n < 2 )
+      {
+      continue;
+      }
+
+    const SizeValueType s = grid.Stride[d];
+    const PixelType * w = &grid.Weights[d][0];
+    const PixelType * u = &grid.Solution[0];
+
+    if ( index[d] < n - 1 )
+      {
+      sumWeight += w[p];
+      sumWeightedValue += w[p] * u[p + s];
+      }
+    if ( index[d] > 0 )
+      {
+      sumWeight += w[p - s];
+      sumWeightedValue += w[p - s] * u[p - s];
+      }
+
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::ProjectRightHandSide( Level & grid ) const
+{
+
+  // The operator is singular, with constant null vectors on both sides, one
+  // per frame when batched
+  const SizeValueType frameSize = grid.NumberOfPixels / this->GetNumberOfFrames( grid );
+  for (SizeValueType first = 0; first < grid.NumberOfPixels; first += frameSize)
+    {
+    double sum = 0.0;
+    for (SizeValueType p = first; p < first + frameSize; ++p)
+      {
+      sum += grid.RightHandSide[p];
+      }
+
+    const double bias = sum / frameSize;
+    for (SizeValueType p = first; p < first + frameSize; ++p)
+      {
+      grid.RightHandSide[p] = static_cast< PixelType >( grid.RightHandSide[p] - bias );
+      }
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::SmoothFunctor
+::operator()( SizeValueType firstLine, SizeValueType lastLine ) const
+{
+
+  Level & grid = *this->Grid;
+  const SizeValueType lineLength = grid.Size[0];
+  IndexValueType index[ImageDimension];
+
+  for (SizeValueType line = firstLine; line < lastLine; ++line)
+    {
+
+    // Colour of the first pixel of the line
+    SizeValueType remainder = line;
+    unsigned int parity = 0;
+    for (unsigned int d = 1; d < ImageDimension; ++d)
+      {
+      index[d] = remainder % grid.Size[d];
+      remainder /= grid.Size[d];
+      parity += index[d];
+      }
+
+    for (SizeValueType i = ( this->Colour + parity ) & 1u; i < lineLength; i += 2)
+      {
+      const SizeValueType p = line * lineLength + i;
+      index[0] = i;
+
+      double sumWeight, sumWeightedValue;
+      Self::AccumulateNeighbours( grid, p, index, sumWeight, sumWeightedValue );
+      if ( sumWeight > 0.0 )
+        {
+        grid.Solution[p] = static_cast< PixelType >( ( sumWeightedValue - grid.RightHandSide[p] ) / sumWeight );
+        }
+      }
+
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::ResidualFunctor
+::operator()( SizeValueType firstLine, SizeValueType lastLine ) const
+{
+
+  Level & grid = *this->Grid;
+  const SizeValueType lineLength = grid.Size[0];
+  IndexValueType index[ImageDimension];
+
+  for (SizeValueType line = firstLine; line < lastLine; ++line)
+    {
+
+    SizeValueType remainder = line;
+    for (unsigned int d = 1; d < ImageDimension; ++d)
+      {
+      index[d] = remainder % grid.Size[d];
+      remainder /= grid.Size[d];
+      }
+
+    for (SizeValueType i = 0; i < lineLength; ++i)
+      {
+      const SizeValueType p = line * lineLength + i;
+      index[0] = i;
+
+      double sumWeight, sumWeightedValue;
+      Self::AccumulateNeighbours( grid, p, index, sumWeight, sumWeightedValue );
+      const double laplacian = sumWeightedValue - sumWeight * grid.Solution[p];
+      grid.Residual[p] = static_cast< PixelType >( grid.RightHandSide[p] - laplacian );
+      }
+
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+unsigned int
+MultigridPoissonSolver< TPixel, VDimension >
+::GetRestrictionStencil( const Level & coarse, unsigned int d, SizeValueType parent,
+                         SizeValueType fineSize, SizeValueType * children, double * weights )
+{
+
+  if ( 1 == coarse.Factor[d] )
+    {
+    children[0] = parent;
+    weights[0] = 1.0;
+    return 1;
+    }
+
+  // The transpose of the interpolation, halved: each fine pixel gives 3/4 to
+  // its parent and 1/4 to the neighbour of the parent on its side, or all of
+  // it to the parent at the boundary
+  unsigned int count = 0;
+  for (SizeValueType j = ( parent > 0 ? 2 * parent - 1 : 0 ); j <= 2 * parent + 2 && j < fineSize; ++j)
+    {
+    SizeValueType lower, upper;
+    Self::GetInterpolationParents( coarse, d, j, lower, upper );
+    const double w = ( lower == parent ? 0.75 : 0.0 ) + ( upper == parent ? 0.25 : 0.0 );
+    if ( w > 0.0 )
+      {
+      children[count] = j;
+      weights[count] = 0.5 * w;
+      ++count;
+      }
+    }
+  return count;
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::GetInterpolationParents( const Level & coarse, unsigned int d, SizeValueType j,
+                           SizeValueType & lower, SizeValueType & upper )
+{
+
+  if ( 1 == coarse.Factor[d] )
+    {
+    lower = j;
+    upper = j;
+    return;
+    }
+
+  // Cell centred interpolation: a fine pixel lies a quarter of a coarse cell
+  // from the centre of its parent, towards the neighbour on its side
+  lower = j / 2;
+  if ( ( j & 1u ) && lower + 1 < coarse.Size[d] )
+    {
+    upper = lower + 1;
+    }
+  else if ( !( j & 1u ) && lower > 0 )
+    {
+    upper = lower - 1;
+    }
+  else
+    {
+    upper = lower;
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::RestrictFunctor
+::operator()( SizeValueType firstLine, SizeValueType lastLine ) const
+{
+
+  const Level & fine = *this->Fine;
+  Level & coarse = *this->Coarse;
+  const SizeValueType lineLength = coarse.Size[0];
+
+  SizeValueType children[ImageDimension][4];
+  double        weights[ImageDimension][4];
+  unsigned int  count[ImageDimension];
+
+  for (SizeValueType line = firstLine; line < lastLine; ++line)
+    {
+
+    SizeValueType remainder = line;
+    for (unsigned int d = 1; d < ImageDimension; ++d)
+      {
+      const SizeValueType parent = remainder % coarse.Size[d];
+      remainder /= coarse.Size[d];
+      count[d] = Self::GetRestrictionStencil( coarse, d, parent, fine.Size[d], children[d], weights[d] );
+      }
+
+    for (SizeValueType i = 0; i < lineLength; ++i)
+      {
+
+      count[0] = Self::GetRestrictionStencil( coarse, 0, i, fine.Size[0], children[0], weights[0] );
+
+      // Tensor product of the stencils of each axis
+      unsigned int position[ImageDimension];
+      std::fill( position, position + ImageDimension, 0u );
+      double value = 0.0;
+      for (;;)
+        {
+        double weight = 1.0;
+        SizeValueType child = 0;
+        for (unsigned int d = 0; d < ImageDimension; ++d)
+          {
+          weight *= weights[d][position[d]];
+          child += children[d][position[d]] * fine.Stride[d];
+          }
+        value += weight * this->FineValues[child];
+
+        unsigned int d = 0;
+        while ( d < ImageDimension && ++position[d] == count[d] )
+          {
+          position[d] = 0;
+          ++d;
+          }
+        if ( d == ImageDimension )
+          {
+          break;
+          }
+        }
+
+      coarse.RightHandSide[line * lineLength + i] = static_cast< PixelType >( value );
+
+      }
+
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >
+::ProlongateFunctor
+::operator()( SizeValueType firstLine, SizeValueType lastLine ) const
+{
+
+  Level & fine = *this->Fine;
+  const Level & coarse = *this->Coarse;
+  const SizeValueType lineLength = fine.Size[0];
+
+  SizeValueType lower[ImageDimension];
+  SizeValueType upper[ImageDimension];
+  double        lowerWeight[ImageDimension];
+
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    lowerWeight[d] = ( 2 == coarse.Factor[d] ) ? 0.75 : 1.0;
+    }
+
+  for (SizeValueType line = firstLine; line < lastLine; ++line)
+    {
+
+    SizeValueType remainder = line;
+    for (unsigned int d = 1; d < ImageDimension; ++d)
+      {
+      Self::GetInterpolationParents( coarse, d, remainder % fine.Size[d], lower[d], upper[d] );
+      remainder /= fine.Size[d];
+      }
+
+    for (SizeValueType i = 0; i < lineLength; ++i)
+      {
+
+      Self::GetInterpolationParents( coarse, 0, i, lower[0], upper[0] );
+
+      double value = 0.0;
+      for (unsigned int corner = 0; corner < ( 1u << ImageDimension ); ++corner)
+        {
+        double weight = 1.0;
+        SizeValueType parent = 0;
+        for (unsigned int d = 0; d < ImageDimension; ++d)
+          {
+          if ( ( corner >> d ) & 1u )
+            {
+            weight *= 1.0 - lowerWeight[d];
+            parent += upper[d] * coarse.Stride[d];
+            }
+          else
+            {
+            weight *= lowerWeight[d];
+            parent += lower[d] * coarse.Stride[d];
+            }
+          }
+        if ( weight > 0.0 )
+          {
+          value += weight * coarse.Solution[parent];
+          }
+        }
+
+      const SizeValueType p = line * lineLength + i;
+      if ( this->Add )
+        {
+        fine.Solution[p] = static_cast< PixelType >( fine.Solution[p] + value );
+        }
+      else
+        {
+        fine.Solution[p] = static_cast< PixelType >( value );
+        }
+
+      }
+
+    }
+
+}
+
+
+//  PrintSelf method prints parameters
+
+template< typename TPixel, unsigned int VDimension >
+void
+MultigridPoissonSolver< TPixel, VDimension >::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf(os,indent);
+
+  os << indent << "Cycle Type: " << m_CycleType << std::endl;
+  os << indent << "Number Of Cycles: " << m_NumberOfCycles << std::endl;
+  os << indent << "Tolerance: " << m_Tolerance << std::endl;
+  os << indent << "Number Of Pre Smoothing Iterations: " << m_NumberOfPreSmoothingIterations << std::endl;
+  os << indent << "Number Of Post Smoothing Iterations: " << m_NumberOfPostSmoothingIterations << std::endl;
+  os << indent << "Maximum Number Of Levels: " << m_MaximumNumberOfLevels << std::endl;
+  os << indent << "Batch Along Last Axis: " << (m_BatchAlongLastAxis ? "On" : "Off") << std::endl;
+  os << indent << "Elapsed Cycles: " << m_ElapsedCycles << std::endl;
+  os << indent << "Relative Residual: " << m_RelativeResidual << std::endl;
+}
+
+}// end namespace itk
+
+#endif
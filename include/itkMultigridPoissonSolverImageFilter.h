@@ -0,0 +1,152 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMultigridPoissonSolverImageFilter_h
+#define itkMultigridPoissonSolverImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkMultigridPoissonSolver.h"
+
+namespace itk {
+
+/** \class MultigridPoissonSolverImageFilter
+ *  \ingroup ITKPhase
+ * \brief Solves the Poisson equation on a Laplacian image by geometric multigrid.
+ *
+ * A drop-in alternative to DCTPoissonSolverImageFilter which does not need
+ * FFTW.  The discrete Laplacian and its Neumann boundary are those
+ * diagonalized by the DCT, and the solution is returned with zero mean, so the
+ * two filters agree to within Tolerance.  The solve is done by
+ * MultigridPoissonSolver, by default with a full multigrid pass followed by V
+ * cycles.  Its cost is O(N) for any extent, where the DCT is O(N log N) and
+ * slows down for extents with large prime factors.
+ *
+ * UseImageSpacing and BatchAlongLastAxis have the same meaning as for
+ * DCTPoissonSolverImageFilter.
+ *
+ */
+
+template < typename TInputImage, typename TOutputImage = TInputImage >
+class MultigridPoissonSolverImageFilter:
+public ImageToImageFilter< TInputImage, TOutputImage >
+{
+public:
+
+//  Standard declarations
+//  Used for object creation with the object factory:
+
+  typedef MultigridPoissonSolverImageFilter               Self;
+  typedef ImageToImageFilter< TInputImage, TOutputImage > Superclass;
+  typedef SmartPointer<Self>                              Pointer;
+  typedef SmartPointer<const Self>                        ConstPointer;
+
+#ifdef ITK_USE_CONCEPT_CHECKING
+  // Begin concept checking
+  itkConceptMacro( SameDimensionCheck,
+                   ( Concept::SameDimension< TInputImage::ImageDimension, TOutputImage::ImageDimension > ) );
+
+  itkConceptMacro( InputFloatingPointCheck,
+                   ( Concept::IsFloatingPoint< typename TInputImage::PixelType > ) );
+
+  itkConceptMacro( OutputFloatingPointCheck,
+                   ( Concept::IsFloatingPoint< typename TOutputImage::PixelType > ) );
+  // End concept checking
+#endif
+
+  typedef MultigridPoissonSolver< typename TOutputImage::PixelType, TOutputImage::ImageDimension > SolverType;
+  typedef typename SolverType::CycleEnumType                                                        CycleEnumType;
+
+  /** Method for creation through object factory */
+  itkNewMacro(Self);
+
+  /** Run-time type information */
+  itkTypeMacro(MultigridPoissonSolverImageFilter, ImageToImageFilter);
+
+  /** Set/Get whether the Laplacian is in physical units.  Default is off. */
+  itkSetMacro(UseImageSpacing, bool);
+  itkGetConstMacro(UseImageSpacing, bool);
+  itkBooleanMacro(UseImageSpacing);
+
+  /** Set/Get whether the last axis indexes a series of independent frames.
+   * Each frame is solved over the remaining axes.  Default is off. */
+  itkSetMacro(BatchAlongLastAxis, bool);
+  itkGetConstMacro(BatchAlongLastAxis, bool);
+  itkBooleanMacro(BatchAlongLastAxis);
+
+  /** Set/Get the cycle.  Default is SolverType::FullMultigrid. */
+  itkSetMacro(CycleType, CycleEnumType);
+  itkGetConstMacro(CycleType, CycleEnumType);
+
+  /** Set/Get the maximum number of cycles.  Default is 20. */
+  itkSetMacro(NumberOfCycles, unsigned int);
+  itkGetConstMacro(NumberOfCycles, unsigned int);
+
+  /** Set/Get the relative residual at which cycling stops.  Default is 1e-6. */
+  itkSetMacro(Tolerance, double);
+  itkGetConstMacro(Tolerance, double);
+
+  /** Set/Get the maximum number of grids.  Zero (the default) coarsens as far
+   * as possible. */
+  itkSetMacro(MaximumNumberOfLevels, unsigned int);
+  itkGetConstMacro(MaximumNumberOfLevels, unsigned int);
+
+  /** The number of cycles performed, and the relative residual after them.
+   * Valid after Update(). */
+  itkGetConstMacro(ElapsedCycles, unsigned int);
+  itkGetConstMacro(RelativeResidual, double);
+
+  /** Display */
+  void PrintSelf( std::ostream& os, Indent indent ) const ITK_OVERRIDE;
+
+protected:
+
+  MultigridPoissonSolverImageFilter();
+  ~MultigridPoissonSolverImageFilter(){}
+
+  typedef typename TOutputImage::PixelType PixelType;
+  typedef typename TOutputImage::SizeType  SizeType;
+
+  /** The solution is global, so the whole output is generated. */
+  void EnlargeOutputRequestedRegion( DataObject * output ) ITK_OVERRIDE;
+
+  void GenerateData() ITK_OVERRIDE;
+
+private:
+
+  ITK_DISALLOW_COPY_AND_ASSIGN(MultigridPoissonSolverImageFilter);
+
+  typename SolverType::Pointer m_Solver;
+
+  bool          m_UseImageSpacing;
+  bool          m_BatchAlongLastAxis;
+  CycleEnumType m_CycleType;
+  unsigned int  m_NumberOfCycles;
+  double        m_Tolerance;
+  unsigned int  m_MaximumNumberOfLevels;
+
+  unsigned int  m_ElapsedCycles;
+  double        m_RelativeResidual;
+
+};
+
+}
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkMultigridPoissonSolverImageFilter.hxx"
+#endif
+
+#endif
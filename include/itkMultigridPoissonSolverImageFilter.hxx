@@ -0,0 +1,129 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMultigridPoissonSolverImageFilter_hxx
+#define itkMultigridPoissonSolverImageFilter_hxx
+
+#include "itkMultigridPoissonSolverImageFilter.h"
+#include "itkImageRegionIterator.h"
+#include "itkImageRegionConstIterator.h"
+
+namespace itk
+{
+
+template < typename TInputImage, typename TOutputImage >
+MultigridPoissonSolverImageFilter< TInputImage, TOutputImage >
+::MultigridPoissonSolverImageFilter() :
+m_Solver(SolverType::New()),
+m_UseImageSpacing(false),
+m_BatchAlongLastAxis(false),
+m_CycleType(SolverType::FullMultigrid),
+m_NumberOfCycles(20),
+m_Tolerance(1e-6),
+m_MaximumNumberOfLevels(0),
+m_ElapsedCycles(0),
+m_RelativeResidual(0.0)
+{}
+
+template < typename TInputImage, typename TOutputImage >
+void
+MultigridPoissonSolverImageFilter< TInputImage, TOutputImage >
+::EnlargeOutputRequestedRegion( DataObject * output )
+{
+  Superclass::EnlargeOutputRequestedRegion( output );
+  output->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template < typename TInputImage, typename TOutputImage >
+void
+MultigridPoissonSolverImageFilter< TInputImage, TOutputImage >
+::GenerateData()
+{
+
+  typename TInputImage::ConstPointer input = this->GetInput();
+  typename TOutputImage::Pointer output = this->GetOutput();
+
+  if ( this->m_BatchAlongLastAxis && TOutputImage::ImageDimension < 2 )
+    {
+    itkExceptionMacro( "Batching along the last axis requires at least two dimensions." );
+    }
+
+  this->AllocateOutputs();
+
+  const typename TInputImage::RegionType region = input->GetLargestPossibleRegion();
+
+  this->m_Solver->SetBatchAlongLastAxis( this->m_BatchAlongLastAxis );
+  this->m_Solver->Allocate( region.GetSize() );
+
+  // The DCT Laplacian: unit edges in index units, 1/h^2 in physical units
+  double weights[TOutputImage::ImageDimension];
+  for (unsigned int d = 0; d < TOutputImage::ImageDimension; ++d)
+    {
+    const double spacing = this->m_UseImageSpacing ? output->GetSpacing()[d] : 1.0;
+    weights[d] = 1.0 / ( spacing * spacing );
+    }
+  this->m_Solver->SetUniformWeights( weights );
+
+  PixelType * rhs = this->m_Solver->GetRightHandSide();
+  ImageRegionConstIterator< TInputImage > iIt( input, region );
+  for (iIt.GoToBegin(); !iIt.IsAtEnd(); ++iIt, ++rhs)
+    {
+    *rhs = static_cast< PixelType >( iIt.Get() );
+    }
+
+  this->m_Solver->SetCycleType( this->m_CycleType );
+  this->m_Solver->SetNumberOfCycles( this->m_NumberOfCycles );
+  this->m_Solver->SetTolerance( this->m_Tolerance );
+  this->m_Solver->SetMaximumNumberOfLevels( this->m_MaximumNumberOfLevels );
+  this->m_Solver->Solve( this->GetMultiThreader(), this->GetNumberOfThreads() );
+
+  this->m_ElapsedCycles = this->m_Solver->GetElapsedCycles();
+  this->m_RelativeResidual = this->m_Solver->GetRelativeResidual();
+
+  ImageRegionIterator< TOutputImage > oIt( output, region );
+  const PixelType * sol = this->m_Solver->GetSolution();
+  for (oIt.GoToBegin(); !oIt.IsAtEnd(); ++oIt, ++sol)
+    {
+    oIt.Set( *sol );
+    }
+
+  this->m_Solver->Release();
+
+}
+
+//  PrintSelf method prints parameters
+
+template < typename TInputImage, typename TOutputImage >
+void
+MultigridPoissonSolverImageFilter< TInputImage, TOutputImage >
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf(os,indent);
+
+  os << indent << "Use Image Spacing: " << (m_UseImageSpacing ? "On" : "Off") << std::endl;
+  os << indent << "Batch Along Last Axis: " << (m_BatchAlongLastAxis ? "On" : "Off") << std::endl;
+  os << indent << "Cycle Type: " << m_CycleType << std::endl;
+  os << indent << "Number Of Cycles: " << m_NumberOfCycles << std::endl;
+  os << indent << "Tolerance: " << m_Tolerance << std::endl;
+  os << indent << "Maximum Number Of Levels: " << m_MaximumNumberOfLevels << std::endl;
+  os << indent << "Elapsed Cycles: " << m_ElapsedCycles << std::endl;
+  os << indent << "Relative Residual: " << m_RelativeResidual << std::endl;
+}
+
+} /* end namespace itk */
+
+#endif
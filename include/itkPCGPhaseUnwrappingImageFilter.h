@@ -21,9 +21,16 @@
 #include "itkPhaseImageToImageFilter.h"
 #include "itkObjectFactory.h"
 #include "itkWrappedPhaseLaplacianImageFilter.h"
-#include "itkDCTPhaseUnwrappingImageFilter.h"
+#include "itkDCTPoissonSolverImageFilter.h"
 #include "itkNeighborhoodIterator.h"
 #include "itkImageRegionIterator.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkThreadedRangeLoop.h"
+#include "itkWeightedLaplacianOperator.h"
+#include "itkMultigridPoissonSolver.h"
+#include <algorithm>
+#include <vector>
 
 namespace itk
 {
@@ -33,6 +40,52 @@ namespace itk
  *
  * Please see  "2D Phase Unwrapping: Theory, Algorithms, and Software" by Dennis C Ghiglia
  * and Mark D. Pritt for an excellent introduction to phase unwrapping and phase residues.
+ *
+ * The iterations solve Q s = -L for the unwrapped phase s, where Q applies
+ * the weighted differences of s and L is the weighted Laplacian of the
+ * wrapped phase, starting from zero or from SetInitialSolution().
+ *
+ * The preconditioner is selected at run time.  DCTPreconditioner, the
+ * default, solves Q0 z = r with DCTPoissonSolverImageFilter, where Q0 is Q
+ * with unit weights, so it is exact for uniform quality and ignores the
+ * weights otherwise.  JacobiPreconditioner divides the residual by the
+ * diagonal of Q.  MultigridPreconditioner applies one V cycle of
+ * MultigridPoissonSolver to Q z = r with the edge weights of Q, so it
+ * follows the weights, which pays off on heavily weighted data such as masks
+ * with holes of zero quality.
+ *
+ * When a mask is set, the iterations run only over the bounding box of the
+ * mask, padded by MaskMargin pixels.  Pixels outside the mask have zero
+ * quality, so they carry no weight, and are set to zero in the output, as is
+ * everything outside the box.
+ *
+ * With MixedPrecision on, the work images and the edge weights are stored in
+ * float and the DCT preconditioner runs in single precision, which halves the
+ * memory and bandwidth of the iterations.  Dot products, norms and bias sums
+ * are still accumulated in double, so convergence closely follows the double
+ * solve; compare GetConverged() and GetElapsedIterations() to check.  A
+ * float solve which stalls above MinimumEpsilon is reported as not converged.
+ *
+ * Apart from the preconditioner, each iteration makes four threaded passes
+ * over the work images: the dot product of the residual and the
+ * preconditioned residual, the update of the search direction, the weighted
+ * Laplacian of the direction with its dot product, and the update of the
+ * residual and the solution with their norms and sums.  The constant biases
+ * which the method removes from the direction, the residual and the solution
+ * are folded into these passes, and the preconditioner reads the residual
+ * and writes its own output, so nothing is copied.  The sums are taken over
+ * a fixed partition of the image into blocks, and then over the blocks in
+ * order, so the solution does not depend on the number of threads.  The
+ * weighted Laplacian is a WeightedLaplacianOperator with the edge weights of
+ * the weighted WrappedPhaseLaplacianImageFilter which gives L, computed once
+ * per solve from its quality map, so Q and L weight every edge alike; both
+ * have the symmetric Neumann form.
+ *
+ * Nothing is printed.  After each iteration an IterationEvent is invoked, from
+ * which an observer may read the iteration count, the relative residual,
+ * alpha, beta and the elapsed time, and progress is reported in proportion
+ * to MaximumIterations.  The relative residuals of all the iterations are
+ * kept in GetConvergenceHistory().
  */
 template< class TImage>
 class PCGPhaseUnwrappingImageFilter:public PhaseImageToImageFilter< TImage, TImage >
@@ -56,8 +109,99 @@ public:
   itkSetMacro( MaximumIterations, unsigned int );
   itkGetConstMacro( MaximumIterations, unsigned int ); 
 
-  itkSetMacro( MinimumEpsilon, unsigned int );
-  itkGetConstMacro( MinimumEpsilon, unsigned int ); 
+  /** Set/Get the relative residual at which the iterations stop.  Default is
+   * 0.001. */
+  itkSetMacro( MinimumEpsilon, double );
+  itkGetConstMacro( MinimumEpsilon, double );
+
+  typedef enum {DCTPreconditioner=0, JacobiPreconditioner, MultigridPreconditioner} PreconditionerEnumType;
+
+  /** Set/Get the preconditioner.  Default is DCTPreconditioner. */
+  itkSetMacro( Preconditioner, PreconditionerEnumType );
+  itkGetConstMacro( Preconditioner, PreconditionerEnumType );
+
+  /** Set/Get the FFTW planner rigor used by the DCT preconditioner.  Since the
+   * preconditioner runs every iteration, a measured plan usually pays off. */
+  itkSetMacro( PlanRigor, int );
+  itkGetConstMacro( PlanRigor, int );
+
+  typedef typename Superclass::MaskImageType MaskImageType;
+
+  /** Set/Get an optional mask of the pixels to unwrap. */
+  void SetMaskImage( const MaskImageType * mask )
+    {
+    this->SetNthInput( 1, const_cast< MaskImageType * >( mask ) );
+    }
+  const MaskImageType * GetMaskImage() const
+    {
+    return dynamic_cast< const MaskImageType * >( this->ProcessObject::GetInput( 1 ) );
+    }
+
+  /** Set/Get an optional initial solution, such as the unwrapped previous
+   * frame of a series or a DCT estimate, from which the iterations start
+   * instead of zero.  It must have the region of the input, and is read
+   * only inside the bounding box of the mask.  The relative residual is still
+   * measured against the right hand side, so an initial solution close to the
+   * result reaches MinimumEpsilon in a fraction of the iterations. */
+  void SetInitialSolution( const TImage * initial )
+    {
+    this->SetNthInput( 2, const_cast< TImage * >( initial ) );
+    }
+  const TImage * GetInitialSolution() const
+    {
+    return dynamic_cast< const TImage * >( this->ProcessObject::GetInput( 2 ) );
+    }
+
+  /** Set/Get the number of pixels by which the bounding box of the mask is
+   * padded.  Default is 2. */
+  itkSetMacro( MaskMargin, SizeValueType );
+  itkGetConstMacro( MaskMargin, SizeValueType );
+
+  /** Set/Get whether the iterations store their images in float.  Without
+   * ITK_USE_FFTWF the float preconditioner uses BundledDCT.  Default is off. */
+  itkSetMacro( MixedPrecision, bool );
+  itkGetConstMacro( MixedPrecision, bool );
+  itkBooleanMacro( MixedPrecision );
+
+  /** The number of iterations run, and the relative residual (epsilon)
+   * reached, by the last Update().  During an IterationEvent, those of the
+   * iteration just completed. */
+  itkGetConstMacro( ElapsedIterations, unsigned int );
+  itkGetConstMacro( RelativeResidual, double );
+
+  /** Whether the last Update() reached MinimumEpsilon within
+   * MaximumIterations, which may be compared across MixedPrecision. */
+  itkGetConstMacro( Converged, bool );
+
+  /** The step length (alpha), the inner product of the residual and the
+   * preconditioned residual (beta), and the RMS change of the solution
+   * (delta) of the iteration just completed.  Valid during an
+   * IterationEvent, and afterwards for the last iteration. */
+  itkGetConstMacro( Alpha, double );
+  itkGetConstMacro( Beta, double );
+  itkGetConstMacro( Delta, double );
+
+  /** The wall time, in seconds, from the start of the iterations to the end
+   * of the iteration just completed. */
+  itkGetConstMacro( ElapsedTime, double );
+
+  typedef WeightedLaplacianOperator< typename TImage::PixelType,
+                                     TImage::ImageDimension > OperatorType;
+
+  /** The weighted Laplacian Q of the last Update(), over the bounding box of
+   * the mask.  Its edge weights are those of the weighted Laplacian of the
+   * wrapped phase.  Valid after Update(). */
+  const OperatorType & GetWeightedLaplacianOperator() const
+    {
+    return this->m_Laplacian->GetWeightedLaplacianOperator();
+    }
+
+  /** The relative residual after each iteration of the last Update(). */
+  typedef std::vector< double > ConvergenceHistoryType;
+  const ConvergenceHistoryType & GetConvergenceHistory() const
+    {
+    return this->m_ConvergenceHistory;
+    }
 
  
 protected:
@@ -67,25 +211,265 @@ protected:
   
   // Component filters
   typedef WrappedPhaseLaplacianImageFilter< TImage, TImage > LaplacianType;
-  typedef PhaseDerivativeVarianceImageFilter< TImage >       QualType;
-  typedef DCTPhaseUnwrappingImageFilter< TImage >            DCTType;
+  typedef DCTPoissonSolverImageFilter< TImage >              PoissonSolverType;
+
+  typedef Image< float, TImage::ImageDimension >             FloatImageType;
+  typedef DCTPoissonSolverImageFilter< FloatImageType >      FloatPoissonSolverType;
 
   typedef NeighborhoodIterator< TImage >                     NItType;
   typedef ImageRegionIterator< TImage >                      ItType;
 
+  typedef RegionOfInterestImageFilter< TImage, TImage >               CropType;
+  typedef RegionOfInterestImageFilter< MaskImageType, MaskImageType > MaskCropType;
+
+  /** The whole input, mask and initial solution are needed. */
+  void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  /** The solution is global, so the whole output is generated. */
+  void EnlargeOutputRequestedRegion( DataObject * output ) ITK_OVERRIDE;
+
   /** Does the real work. */
   void GenerateData() ITK_OVERRIDE;
+
+  /** Runs Iterate() with the selected preconditioner; poissonSolver is the
+   * DCT Poisson solver at the precision of TWorkImage. */
+  template< typename TWorkImage, typename TPoissonSolver >
+  void Precondition( TPoissonSolver * poissonSolver, const TImage * initial, TImage * output );
+
+  /** Runs the iterations with work images of type TWorkImage, from the
+   * output and edge weights of m_Laplacian and the initial solution, if not
+   * null, and writes the solution to output. */
+  template< typename TWorkImage, typename TPreconditioner >
+  void Iterate( TPreconditioner & preconditioner, const TImage * initial, TImage * output );
  
 private:
 
   ITK_DISALLOW_COPY_AND_ASSIGN(PCGPhaseUnwrappingImageFilter);
+
+  // A partition of the pixels into blocks of whole lines along the first
+  // axis, which does not depend on the number of threads
+  struct BlockPartition
+    {
+    SizeValueType LineLength;
+    SizeValueType NumberOfLines;
+    SizeValueType LinesPerBlock;
+    SizeValueType NumberOfBlocks;
+
+    SizeValueType First( SizeValueType block ) const
+      {
+      return block * this->LinesPerBlock * this->LineLength;
+      }
+    SizeValueType Last( SizeValueType block ) const
+      {
+      return std::min( ( block + 1 ) * this->LinesPerBlock, this->NumberOfLines ) * this->LineLength;
+      }
+    };
+
+  // Each functor below runs over the blocks [firstBlock, lastBlock) of
+  // Blocks, and writes its sums for block b to Partials[b*NumberOfSums, ...).
+
+  // Out = In - Shift, with the sum and sum of squares of Out
+  template< typename TInPixel, typename TOutPixel >
+  struct ShiftFunctor
+    {
+    itkStaticConstMacro(NumberOfSums, unsigned int, 2);
+    void operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const;
+
+    BlockPartition   Blocks;
+    double *         Partials;
+    const TInPixel * In;
+    TOutPixel *      Out;
+    double           Shift;
+    };
+
+  // r = b - Q s, where b is minus the weighted Laplacian of the wrapped
+  // phase, or r = b without Solution, with the sums of r, r^2 and b^2
+  template< typename TInPixel, typename TPixel >
+  struct ResidualFunctor
+    {
+    itkStaticConstMacro(NumberOfSums, unsigned int, 3);
+    void operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const;
+
+    typedef WeightedLaplacianOperator< TPixel, TImage::ImageDimension > OperatorType;
+
+    BlockPartition       Blocks;
+    double *             Partials;
+    const OperatorType * Operator;
+    const TInPixel *     Laplacian;
+    const TPixel *       Solution;
+    TPixel *             Residual;
+    };
+
+  // The sums of r.z and z
+  template< typename TPixel >
+  struct PreconditionedDotFunctor
+    {
+    itkStaticConstMacro(NumberOfSums, unsigned int, 2);
+    void operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const;
+
+    BlockPartition   Blocks;
+    double *         Partials;
+    const TPixel *   Residual;
+    const TPixel *   Preconditioned;
+    };
+
+  // p = z + Ratio p - Shift, with the sum of p
+  template< typename TPixel >
+  struct DirectionFunctor
+    {
+    itkStaticConstMacro(NumberOfSums, unsigned int, 1);
+    void operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const;
+
+    BlockPartition   Blocks;
+    double *         Partials;
+    const TPixel *   Preconditioned;
+    TPixel *         Direction;
+    double           Ratio;
+    double           Shift;
+    };
+
+  // Qp, the Laplacian of p weighted by the edge weights of Operator, with
+  // the sums of Qp.p and Qp
+  template< typename TPixel >
+  struct WeightedLaplacianFunctor
+    {
+    itkStaticConstMacro(NumberOfSums, unsigned int, 2);
+    void operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const;
+
+    typedef WeightedLaplacianOperator< TPixel, TImage::ImageDimension > OperatorType;
+
+    BlockPartition       Blocks;
+    double *             Partials;
+    const OperatorType * Operator;
+    const TPixel *       Direction;
+    TPixel *             Laplacian;
+    };
+
+  // r = r - Alpha Qp - Shift and s = s + Alpha p, with the sums of r, r^2,
+  // s and p^2
+  template< typename TPixel >
+  struct UpdateFunctor
+    {
+    itkStaticConstMacro(NumberOfSums, unsigned int, 4);
+    void operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const;
+
+    BlockPartition   Blocks;
+    double *         Partials;
+    TPixel *         Residual;
+    TPixel *         Solution;
+    const TPixel *   Direction;
+    const TPixel *   Laplacian;
+    double           Alpha;
+    double           Shift;
+    };
+
+  // The preconditioners, each an approximate inverse of Q for the residual r
+  // held in a work image.  Initialize() is called once per solve, once the
+  // edge weights of Q are known, and Apply() after each update of r; it
+  // returns z, in a buffer the preconditioner owns.
+
+  // z solves Q0 z = r, Q0 being Q with unit weights.  Q0 is minus the
+  // Laplacian of the DCT Poisson solver, so its solution for r is negated.
+  template< typename TWorkImage, typename TPoissonSolver >
+  struct DCTInverse
+    {
+    typedef typename TWorkImage::PixelType                                      PixelType;
+    typedef WeightedLaplacianOperator< PixelType, TImage::ImageDimension >      OperatorType;
+
+    void Initialize( Self * filter, TWorkImage * residual, const OperatorType & weightedLaplacian );
+    const PixelType * Apply();
+
+    // Buffer = -Buffer over the pixels [first, last)
+    struct NegateFunctor
+      {
+      void operator()( SizeValueType first, SizeValueType last ) const;
+
+      PixelType * Buffer;
+      };
+
+    Self *           Filter;
+    TPoissonSolver * PoissonSolver;
+    TWorkImage *     Residual;
+    };
+
+  // z = r / diag(Q), and zero where Q has no edges
+  template< typename TWorkImage >
+  struct JacobiInverse
+    {
+    typedef typename TWorkImage::PixelType                                      PixelType;
+    typedef WeightedLaplacianOperator< PixelType, TImage::ImageDimension >      OperatorType;
+
+    void Initialize( Self * filter, TWorkImage * residual, const OperatorType & weightedLaplacian );
+    const PixelType * Apply();
+
+    // Out = Scale In over the pixels [first, last)
+    struct ScaleFunctor
+      {
+      void operator()( SizeValueType first, SizeValueType last ) const;
+
+      const PixelType * Scale;
+      const PixelType * In;
+      PixelType *       Out;
+      };
+
+    Self *                   Filter;
+    TWorkImage *             Residual;
+    std::vector< PixelType > InverseDiagonal;
+    std::vector< PixelType > Preconditioned;
+    };
+
+  // z is one V cycle of MultigridPoissonSolver on Q z = r, over grids built
+  // once per solve
+  template< typename TWorkImage >
+  struct MultigridInverse
+    {
+    typedef typename TWorkImage::PixelType                                      PixelType;
+    typedef WeightedLaplacianOperator< PixelType, TImage::ImageDimension >      OperatorType;
+    typedef MultigridPoissonSolver< PixelType, TImage::ImageDimension >         SolverType;
+
+    void Initialize( Self * filter, TWorkImage * residual, const OperatorType & weightedLaplacian );
+    const PixelType * Apply();
+
+    TWorkImage *                  Residual;
+    typename SolverType::Pointer  Solver;
+    };
+
+  // Q at the working precision: the operator of m_Laplacian itself, or
+  // copy, given the edge weights of m_Laplacian at another precision
+  const OperatorType & GetWorkOperator( OperatorType & )
+    {
+    return this->m_Laplacian->GetWeightedLaplacianOperator();
+    }
+  template< typename TOperator >
+  const TOperator & GetWorkOperator( TOperator & copy );
+
+  /** Runs functor over the blocks on the filter's threads, and writes its
+   * NumberOfSums sums, added over the blocks in order, to sums. */
+  template< typename TFunctor >
+  void Reduce( TFunctor & functor, double * sums );
   
   typename LaplacianType::Pointer m_Laplacian;
-  typename QualType::Pointer      m_Qual;
-  typename DCTType::Pointer       m_DCT;
+  typename PoissonSolverType::Pointer       m_PoissonSolver;
+  typename FloatPoissonSolverType::Pointer  m_FloatPoissonSolver;
 
   unsigned int m_MaximumIterations;
   double       m_MinimumEpsilon;
+  int          m_PlanRigor;
+
+  PreconditionerEnumType m_Preconditioner;
+
+  SizeValueType m_MaskMargin;
+  bool          m_MixedPrecision;
+
+  unsigned int m_ElapsedIterations;
+  double       m_RelativeResidual;
+  bool         m_Converged;
+  double       m_Alpha;
+  double       m_Beta;
+  double       m_Delta;
+  double       m_ElapsedTime;
+
+  ConvergenceHistoryType m_ConvergenceHistory;
 
 };
 } //namespace ITK
@@ -19,6 +19,8 @@
 #define itkPCGPhaseUnwrappingImageFilter_hxx
 
 #include "itkPCGPhaseUnwrappingImageFilter.h"
+#include "itkProgressReporter.h"
+#include "itkRealTimeClock.h"
  
 namespace itk {
 
@@ -28,13 +30,60 @@ PCGPhaseUnwrappingImageFilter< TImage >
 {
 
   this->m_Laplacian = LaplacianType::New();
-  this->m_Qual = QualType::New();
-  this->m_DCT = DCTType::New();
+  this->m_PoissonSolver = PoissonSolverType::New();
 
   m_MaximumIterations = 100;
   m_MinimumEpsilon = 0.001;
+  m_PlanRigor = DCTBackend::GetPlanRigor();
+  m_Preconditioner = DCTPreconditioner;
+  m_MaskMargin = 2;
+  m_MixedPrecision = false;
+  m_ElapsedIterations = 0;
+  m_RelativeResidual = 0.0;
+  m_Converged = false;
+  m_Alpha = 0.0;
+  m_Beta = 0.0;
+  m_Delta = 0.0;
+  m_ElapsedTime = 0.0;
+
+  this->m_FloatPoissonSolver = FloatPoissonSolverType::New();
 
 }
+
+template< typename TImage >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::GenerateInputRequestedRegion()
+{
+
+  Superclass::GenerateInputRequestedRegion();
+
+  TImage * input = const_cast< TImage * >( this->GetInput() );
+  if ( input )
+    {
+    input->SetRequestedRegionToLargestPossibleRegion();
+    }
+
+  MaskImageType * mask = const_cast< MaskImageType * >( this->GetMaskImage() );
+  if ( mask )
+    {
+    mask->SetRequestedRegionToLargestPossibleRegion();
+    }
+
+  TImage * initial = const_cast< TImage * >( this->GetInitialSolution() );
+  if ( initial )
+    {
+    initial->SetRequestedRegionToLargestPossibleRegion();
+    }
+
+}
+
+template< typename TImage >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::EnlargeOutputRequestedRegion( DataObject * output )
+{
+  Superclass::EnlargeOutputRequestedRegion( output );
+  output->SetRequestedRegionToLargestPossibleRegion();
+}
  
 template< class TImage>
 void PCGPhaseUnwrappingImageFilter< TImage >
@@ -42,305 +91,766 @@ void PCGPhaseUnwrappingImageFilter< TImage >
 {
 
   typename TImage::ConstPointer input = this->GetInput();
-
-  const unsigned int NUMPIX = input->GetLargestPossibleRegion().GetNumberOfPixels();
+  typename TImage::ConstPointer initial = this->GetInitialSolution();
 
   typename TImage::Pointer output = this->GetOutput();
   this->AllocateOutputs();
-  output->FillBuffer( 0 );
-  
-  // Allocate intermediate images
-  typename TImage::Pointer zarray    = TImage::New();
-  typename TImage::Pointer parray    = TImage::New();
-  typename TImage::Pointer rarray    = TImage::New();
-  typename TImage::Pointer soln      = TImage::New();
-  typename TImage::Pointer qualImage = TImage::New();
-
-  zarray->SetRegions( input->GetLargestPossibleRegion() );
-  zarray->SetOrigin(  input->GetOrigin() );
-  zarray->SetSpacing( input->GetSpacing() );
-  zarray->Allocate();
-  zarray->FillBuffer( 0 );
 
-  parray->SetRegions( input->GetLargestPossibleRegion() );
-  parray->SetOrigin(  input->GetOrigin() );
-  parray->SetSpacing( input->GetSpacing() );
-  parray->Allocate();
-  parray->FillBuffer( 0 );
+  // Restrict the solve to the bounding box of the mask
+  const MaskImageType * mask = this->GetMaskImage();
+  typename Superclass::InputImageRegionType maskRegion;
+  typename MaskImageType::ConstPointer croppedMask;
 
-//  rarray->SetRegions( input->GetLargestPossibleRegion() );
-//  rarray->SetOrigin(  input->GetOrigin() );
-//  rarray->SetSpacing( input->GetSpacing() );
-//  rarray->Allocate();
-//  rarray->FillBuffer( 0 );
+  if ( mask )
+    {
 
-  soln->SetRegions( input->GetLargestPossibleRegion() );
-  soln->SetOrigin(  input->GetOrigin() );
-  soln->SetSpacing( input->GetSpacing() );
-  soln->Allocate();
-  soln->FillBuffer( 0 );
+    // Only the bounding box is written by the solve; without a mask the
+    // whole output is, so it is not filled
+    output->FillBuffer( 0 );
+
+    maskRegion = Self::GetMaskBoundingRegion( mask, this->m_MaskMargin );
+    if ( 0 == maskRegion.GetNumberOfPixels() )
+      {
+      return;
+      }
+
+    typename CropType::Pointer crop = CropType::New();
+    crop->SetInput( input );
+    crop->SetRegionOfInterest( maskRegion );
+    crop->Update();
+    input = crop->GetOutput();
+
+    typename MaskCropType::Pointer maskCrop = MaskCropType::New();
+    maskCrop->SetInput( mask );
+    maskCrop->SetRegionOfInterest( maskRegion );
+    maskCrop->Update();
+    croppedMask = maskCrop->GetOutput();
+
+    if ( initial )
+      {
+      typename CropType::Pointer initialCrop = CropType::New();
+      initialCrop->SetInput( initial );
+      initialCrop->SetRegionOfInterest( maskRegion );
+      initialCrop->Update();
+      initial = initialCrop->GetOutput();
+      }
+
+    }
 
-//  qualImage->SetRegions( input->GetLargestPossibleRegion() );
-//  qualImage->SetOrigin(  input->GetOrigin() );
-//  qualImage->SetSpacing( input->GetSpacing() );
-//  qualImage->Allocate();
-//  qualImage->FillBuffer( 0 );
- 
   // Calculate Laplacian (aka rarray)
   m_Laplacian->SetInput( input );
-//  m_Laplacian->SetWeight( LaplacianType::PhaseDerivativeVariance );
   m_Laplacian->SetWeighted(true);
+  m_Laplacian->SetMaskImage( croppedMask );
   m_Laplacian->Update();
-  rarray->Graft( m_Laplacian->GetOutput() );
-//  rarray = m_Laplacian->GetOutput();
-//  rarray->Update();
-
 
-  ItType rIt( rarray, input->GetLargestPossibleRegion() );
-  ItType zIt( zarray, input->GetLargestPossibleRegion() );
-  ItType pIt( parray, input->GetLargestPossibleRegion() ); 
-  
-  double sum0 = 0;
-  for (rIt.GoToBegin(); !rIt.IsAtEnd(); ++rIt)
+  // Without a mask the solution is written straight into the output
+  typename TImage::Pointer soln = output;
+  if ( mask )
     {
-    sum0 += pow(rIt.Get(), 2);
+    soln = TImage::New();
+    soln->CopyInformation( input );
+    soln->SetRegions( input->GetLargestPossibleRegion() );
+    soln->Allocate();
     }
 
-  sum0 = std::sqrt(sum0/NUMPIX);
+  if ( this->m_MixedPrecision )
+    {
+    m_FloatPoissonSolver->SetPlanRigor( m_PlanRigor );
+    m_FloatPoissonSolver->SetNumberOfThreads( this->GetNumberOfThreads() );
+    Precondition< FloatImageType >( m_FloatPoissonSolver.GetPointer(), initial, soln );
+    }
+  else
+    {
+    m_PoissonSolver->SetPlanRigor( m_PlanRigor );
+    m_PoissonSolver->SetNumberOfThreads( this->GetNumberOfThreads() );
+    Precondition< TImage >( m_PoissonSolver.GetPointer(), initial, soln );
+    }
 
-  std::cout << "sum0: " << sum0 << std::endl;
- 
-  // Calculate quality
-  m_Qual->SetInput( input );
-  m_Qual->Update();
-  qualImage->Graft( m_Qual->GetOutput() );
-  qualImage->Update();
-
-//  ImageAlgorithm::Copy(m_Qual->GetOutput(),
-//                       qualImage.GetPointer(),
-//                       qualImage->GetLargestPossibleRegion(),
-//                       qualImage->GetLargestPossibleRegion());
-
-  double beta, beta_previous, beta_temp;
-  double alpha, epsilon, delta;
+  if ( mask )
+    {
+    Self::PasteMaskedSolution( soln.GetPointer(), mask, maskRegion, output.GetPointer() );
+    }
   
-  for (unsigned int i = 0; i < m_MaximumIterations; ++i)
+}
+
+template< class TImage>
+template< typename TWorkImage, typename TPoissonSolver >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::Precondition( TPoissonSolver * poissonSolver, const TImage * initial, TImage * output )
+{
+
+  switch ( this->m_Preconditioner )
     {
-    
-    std::cout << "Iteration: " << i << " / " << m_MaximumIterations << std::endl;
- 
-    // Remove constant bias from rarray
-    double bias = 0;
-    for (rIt.GoToBegin(); !rIt.IsAtEnd(); ++rIt)
+    case JacobiPreconditioner:
       {
-      bias += rIt.Get();
+      JacobiInverse< TWorkImage > jacobi;
+      Iterate< TWorkImage >( jacobi, initial, output );
+      break;
       }
-
-    bias /= NUMPIX;
-
-    for (rIt.GoToBegin(); !rIt.IsAtEnd(); ++rIt)
+    case MultigridPreconditioner:
+      {
+      MultigridInverse< TWorkImage > multigrid;
+      Iterate< TWorkImage >( multigrid, initial, output );
+      break;
+      }
+    default:
       {
-      rIt.Value() -= bias;
+      DCTInverse< TWorkImage, TPoissonSolver > inverse;
+      inverse.PoissonSolver = poissonSolver;
+      Iterate< TWorkImage >( inverse, initial, output );
+      break;
       }
+    }
 
-    // Copy rarray into zarray
-    ImageAlgorithm::Copy(rarray.GetPointer(),
-                         zarray.GetPointer(),
-                         zarray->GetLargestPossibleRegion(),
-                         zarray->GetLargestPossibleRegion());
-
-    
-    // Compute cosine transform solution of Laplacian of zarray
-    m_DCT->SetInput( zarray );
-    m_DCT->Update();
-
-    // Copy the solution into the transform into the zarray
-    // Should DCTPhaseUnwrappingImageFilter inherit from InPlaceImageFilter?
-    ImageAlgorithm::Copy(m_DCT->GetOutput(),
-                         zarray.GetPointer(),
-                         zarray->GetLargestPossibleRegion(),
-                         zarray->GetLargestPossibleRegion());
-
-    // Calculate beta
-   
-    beta = 0;
-    for (rIt.GoToBegin(), zIt.GoToBegin(); !rIt.IsAtEnd(); ++rIt, ++zIt)
+}
+
+template< class TImage>
+template< typename TWorkImage, typename TPreconditioner >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::Iterate( TPreconditioner & preconditioner, const TImage * initial, TImage * output )
+{
+
+  typedef typename TWorkImage::PixelType     WorkPixelType;
+  typedef typename TImage::PixelType         PixelType;
+
+  const typename TImage::RegionType region = output->GetLargestPossibleRegion();
+  const SizeValueType numberOfPixels = region.GetNumberOfPixels();
+
+  // Allocate intermediate images.  The sums below are all accumulated in
+  // double, whatever the precision of the images.
+  typename TWorkImage::Pointer zarray    = TWorkImage::New();
+  typename TWorkImage::Pointer parray    = TWorkImage::New();
+  typename TWorkImage::Pointer rarray    = TWorkImage::New();
+  typename TWorkImage::Pointer soln      = TWorkImage::New();
+
+  // zarray holds Qp; the preconditioned residual is held by preconditioner
+  zarray->CopyInformation( output );
+  zarray->SetRegions( region );
+  zarray->Allocate();
+
+  parray->CopyInformation( output );
+  parray->SetRegions( region );
+  parray->Allocate();
+  parray->FillBuffer( 0 );
+
+  rarray->CopyInformation( output );
+  rarray->SetRegions( region );
+  rarray->Allocate();
+
+  soln->CopyInformation( output );
+  soln->SetRegions( region );
+  soln->Allocate();
+
+  BlockPartition blocks;
+  blocks.LineLength = region.GetSize()[0];
+  blocks.NumberOfLines = numberOfPixels / blocks.LineLength;
+  blocks.LinesPerBlock = std::max< SizeValueType >( 1, 4096 / blocks.LineLength );
+  blocks.NumberOfBlocks = ( blocks.NumberOfLines + blocks.LinesPerBlock - 1 ) / blocks.LinesPerBlock;
+
+  double sums[4];
+
+  // Q at the working precision, with the edge weights of L
+  typedef typename WeightedLaplacianFunctor< WorkPixelType >::OperatorType WorkOperatorType;
+  WorkOperatorType workOperator;
+  const WorkOperatorType & weightedLaplacian = this->GetWorkOperator( workOperator );
+
+  // Start from the initial solution at the working precision, or from zero.
+  // solutionSum holds the sum left in soln, which is unbiased once, at the end.
+  double solutionSum = 0.0;
+  if ( initial )
+    {
+    ShiftFunctor< PixelType, WorkPixelType > start;
+    start.Blocks = blocks;
+    start.In = initial->GetBufferPointer();
+    start.Out = soln->GetBufferPointer();
+    start.Shift = 0.0;
+    this->Reduce( start, sums );
+    solutionSum = sums[0];
+    }
+  else
+    {
+    soln->FillBuffer( 0 );
+    }
+
+  // Take the residual at the working precision, with the norm of the right
+  // hand side, and release the Laplacian
+  ResidualFunctor< PixelType, WorkPixelType > residual;
+  residual.Blocks = blocks;
+  residual.Operator = &weightedLaplacian;
+  residual.Laplacian = m_Laplacian->GetOutput()->GetBufferPointer();
+  residual.Solution = initial ? soln->GetBufferPointer() : ITK_NULLPTR;
+  residual.Residual = rarray->GetBufferPointer();
+  this->Reduce( residual, sums );
+  m_Laplacian->GetOutput()->ReleaseData();
+
+  double sum0 = std::sqrt(sums[2]/numberOfPixels);
+
+  // Remove constant bias from rarray.  Afterwards each pass keeps it
+  // unbiased, and residualSum holds the sum left by rounding.
+  ShiftFunctor< WorkPixelType, WorkPixelType > unbias;
+  unbias.Blocks = blocks;
+  unbias.In = rarray->GetBufferPointer();
+  unbias.Out = rarray->GetBufferPointer();
+  unbias.Shift = sums[0] / numberOfPixels;
+  this->Reduce( unbias, sums );
+  double residualSum = sums[0];
+
+  // A zero right hand side is solved by a constant, whatever the initial
+  // solution, and a warm start may already meet MinimumEpsilon.  Neither
+  // needs an iteration, which would divide zero by zero.
+  const double epsilon0 = ( sum0 > 0.0 ) ? std::sqrt( sums[1] / numberOfPixels ) / sum0 : 0.0;
+  const bool converged = ( 0.0 == sum0 || epsilon0 <= this->m_MinimumEpsilon );
+  if ( 0.0 == sum0 )
+    {
+    soln->FillBuffer( 0 );
+    solutionSum = 0.0;
+    }
+  else if ( !converged )
+    {
+    preconditioner.Initialize( this, rarray.GetPointer(), weightedLaplacian );
+    }
+
+  PreconditionedDotFunctor< WorkPixelType > dot;
+  dot.Blocks = blocks;
+  dot.Residual = rarray->GetBufferPointer();
+
+  DirectionFunctor< WorkPixelType > direction;
+  direction.Blocks = blocks;
+  direction.Direction = parray->GetBufferPointer();
+
+  WeightedLaplacianFunctor< WorkPixelType > laplacian;
+  laplacian.Blocks = blocks;
+  laplacian.Operator = &weightedLaplacian;
+  laplacian.Direction = parray->GetBufferPointer();
+  laplacian.Laplacian = zarray->GetBufferPointer();
+
+  UpdateFunctor< WorkPixelType > update;
+  update.Blocks = blocks;
+  update.Residual = rarray->GetBufferPointer();
+  update.Solution = soln->GetBufferPointer();
+  update.Direction = parray->GetBufferPointer();
+  update.Laplacian = zarray->GetBufferPointer();
+
+  double beta, beta_previous = 0.0;
+  double alpha, epsilon;
+
+  // Sum left in p
+  double directionSum = 0.0;
+
+  this->m_ElapsedIterations = 0;
+  this->m_RelativeResidual = epsilon0;
+  this->m_Converged = converged;
+  this->m_Alpha = 0.0;
+  this->m_Beta = 0.0;
+  this->m_Delta = 0.0;
+  this->m_ElapsedTime = 0.0;
+  this->m_ConvergenceHistory.clear();
+  this->m_ConvergenceHistory.reserve( m_MaximumIterations );
+
+  ProgressReporter progress( this, 0, m_MaximumIterations, m_MaximumIterations );
+  RealTimeClock::Pointer clock = RealTimeClock::New();
+  const double start = clock->GetTimeInSeconds();
+
+  for (unsigned int i = 0; !this->m_Converged && i < m_MaximumIterations; ++i)
+    {
+
+    // Precondition rarray, which was updated in place
+    dot.Preconditioned = preconditioner.Apply();
+
+    // Calculate beta, and the bias of the preconditioned residual
+    this->Reduce( dot, sums );
+    beta = sums[0];
+
+    // p = z + (beta/beta_previous) * p, or z in the first iteration, less
+    // the bias of both
+    direction.Preconditioned = dot.Preconditioned;
+    direction.Ratio = ( 0 == i ) ? 0.0 : beta / beta_previous;
+    direction.Shift = ( sums[1] + direction.Ratio * directionSum ) / numberOfPixels;
+    this->Reduce( direction, sums );
+    directionSum = sums[0];
+
+    // Assign beta to beta_previous
+    beta_previous = beta;
+
+    // Calculate Qp, and alpha.  Qp.p vanishes only with the preconditioned
+    // residual, when no step can reduce the residual further.
+    this->Reduce( laplacian, sums );
+    if ( !( sums[0] > 0.0 ) )
       {
-      beta += rIt.Get()*zIt.Get();
+      break;
       }
+    alpha = beta / sums[0];
+
+    // Update rarray, less its new bias, and soln
+    update.Alpha = alpha;
+    update.Shift = ( residualSum - alpha * sums[1] ) / numberOfPixels;
+    this->Reduce( update, sums );
+    residualSum = sums[0];
+    solutionSum = sums[2];
+
+    // Calculate EPSILON from the residual before its bias was removed
+    epsilon = sums[1] + 2 * update.Shift * sums[0] + numberOfPixels * update.Shift * update.Shift;
+    epsilon = std::sqrt(epsilon/numberOfPixels)/sum0;
+
+    this->m_ElapsedIterations = i + 1;
+    this->m_RelativeResidual = epsilon;
+    this->m_Alpha = alpha;
+    this->m_Beta = beta;
+    this->m_Delta = std::sqrt(alpha * alpha * sums[3]/numberOfPixels);
+    this->m_ElapsedTime = clock->GetTimeInSeconds() - start;
+    this->m_ConvergenceHistory.push_back( epsilon );
+
+    this->InvokeEvent( IterationEvent() );
+    progress.CompletedPixel();
 
-    std::cout << "Beta: " << beta << std::endl;
-    
-    // If this is the first iteration, copy zarray into parray
-    if (0 == i)
+    // If epsilon falls below the threshold, break out.
+    if (this->m_MinimumEpsilon >= epsilon)
       {
-      ImageAlgorithm::Copy(zarray.GetPointer(),
-                           parray.GetPointer(),
-                           parray->GetLargestPossibleRegion(),
-                           parray->GetLargestPossibleRegion());
+      this->m_Converged = true;
+      break;
       }
-    else
-      { // Otherwise, p = z + (beta/beta_previous) * p
-    
-      beta_temp = beta / beta_previous;
-      
-      for (pIt.GoToBegin(), zIt.GoToBegin(); !zIt.IsAtEnd(); ++pIt, ++zIt)
-        {
-        pIt.Set(zIt.Get() + beta_temp*pIt.Get());
-        }
 
-    }
-    
-    // Remove constant bias from parray   
-    bias = 0;
+  } 
+
+  // Remove constant bias from the solution while writing the output
+  ShiftFunctor< WorkPixelType, PixelType > write;
+  write.Blocks = blocks;
+  write.In = soln->GetBufferPointer();
+  write.Out = output->GetBufferPointer();
+  write.Shift = solutionSum / numberOfPixels;
+  this->Reduce( write, sums );
+  
+}
+
+template< class TImage >
+template< typename TOperator >
+const TOperator & PCGPhaseUnwrappingImageFilter< TImage >
+::GetWorkOperator( TOperator & copy )
+{
 
-    for (pIt.GoToBegin(); !pIt.IsAtEnd(); ++pIt)
+  // The quality image of m_Laplacian is already zero outside the mask
+  copy.SetQuality( this->m_Laplacian->GetWeightedLaplacianOperator().GetSize(),
+                   this->m_Laplacian->GetQualityImage()->GetBufferPointer(),
+                   static_cast< const typename MaskImageType::PixelType * >( ITK_NULLPTR ),
+                   TImage::ImageDimension,
+                   this->GetMultiThreader(),
+                   this->GetNumberOfThreads() );
+  return copy;
+
+}
+
+template< class TImage >
+template< typename TFunctor >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::Reduce( TFunctor & functor, double * sums )
+{
+
+  const unsigned int numberOfSums = TFunctor::NumberOfSums;
+  std::vector< double > partials( functor.Blocks.NumberOfBlocks * numberOfSums );
+  functor.Partials = &partials[0];
+
+  ThreadedRangeLoop< TFunctor >::Run( this->GetMultiThreader(),
+                                      this->GetNumberOfThreads(),
+                                      functor.Blocks.NumberOfBlocks,
+                                      functor );
+
+  for (unsigned int j = 0; j < numberOfSums; ++j)
+    {
+    sums[j] = 0.0;
+    }
+  for (SizeValueType b = 0; b < functor.Blocks.NumberOfBlocks; ++b)
+    {
+    for (unsigned int j = 0; j < numberOfSums; ++j)
       {
-      bias += pIt.Get();
+      sums[j] += partials[b * numberOfSums + j];
       }
+    }
 
-    bias /= NUMPIX;
+}
+
+template< class TImage >
+template< typename TInPixel, typename TOutPixel >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::ShiftFunctor< TInPixel, TOutPixel >
+::operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const
+{
 
-    for (pIt.GoToBegin(); !pIt.IsAtEnd(); ++pIt)
+  for (SizeValueType b = firstBlock; b < lastBlock; ++b)
+    {
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    for (SizeValueType p = this->Blocks.First( b ); p < this->Blocks.Last( b ); ++p)
       {
-      pIt.Value() -= bias;
+      const TOutPixel out = static_cast< TOutPixel >( this->In[p] - this->Shift );
+      this->Out[p] = out;
+      sum += out;
+      sumSquares += static_cast< double >( out ) * out;
       }
+    this->Partials[2*b] = sum;
+    this->Partials[2*b + 1] = sumSquares;
+    }
 
-    // Assign beta to beta_previous
-    beta_previous = beta;
- 
-    // Calculate Qp
-    typename NItType::RadiusType radius;
-    radius.Fill( 1 ); 
-    
-   // qualImage->FillBuffer( 1 );
-    
-    NItType pNIt( radius,
-                  parray,
-                  parray->GetLargestPossibleRegion() );
-
-    NItType qualIt( radius,
-                    m_Qual->GetOutput(), 
-                    parray->GetLargestPossibleRegion() );
-                    
-    for (pNIt.GoToBegin(), qualIt.GoToBegin(), zIt.GoToBegin();
-         !qualIt.IsAtEnd();
-         ++qualIt, ++pNIt, ++zIt)
+}
+
+template< class TImage >
+template< typename TInPixel, typename TPixel >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::ResidualFunctor< TInPixel, TPixel >
+::operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const
+{
+
+  const unsigned int Dimension = TImage::ImageDimension;
+  const typename OperatorType::SizeType & size = this->Operator->GetSize();
+  const SizeValueType lineLength = size[0];
+  typename OperatorType::Difference difference;
+
+  IndexValueType index[Dimension];
+  index[0] = 0;
+  std::vector< double > line( lineLength, 0.0 );
+
+  for (SizeValueType b = firstBlock; b < lastBlock; ++b)
+    {
+
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    double rightHandSideSquares = 0.0;
+
+    for (SizeValueType p = this->Blocks.First( b ); p < this->Blocks.Last( b ); p += lineLength)
       {
-    
-      typename NItType::SizeValueType k = qualIt.Size() / 2;
-      typename NItType::SizeValueType k1, k2;
-      double w1, w2;
-      double sumWeight = 0;
-      
-      zIt.Set( 0 );
-    
-      for (unsigned int d = 0; d < TImage::ImageDimension; ++d)
+
+      if ( this->Solution )
+        {
+        SizeValueType remainder = p / lineLength;
+        for (unsigned int d = 1; d < Dimension; ++d)
+          {
+          index[d] = remainder % size[d];
+          remainder /= size[d];
+          }
+        this->Operator->ApplyToLine( this->Solution, p, index, lineLength, difference, &line[0] );
+        }
+
+      for (SizeValueType i = 0; i < lineLength; ++i)
         {
-      
-        // Calculate offsets
-        k1 = (qualIt.GetIndex()[d] < input->GetLargestPossibleRegion().GetSize()[d] - 1) ?
-          k + qualIt.GetStride( d ) : k - qualIt.GetStride( d );
-      
-        k2 = (qualIt.GetIndex()[d] > 0) ? k - qualIt.GetStride( d ) : k + qualIt.GetStride( d );
-        
-        // Calculate weights
-        w1 = qualIt.GetPixel( k1 );
-        w2 = qualIt.GetPixel( k2 );
-        
-        double wCenter = qualIt.GetCenterPixel();
-        w1 = (wCenter*wCenter < w1*w1) ? wCenter*wCenter : w1*w1;
-        w2 = (wCenter*wCenter < w2*w2) ? wCenter*wCenter : w2*w2;
-        
-        sumWeight += (w1+w2);
-        
-        zIt.Value() -= w1*pNIt.GetPixel( k1 );
-        zIt.Value() -= w2*pNIt.GetPixel( k2 );
-      
+        const double rightHandSide = -static_cast< double >( this->Laplacian[p + i] );
+        const TPixel residual = static_cast< TPixel >( rightHandSide - line[i] );
+        this->Residual[p + i] = residual;
+        sum += residual;
+        sumSquares += static_cast< double >( residual ) * residual;
+        rightHandSideSquares += rightHandSide * rightHandSide;
         }
-      
-      zIt.Value() += sumWeight*pNIt.GetCenterPixel();
-      
-    
+
       }
-    
-    // Calculate alpha
-    alpha = 0;
 
-    for (zIt.GoToBegin(), pIt.GoToBegin(); !zIt.IsAtEnd(); ++zIt, ++pIt)
+    this->Partials[3*b] = sum;
+    this->Partials[3*b + 1] = sumSquares;
+    this->Partials[3*b + 2] = rightHandSideSquares;
+
+    }
+
+}
+
+template< class TImage >
+template< typename TPixel >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::PreconditionedDotFunctor< TPixel >
+::operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const
+{
+
+  for (SizeValueType b = firstBlock; b < lastBlock; ++b)
+    {
+    double dot = 0.0;
+    double sum = 0.0;
+    for (SizeValueType p = this->Blocks.First( b ); p < this->Blocks.Last( b ); ++p)
       {
-      alpha += zIt.Get()*pIt.Get();
+      dot += static_cast< double >( this->Residual[p] ) * this->Preconditioned[p];
+      sum += this->Preconditioned[p];
       }
+    this->Partials[2*b] = dot;
+    this->Partials[2*b + 1] = sum;
+    }
 
-    alpha = beta / alpha;
+}
 
-    std::cout << "Alpha: " << alpha << std::endl;
+template< class TImage >
+template< typename TPixel >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::DirectionFunctor< TPixel >
+::operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const
+{
 
-    // Update rarray
-    for (rIt.GoToBegin(), zIt.GoToBegin(); !zIt.IsAtEnd(); ++rIt, ++zIt)
+  for (SizeValueType b = firstBlock; b < lastBlock; ++b)
+    {
+    double sum = 0.0;
+    for (SizeValueType p = this->Blocks.First( b ); p < this->Blocks.Last( b ); ++p)
       {
-      rIt.Value() -= alpha*zIt.Get();
+      const TPixel direction = static_cast< TPixel >(
+        this->Preconditioned[p] + this->Ratio * this->Direction[p] - this->Shift );
+      this->Direction[p] = direction;
+      sum += direction;
       }
+    this->Partials[b] = sum;
+    }
 
-    // FIXME Book says 'update parray', but then modifies soln
-    // FIXME Should solution be zeroed first?
-    ItType sIt( soln, input->GetLargestPossibleRegion() );
+}
 
-    for (sIt.GoToBegin(), pIt.GoToBegin(); !sIt.IsAtEnd(); ++sIt, ++pIt)
-      {
-      sIt.Value() += alpha*pIt.Get();
-      } 
+template< class TImage >
+template< typename TPixel >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::WeightedLaplacianFunctor< TPixel >
+::operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const
+{
 
-    // Remove constant bias from SOLUTION
-    bias = 0.0;
+  const unsigned int Dimension = TImage::ImageDimension;
+  const typename OperatorType::SizeType & size = this->Operator->GetSize();
+  const SizeValueType lineLength = size[0];
+  typename OperatorType::Difference difference;
 
-    for (sIt.GoToBegin(); !sIt.IsAtEnd(); ++sIt)
-      {
-      bias += sIt.Get();
-      }
+  IndexValueType index[Dimension];
+  index[0] = 0;
+  std::vector< double > line( lineLength );
+
+  for (SizeValueType b = firstBlock; b < lastBlock; ++b)
+    {
 
-    bias /= NUMPIX;
+    double dot = 0.0;
+    double sum = 0.0;
 
-    for (sIt.GoToBegin(); !sIt.IsAtEnd(); ++sIt)
+    for (SizeValueType p = this->Blocks.First( b ); p < this->Blocks.Last( b ); p += lineLength)
       {
-      sIt.Value() -= bias;
+
+      SizeValueType remainder = p / lineLength;
+      for (unsigned int d = 1; d < Dimension; ++d)
+        {
+        index[d] = remainder % size[d];
+        remainder /= size[d];
+        }
+
+      this->Operator->ApplyToLine( this->Direction, p, index, lineLength, difference, &line[0] );
+
+      for (SizeValueType i = 0; i < lineLength; ++i)
+        {
+        const TPixel laplacian = static_cast< TPixel >( line[i] );
+        this->Laplacian[p + i] = laplacian;
+        dot += static_cast< double >( laplacian ) * this->Direction[p + i];
+        sum += laplacian;
+        }
+
       }
 
-    // Calculate EPSILON
-    epsilon = 0.0;
-    for (rIt.GoToBegin(); !rIt.IsAtEnd(); ++rIt)
+    this->Partials[2*b] = dot;
+    this->Partials[2*b + 1] = sum;
+
+    }
+
+}
+
+template< class TImage >
+template< typename TPixel >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::UpdateFunctor< TPixel >
+::operator()( SizeValueType firstBlock, SizeValueType lastBlock ) const
+{
+
+  for (SizeValueType b = firstBlock; b < lastBlock; ++b)
+    {
+    double residualSum = 0.0;
+    double residualSquares = 0.0;
+    double solutionSum = 0.0;
+    double directionSquares = 0.0;
+    for (SizeValueType p = this->Blocks.First( b ); p < this->Blocks.Last( b ); ++p)
       {
-      epsilon += pow( rIt.Get(),2);
+      const double direction = this->Direction[p];
+      const TPixel residual = static_cast< TPixel >(
+        this->Residual[p] - this->Alpha * this->Laplacian[p] - this->Shift );
+      const TPixel solution = static_cast< TPixel >( this->Solution[p] + this->Alpha * direction );
+      this->Residual[p] = residual;
+      this->Solution[p] = solution;
+      residualSum += residual;
+      residualSquares += static_cast< double >( residual ) * residual;
+      solutionSum += solution;
+      directionSquares += direction * direction;
       }
+    this->Partials[4*b] = residualSum;
+    this->Partials[4*b + 1] = residualSquares;
+    this->Partials[4*b + 2] = solutionSum;
+    this->Partials[4*b + 3] = directionSquares;
+    }
 
-    // FIXME: WHY ARE WE DIVIDING BIAS AGAIN??
-    // FIXME: Should this be epsilon??
-    epsilon = std::sqrt(epsilon/NUMPIX)/sum0;
+}
 
-    std::cout << "Epsilon: " << epsilon << std::endl;
+template< class TImage >
+template< typename TWorkImage, typename TPoissonSolver >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::DCTInverse< TWorkImage, TPoissonSolver >
+::Initialize( Self * filter, TWorkImage * residual, const OperatorType & )
+{
+  this->Filter = filter;
+  this->Residual = residual;
+}
 
-    // Calculate DELTA
-    delta = 0.0;
-    for (pIt.GoToBegin(); !pIt.IsAtEnd(); ++pIt)
+template< class TImage >
+template< typename TWorkImage, typename TPoissonSolver >
+const typename TWorkImage::PixelType *
+PCGPhaseUnwrappingImageFilter< TImage >
+::DCTInverse< TWorkImage, TPoissonSolver >
+::Apply()
+{
+
+  // The residual is updated in place, which the pipeline does not see
+  this->Residual->Modified();
+  this->PoissonSolver->SetInput( this->Residual );
+  this->PoissonSolver->Update();
+
+  // The solution for -r is that for r, negated, which is done in the output
+  // of the solver rather than in a copy of r
+  TWorkImage * solution = this->PoissonSolver->GetOutput();
+  NegateFunctor negate;
+  negate.Buffer = solution->GetBufferPointer();
+
+  ThreadedRangeLoop< NegateFunctor >::Run( this->Filter->GetMultiThreader(),
+                                           this->Filter->GetNumberOfThreads(),
+                                           solution->GetLargestPossibleRegion().GetNumberOfPixels(),
+                                           negate );
+
+  return solution->GetBufferPointer();
+
+}
+
+template< class TImage >
+template< typename TWorkImage, typename TPoissonSolver >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::DCTInverse< TWorkImage, TPoissonSolver >
+::NegateFunctor
+::operator()( SizeValueType first, SizeValueType last ) const
+{
+  for (SizeValueType p = first; p < last; ++p)
+    {
+    this->Buffer[p] = -this->Buffer[p];
+    }
+}
+
+template< class TImage >
+template< typename TWorkImage >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::JacobiInverse< TWorkImage >
+::Initialize( Self * filter, TWorkImage * residual, const OperatorType & weightedLaplacian )
+{
+
+  this->Filter = filter;
+  this->Residual = residual;
+
+  const SizeValueType numberOfPixels = weightedLaplacian.GetNumberOfPixels();
+  std::vector< double > diagonal( numberOfPixels, 0.0 );
+
+  // The edge to the predecessor of a pixel is that from the predecessor to
+  // its successor.  Where there is no predecessor, p - s is the last pixel
+  // along the axis of another line, whose edge has zero weight.
+  SizeValueType stride = 1;
+  for (unsigned int d = 0; d < TImage::ImageDimension; ++d)
+    {
+    const PixelType * w = weightedLaplacian.GetWeights( d );
+    for (SizeValueType p = 0; p < numberOfPixels; ++p)
+      {
+      diagonal[p] += w[p];
+      }
+    for (SizeValueType p = stride; p < numberOfPixels; ++p)
       {
-      delta += pow(alpha, 2) * pow(pIt.Get(), 2);
+      diagonal[p] += w[p - stride];
       }
+    stride *= weightedLaplacian.GetSize()[d];
+    }
+
+  this->InverseDiagonal.resize( numberOfPixels );
+  for (SizeValueType p = 0; p < numberOfPixels; ++p)
+    {
+    this->InverseDiagonal[p] = static_cast< PixelType >( diagonal[p] > 0.0 ? 1.0 / diagonal[p] : 0.0 );
+    }
+  this->Preconditioned.resize( numberOfPixels );
 
-    delta = std::sqrt(delta/NUMPIX);
-    std::cout << "Delta: " << delta << std::endl;
+}
 
-    std::cout << std::endl;
-    
-    // If epsilon falls below the threshold, break out.
-    if (this->m_MinimumEpsilon >= epsilon) break;
+template< class TImage >
+template< typename TWorkImage >
+const typename TWorkImage::PixelType *
+PCGPhaseUnwrappingImageFilter< TImage >
+::JacobiInverse< TWorkImage >
+::Apply()
+{
+
+  ScaleFunctor scale;
+  scale.Scale = &this->InverseDiagonal[0];
+  scale.In = this->Residual->GetBufferPointer();
+  scale.Out = &this->Preconditioned[0];
+
+  ThreadedRangeLoop< ScaleFunctor >::Run( this->Filter->GetMultiThreader(),
+                                          this->Filter->GetNumberOfThreads(),
+                                          this->Preconditioned.size(),
+                                          scale );
+
+  return &this->Preconditioned[0];
+
+}
+
+template< class TImage >
+template< typename TWorkImage >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::JacobiInverse< TWorkImage >
+::ScaleFunctor
+::operator()( SizeValueType first, SizeValueType last ) const
+{
+  for (SizeValueType p = first; p < last; ++p)
+    {
+    this->Out[p] = this->Scale[p] * this->In[p];
+    }
+}
+
+template< class TImage >
+template< typename TWorkImage >
+void PCGPhaseUnwrappingImageFilter< TImage >
+::MultigridInverse< TWorkImage >
+::Initialize( Self * filter, TWorkImage * residual, const OperatorType & weightedLaplacian )
+{
+
+  this->Residual = residual;
+
+  const SizeValueType numberOfPixels = weightedLaplacian.GetNumberOfPixels();
+
+  this->Solver = SolverType::New();
+  this->Solver->Allocate( weightedLaplacian.GetSize() );
+  for (unsigned int d = 0; d < TImage::ImageDimension; ++d)
+    {
+    std::copy( weightedLaplacian.GetWeights( d ), weightedLaplacian.GetWeights( d ) + numberOfPixels,
+               this->Solver->GetWeights( d ) );
+    }
+
+  // The grids are built once, for a single V cycle per iteration
+  this->Solver->SetCycleType( SolverType::VCycle );
+  this->Solver->Setup( filter->GetMultiThreader(), filter->GetNumberOfThreads() );
+
+}
+
+template< class TImage >
+template< typename TWorkImage >
+const typename TWorkImage::PixelType *
+PCGPhaseUnwrappingImageFilter< TImage >
+::MultigridInverse< TWorkImage >
+::Apply()
+{
+
+  const SizeValueType numberOfPixels = this->Residual->GetLargestPossibleRegion().GetNumberOfPixels();
+
+  // The solver takes sum_n w (z_n - z_c) = f, which is Q z = -f
+  const PixelType * r = this->Residual->GetBufferPointer();
+  PixelType * rhs = this->Solver->GetRightHandSide();
+  for (SizeValueType p = 0; p < numberOfPixels; ++p)
+    {
+    rhs[p] = -r[p];
+    }
+
+  this->Solver->ApplyCycle();
+
+  return this->Solver->GetSolution();
 
-  } 
- 
-  ImageAlgorithm::Copy(soln.GetPointer(),
-                       output.GetPointer(),
-                       output->GetLargestPossibleRegion(),
-                       output->GetLargestPossibleRegion());
-  
 }
 
 //  PrintSelf method prints parameters 
@@ -351,9 +861,20 @@ PCGPhaseUnwrappingImageFilter< TImage >::PrintSelf( std::ostream& os, Indent ind
 { 
   Superclass::PrintSelf(os,indent); 
 
-  os 
-    << indent << "No parameters." 
-    << std::endl; 
+  os << indent << "Maximum Iterations: " << m_MaximumIterations << std::endl;
+  os << indent << "Minimum Epsilon: " << m_MinimumEpsilon << std::endl;
+  os << indent << "Preconditioner: " << (m_Preconditioner == JacobiPreconditioner ? "Jacobi" :
+                                          m_Preconditioner == MultigridPreconditioner ? "Multigrid" : "DCT") << std::endl;
+  os << indent << "Plan Rigor: " << DCTBackend::GetPlanRigorName(m_PlanRigor) << std::endl;
+  os << indent << "Mask Margin: " << m_MaskMargin << std::endl;
+  os << indent << "Mixed Precision: " << (m_MixedPrecision ? "On" : "Off") << std::endl;
+  os << indent << "Elapsed Iterations: " << m_ElapsedIterations << std::endl;
+  os << indent << "Relative Residual: " << m_RelativeResidual << std::endl;
+  os << indent << "Converged: " << (m_Converged ? "Yes" : "No") << std::endl;
+  os << indent << "Alpha: " << m_Alpha << std::endl;
+  os << indent << "Beta: " << m_Beta << std::endl;
+  os << indent << "Delta: " << m_Delta << std::endl;
+  os << indent << "Elapsed Time: " << m_ElapsedTime << std::endl;
 } 
  
 }// end namespace itk
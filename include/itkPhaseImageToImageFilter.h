@@ -20,6 +20,7 @@
 #define itkPhaseImageToImageFilter_h
  
 #include "itkImageToImageFilter.h"
+#include "itkImage.h"
 #include "itkObjectFactory.h"
 #include "vnl/vnl_math.h"
 #include "itkWrapPhaseSymmetricFunctor.h"
@@ -47,6 +48,10 @@ public:
   
   // Other typedefs
   typedef Functor::WrapPhaseSymmetricFunctor< typename TInputImage::PixelType > WrapFunctorType;
+
+  // Mask of the filters which can restrict their solve to a region of interest
+  typedef Image< unsigned char, TInputImage::ImageDimension > MaskImageType;
+  typedef typename TInputImage::RegionType                    InputImageRegionType;
  
   // Method for creation through the object factory
   itkNewMacro(Self);
@@ -68,6 +73,30 @@ protected:
   typename TInputImage::PixelType Unwrap( typename TInputImage::PixelType target,
                                           typename TInputImage::PixelType relativeToReference );
 
+  /* The bounding box of the nonzero pixels of a mask, padded by margin pixels
+   * and cropped to its largest possible region.  Has no pixels if the mask is
+   * empty.  */
+  static InputImageRegionType GetMaskBoundingRegion( const MaskImageType * mask, SizeValueType margin );
+
+  /* Copy a solution computed on an image cropped to region (and so indexed from
+   * zero) into the buffered part of region of output, cast to the output pixel
+   * type.  Pixels outside the mask are set to zero.  */
+  template< typename TSolutionImage >
+  static void PasteMaskedSolution( const TSolutionImage * solution,
+                                   const MaskImageType * mask,
+                                   const InputImageRegionType & region,
+                                   TOutputImage * output );
+
+  /* Make a solution buffered over the requested region of the output the
+   * output: grafted when it has the output type, and otherwise cast pixel by
+   * pixel into the allocated output.  */
+  void GraftSolution( const TOutputImage * solution )
+    {
+    this->GetOutput()->Graft( solution );
+    }
+  template< typename TSolutionImage >
+  void GraftSolution( const TSolutionImage * solution );
+
 //  /* Determine the nearest multiple of two pi that differentiates two inputs.  */
 //  typename TInputImage::PixelType TwoPIMultipleDifference( typename TInputImage::PixelType target,
 //                                                           typename TInputImage::PixelType relativeToReference );
@@ -19,6 +19,10 @@
 #define itkPhaseImageToImageFilter_hxx
 
 #include "itkPhaseImageToImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIterator.h"
+#include <algorithm>
  
 namespace itk {
 
@@ -44,6 +48,105 @@ PhaseImageToImageFilter< TInputImage, TOutputImage >
   
 }
 
+template< class TInputImage, class TOutputImage >
+typename PhaseImageToImageFilter< TInputImage, TOutputImage >::InputImageRegionType
+PhaseImageToImageFilter< TInputImage, TOutputImage >
+::GetMaskBoundingRegion( const MaskImageType * mask, SizeValueType margin )
+{
+
+  const typename MaskImageType::RegionType largest = mask->GetLargestPossibleRegion();
+
+  typename MaskImageType::IndexType lower = largest.GetUpperIndex();
+  typename MaskImageType::IndexType upper = largest.GetIndex();
+  bool empty = true;
+
+  ImageRegionConstIteratorWithIndex< MaskImageType > it( mask, largest );
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+    if ( 0 == it.Get() )
+      {
+      continue;
+      }
+    const typename MaskImageType::IndexType index = it.GetIndex();
+    for (unsigned int d = 0; d < TInputImage::ImageDimension; ++d)
+      {
+      lower[d] = std::min( lower[d], index[d] );
+      upper[d] = std::max( upper[d], index[d] );
+      }
+    empty = false;
+    }
+
+  InputImageRegionType region;
+  if ( empty )
+    {
+    return region;
+    }
+
+  region.SetIndex( lower );
+  region.SetUpperIndex( upper );
+  region.PadByRadius( static_cast< OffsetValueType >( margin ) );
+  region.Crop( largest );
+  return region;
+
+}
+
+template< class TInputImage, class TOutputImage >
+template< typename TSolutionImage >
+void
+PhaseImageToImageFilter< TInputImage, TOutputImage >
+::PasteMaskedSolution( const TSolutionImage * solution,
+                       const MaskImageType * mask,
+                       const InputImageRegionType & region,
+                       TOutputImage * output )
+{
+
+  InputImageRegionType target = region;
+  if ( !target.Crop( output->GetBufferedRegion() ) )
+    {
+    return;
+    }
+
+  typename TOutputImage::RegionType source = target;
+  typename TOutputImage::IndexType index = target.GetIndex();
+  for (unsigned int d = 0; d < TInputImage::ImageDimension; ++d)
+    {
+    index[d] -= region.GetIndex()[d];
+    }
+  source.SetIndex( index );
+
+  typedef typename TOutputImage::PixelType OutputPixelType;
+
+  ImageRegionConstIterator< TSolutionImage > sIt( solution, source );
+  ImageRegionConstIterator< MaskImageType >  mIt( mask, target );
+  ImageRegionIterator< TOutputImage >        oIt( output, target );
+  for (sIt.GoToBegin(), mIt.GoToBegin(), oIt.GoToBegin(); !oIt.IsAtEnd(); ++sIt, ++mIt, ++oIt)
+    {
+    oIt.Set( mIt.Get() ? static_cast< OutputPixelType >( sIt.Get() ) : 0 );
+    }
+
+}
+
+template< class TInputImage, class TOutputImage >
+template< typename TSolutionImage >
+void
+PhaseImageToImageFilter< TInputImage, TOutputImage >
+::GraftSolution( const TSolutionImage * solution )
+{
+
+  typedef typename TOutputImage::PixelType OutputPixelType;
+
+  this->AllocateOutputs();
+  TOutputImage * output = this->GetOutput();
+
+  ImageRegionConstIterator< TSolutionImage > sIt( solution, output->GetBufferedRegion() );
+  ImageRegionIterator< TOutputImage >        oIt( output, output->GetBufferedRegion() );
+  for (sIt.GoToBegin(), oIt.GoToBegin(); !oIt.IsAtEnd(); ++sIt, ++oIt)
+    {
+    oIt.Set( static_cast< OutputPixelType >( sIt.Get() ) );
+    }
+
+}
+
 template < typename TInputImage, typename TOutputImage > 
 void 
 PhaseImageToImageFilter< TInputImage, TOutputImage >
@@ -0,0 +1,100 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkThreadedRangeLoop_h
+#define itkThreadedRangeLoop_h
+
+#include "itkMultiThreader.h"
+#include "itkIntTypes.h"
+
+namespace itk
+{
+
+/** \class ThreadedRangeLoop
+ *  \ingroup ITKPhase
+ * \brief Runs a functor over contiguous chunks of the range [0, n) using a MultiThreader.
+ *
+ * Filters which operate directly on pixel buffers (for example the spectral
+ * step of DCTPoissonSolverImageFilter) use this class to split their work
+ * across the filter's MultiThreader without going through
+ * ThreadedGenerateData().  The functor is called as functor( first, last )
+ * for a half-open chunk [first, last), once per thread, and must only write
+ * to the part of its data corresponding to that chunk.
+ */
+template< typename TFunctor >
+class ThreadedRangeLoop
+{
+public:
+
+  static void Run( MultiThreader * threader,
+                   ThreadIdType numberOfThreads,
+                   SizeValueType n,
+                   TFunctor & functor )
+    {
+    if ( n == 0 )
+      {
+      return;
+      }
+    if ( numberOfThreads <= 1 || n == 1 )
+      {
+      functor( 0, n );
+      return;
+      }
+
+    ThreadStruct str;
+    str.Functor = &functor;
+    str.N = n;
+
+    threader->SetNumberOfThreads( numberOfThreads );
+    threader->SetSingleMethod( Self::ThreaderCallback, &str );
+    threader->SingleMethodExecute();
+    }
+
+private:
+
+  typedef ThreadedRangeLoop Self;
+
+  struct ThreadStruct
+    {
+    TFunctor *    Functor;
+    SizeValueType N;
+    };
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback( void * arg )
+    {
+    MultiThreader::ThreadInfoStruct * info = static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+    ThreadStruct * str = static_cast< ThreadStruct * >( info->UserData );
+
+    const SizeValueType id = info->ThreadID;
+    const SizeValueType total = info->NumberOfThreads;
+    const SizeValueType first = ( str->N * id ) / total;
+    const SizeValueType last = ( str->N * ( id + 1 ) ) / total;
+
+    if ( first < last )
+      {
+      ( *str->Functor )( first, last );
+      }
+
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,143 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkWeightedLaplacianOperator_h
+#define itkWeightedLaplacianOperator_h
+
+#include "itkSize.h"
+#include "itkMultiThreader.h"
+#include "itkThreadedRangeLoop.h"
+#include <vector>
+
+namespace itk
+{
+/** \class WeightedLaplacianOperator
+ * \ingroup ITKPhase
+ * \brief Matrix-free weighted Laplacian with precomputed edge weights.
+ *
+ * Applies out_c = sum_n w_cn D( x_c, x_n ) over the neighbours n of each
+ * pixel c along every axis, where D is a difference functor and w_cn is the
+ * weight of the edge between c and n.  With D( c, n ) = c - n this is the
+ * weighted Laplacian Q of the PCG unwrapping in [1], and with
+ * D( c, n ) = W( n - c ), W wrapping into [-pi, pi), it is the weighted
+ * Laplacian of a wrapped phase, the right hand side of the same solve.
+ *
+ * The weights are computed once by SetQuality(), as min( q_c^2, q_n^2 ) from
+ * a quality map q, and stored per axis in the order of an image buffer:
+ * GetWeights( d )[p] is the weight of the edge between pixel p and its
+ * successor along axis d, as in MultigridPoissonSolver.  Edges which would
+ * leave the grid, and those along axes which are not differentiated, have
+ * zero weight, which gives the symmetric Neumann form of the operator.
+ *
+ * ApplyToLine() evaluates a segment of a line along the first axis in linear
+ * memory, without per-pixel boundary tests, so that the caller may split the
+ * work across threads by lines.
+ *
+ * [1] "2D Phase Unwrapping: Theory, Algorithms, and Software" by Dennis C
+ * Ghiglia and Mark D. Pritt.
+ */
+template< typename TPixel, unsigned int VDimension >
+class WeightedLaplacianOperator
+{
+public:
+
+  typedef WeightedLaplacianOperator Self;
+  typedef TPixel                    PixelType;
+  typedef Size< VDimension >        SizeType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, VDimension);
+
+  /** D( c, n ) = c - n, for the weighted Laplacian Q. */
+  struct Difference
+    {
+    double operator()( double center, double neighbour ) const
+      {
+      return center - neighbour;
+      }
+    };
+
+  WeightedLaplacianOperator();
+
+  /** Compute the edge weights of a grid of the given size from a quality
+   * buffer in the order of an image buffer.  If mask is not null, pixels
+   * where it is zero have zero quality.  Only the first numberOfAxes axes are
+   * differentiated.  The work is split across the given threads. */
+  template< typename TQualityPixel, typename TMaskPixel >
+  void SetQuality( const SizeType & size,
+                   const TQualityPixel * quality,
+                   const TMaskPixel * mask,
+                   unsigned int numberOfAxes,
+                   MultiThreader * threader,
+                   ThreadIdType numberOfThreads );
+
+  /** Writes length values of the operator applied to in, for the pixels
+   * from offset, whose index is index, along the first axis, to out.  The
+   * segment must lie within one line. */
+  template< typename TInPixel, typename TDifference >
+  void ApplyToLine( const TInPixel * in,
+                    SizeValueType offset,
+                    const IndexValueType * index,
+                    SizeValueType length,
+                    const TDifference & difference,
+                    double * out ) const;
+
+  const SizeType & GetSize() const
+    {
+    return this->m_Size;
+    }
+
+  SizeValueType GetNumberOfPixels() const
+    {
+    return this->m_NumberOfPixels;
+    }
+
+  const PixelType * GetWeights( unsigned int d ) const
+    {
+    return &this->m_Weights[d][0];
+    }
+
+  /** Free the edge weights. */
+  void Release();
+
+private:
+
+  // Edge weights of the lines [firstLine, lastLine) along the first axis
+  template< typename TQualityPixel, typename TMaskPixel >
+  struct WeightsFunctor
+    {
+    void operator()( SizeValueType firstLine, SizeValueType lastLine ) const;
+
+    Self *                Operator;
+    const TQualityPixel * Quality;
+    const TMaskPixel *    Mask;
+    unsigned int          NumberOfAxes;
+    };
+
+  SizeType                 m_Size;
+  SizeValueType            m_Stride[VDimension];
+  SizeValueType            m_NumberOfPixels;
+  std::vector< PixelType > m_Weights[VDimension];
+
+};
+} //namespace ITK
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkWeightedLaplacianOperator.hxx"
+#endif
+
+#endif
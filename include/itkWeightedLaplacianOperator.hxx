@@ -0,0 +1,224 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkWeightedLaplacianOperator_hxx
+#define itkWeightedLaplacianOperator_hxx
+
+#include "itkWeightedLaplacianOperator.h"
+#include <algorithm>
+
+namespace itk {
+
+template< typename TPixel, unsigned int VDimension >
+WeightedLaplacianOperator< TPixel, VDimension >
+::WeightedLaplacianOperator() :
+m_NumberOfPixels(0)
+{
+  this->m_Size.Fill( 0 );
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    this->m_Stride[d] = 0;
+    }
+}
+
+template< typename TPixel, unsigned int VDimension >
+template< typename TQualityPixel, typename TMaskPixel >
+void
+WeightedLaplacianOperator< TPixel, VDimension >
+::SetQuality( const SizeType & size,
+              const TQualityPixel * quality,
+              const TMaskPixel * mask,
+              unsigned int numberOfAxes,
+              MultiThreader * threader,
+              ThreadIdType numberOfThreads )
+{
+
+  this->m_Size = size;
+  SizeValueType stride = 1;
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    this->m_Stride[d] = stride;
+    stride *= size[d];
+    }
+  this->m_NumberOfPixels = stride;
+
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    this->m_Weights[d].resize( this->m_NumberOfPixels );
+    }
+  if ( 0 == this->m_NumberOfPixels )
+    {
+    return;
+    }
+
+  WeightsFunctor< TQualityPixel, TMaskPixel > weights;
+  weights.Operator = this;
+  weights.Quality = quality;
+  weights.Mask = mask;
+  weights.NumberOfAxes = ( numberOfAxes < VDimension ) ? numberOfAxes : VDimension;
+
+  ThreadedRangeLoop< WeightsFunctor< TQualityPixel, TMaskPixel > >::Run(
+    threader, numberOfThreads, this->m_NumberOfPixels / size[0], weights );
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+template< typename TQualityPixel, typename TMaskPixel >
+void
+WeightedLaplacianOperator< TPixel, VDimension >
+::WeightsFunctor< TQualityPixel, TMaskPixel >
+::operator()( SizeValueType firstLine, SizeValueType lastLine ) const
+{
+
+  const SizeType & size = this->Operator->m_Size;
+  const SizeValueType lineLength = size[0];
+  IndexValueType index[ImageDimension];
+
+  for (SizeValueType line = firstLine; line < lastLine; ++line)
+    {
+
+    SizeValueType remainder = line;
+    for (unsigned int d = 1; d < ImageDimension; ++d)
+      {
+      index[d] = remainder % size[d];
+      remainder /= size[d];
+      }
+
+    const SizeValueType first = line * lineLength;
+
+    for (unsigned int d = 0; d < ImageDimension; ++d)
+      {
+
+      PixelType * w = &this->Operator->m_Weights[d][first];
+      const SizeValueType s = this->Operator->m_Stride[d];
+
+      // Only pixels with a successor along the axis have an edge; along the
+      // first axis that is all but the last pixel of the line
+      SizeValueType numberOfEdges = 0;
+      if ( d < this->NumberOfAxes && size[d] > 1 )
+        {
+        if ( 0 == d )
+          {
+          numberOfEdges = lineLength - 1;
+          }
+        else if ( index[d] < static_cast< IndexValueType >( size[d] ) - 1 )
+          {
+          numberOfEdges = lineLength;
+          }
+        }
+
+      for (SizeValueType i = 0; i < numberOfEdges; ++i)
+        {
+        const SizeValueType p = first + i;
+        double q1 = this->Quality[p];
+        double q2 = this->Quality[p + s];
+        q1 = ( this->Mask && !this->Mask[p] ) ? 0.0 : q1 * q1;
+        q2 = ( this->Mask && !this->Mask[p + s] ) ? 0.0 : q2 * q2;
+        w[i] = static_cast< PixelType >( std::min( q1, q2 ) );
+        }
+      std::fill( w + numberOfEdges, w + lineLength, static_cast< PixelType >( 0 ) );
+
+      }
+
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+template< typename TInPixel, typename TDifference >
+void
+WeightedLaplacianOperator< TPixel, VDimension >
+::ApplyToLine( const TInPixel * in,
+               SizeValueType offset,
+               const IndexValueType * index,
+               SizeValueType length,
+               const TDifference & difference,
+               double * out ) const
+{
+
+  const TInPixel * x = in + offset;
+  std::fill( out, out + length, 0.0 );
+
+  // Along the first axis, the edges to the successor and the predecessor of
+  // each pixel of the segment, when they exist
+  const SizeValueType n = this->m_Size[0];
+  const SizeValueType start = index[0];
+  if ( n > 1 )
+    {
+    const PixelType * w = &this->m_Weights[0][offset];
+    const SizeValueType forward = std::min( length, n - 1 - start );
+    for (SizeValueType i = 0; i < forward; ++i)
+      {
+      out[i] += w[i] * difference( x[i], x[i+1] );
+      }
+    for (SizeValueType i = ( 0 == start ) ? 1 : 0; i < length; ++i)
+      {
+      out[i] += w[i-1] * difference( x[i], x[i-1] );
+      }
+    }
+
+  // Along the other axes the whole segment has, or lacks, each neighbour.  A
+  // missing successor has zero weight, but would be read out of the buffer.
+  for (unsigned int d = 1; d < ImageDimension; ++d)
+    {
+
+    const IndexValueType size = this->m_Size[d];
+    if ( size < 2 )
+      {
+      continue;
+      }
+
+    const SizeValueType s = this->m_Stride[d];
+
+    if ( index[d] < size - 1 )
+      {
+      const PixelType * w = &this->m_Weights[d][offset];
+      const TInPixel * next = x + s;
+      for (SizeValueType i = 0; i < length; ++i)
+        {
+        out[i] += w[i] * difference( x[i], next[i] );
+        }
+      }
+
+    if ( index[d] > 0 )
+      {
+      const PixelType * w = &this->m_Weights[d][offset - s];
+      const TInPixel * previous = x - s;
+      for (SizeValueType i = 0; i < length; ++i)
+        {
+        out[i] += w[i] * difference( x[i], previous[i] );
+        }
+      }
+
+    }
+
+}
+
+template< typename TPixel, unsigned int VDimension >
+void
+WeightedLaplacianOperator< TPixel, VDimension >
+::Release()
+{
+  for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+    std::vector< PixelType >().swap( this->m_Weights[d] );
+    }
+}
+
+}// end namespace itk
+
+#endif
@@ -21,10 +21,15 @@
 
 #include "itkObjectFactory.h"
 #include "itkImageRegionIterator.h"
+#include "itkImageRegionConstIterator.h"
 #include "itkConstNeighborhoodIterator.h"
+#include "itkImageScanlineIterator.h"
 
 #include "itkWrappedPhaseDifferencesBaseImageFilter.h"
 #include "itkPhaseQualityImageFilter.h"
+#include "itkWeightedLaplacianOperator.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -36,6 +41,14 @@ namespace itk
  * the difference between the wrapped phase difference at that pixel and the wrapped
  * phase difference at the previous pixel (equation 5.32, [1]).
  *
+ * When Weighted is on, each wrapped difference is weighted by min( q_c^2, q_n^2 )
+ * of the phase quality q at its two ends, and the Laplacian is applied by a
+ * WeightedLaplacianOperator whose edge weights are computed once, before the
+ * threaded pass.  Differences which would leave the image have zero weight,
+ * the symmetric Neumann form solved by PCGPhaseUnwrappingImageFilter and
+ * MultigridPhaseUnwrappingImageFilter; the unweighted Laplacian reflects
+ * them at the boundary instead.
+ *
  * Please see  [1] "2D Phase Unwrapping: Theory, Algorithms, and Software" by Dennis C Ghiglia
  * and Mark D. Pritt for an excellent introduction to phase unwrapping and phase residues.
  */
@@ -72,7 +85,50 @@ public:
   // Class Methods
   itkSetMacro(Weighted, bool);
   itkGetConstMacro(Weighted, bool);
-  
+
+  /** Set/Get whether the last axis indexes a series of independent frames,
+   * in which case no differences are taken along it.  Default is off. */
+  itkSetMacro(BatchAlongLastAxis, bool);
+  itkGetConstMacro(BatchAlongLastAxis, bool);
+  itkBooleanMacro(BatchAlongLastAxis);
+
+  /** Sum and mean of the Laplacian over the requested region, accumulated
+   * during the threaded pass which computes it.  Valid after Update(). */
+  itkGetConstMacro(Sum, double);
+  itkGetConstMacro(Mean, double);
+
+  typedef typename Superclass::MaskImageType MaskImageType;
+
+  /** Set/Get an optional mask.  When weighted, pixels outside the mask have
+   * zero quality, so the differences to them carry no weight. */
+  void SetMaskImage( const MaskImageType * mask )
+    {
+    this->SetNthInput( 1, const_cast< MaskImageType * >( mask ) );
+    }
+  const MaskImageType * GetMaskImage() const
+    {
+    return dynamic_cast< const MaskImageType * >( this->ProcessObject::GetInput( 1 ) );
+    }
+
+  /** The quality map the weights are computed from, zero outside the mask.
+   * Valid after Update() when weighted. */
+  const TInputImage * GetQualityImage() const
+    {
+    return this->m_QualityImage.GetPointer();
+    }
+
+  typedef WeightedLaplacianOperator< typename TInputImage::PixelType,
+                                     TInputImage::ImageDimension > OperatorType;
+
+  /** The operator holding the edge weights.  Valid after Update() when
+   * weighted. */
+  const OperatorType & GetWeightedLaplacianOperator() const
+    {
+    return this->m_Operator;
+    }
+
+  typedef typename Superclass::OutputImageRegionType OutputImageRegionType;
+
   /** Display */
   void PrintSelf( std::ostream& os, Indent indent ) const ITK_OVERRIDE;
  
@@ -81,8 +137,20 @@ protected:
   WrappedPhaseLaplacianImageFilter();
   ~WrappedPhaseLaplacianImageFilter(){}
  
+  /** Requests the output region and its nearest neighbors, or the whole
+   * image when weighted. */
+  virtual void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  /** Computes the quality map and the edge weights when weighted, and
+   * applies the mask to them. */
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
   /** Does the real work. */
-  virtual void GenerateData() ITK_OVERRIDE;
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType threadId) ITK_OVERRIDE;
+
+  /** Combines the per-thread sums. */
+  virtual void AfterThreadedGenerateData() ITK_OVERRIDE;
 
 private:
 
@@ -91,10 +159,31 @@ private:
   typedef ConstNeighborhoodIterator< TInputImage > CNItType;
   typedef ImageRegionIterator< TInputImage >       ItType;
   typedef PhaseQualityImageFilter< TInputImage >   QualType;
+
+  // D( c, n ) = W( n - c ), for the weighted Laplacian of the wrapped phase
+  struct WrappedDifference
+    {
+    double operator()( double center, double neighbour ) const
+      {
+      return this->Wrap( neighbour - center );
+      }
+
+    Functor::WrapPhaseSymmetricFunctor< double > Wrap;
+    };
  
   typename QualType::Pointer m_Qual = ITK_NULLPTR;
+
+  // The output of m_Qual, or its masked copy
+  typename TInputImage::ConstPointer m_QualityImage;
+
+  OperatorType m_Operator;
  
   bool m_Weighted;
+  bool m_BatchAlongLastAxis;
+
+  std::vector< double > m_ThreadSums;
+  double                m_Sum;
+  double                m_Mean;
  
 };
 } //namespace ITK
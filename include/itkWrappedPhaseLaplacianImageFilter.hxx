@@ -26,39 +26,130 @@ template< typename TInputImage, typename TOutputImage >
 WrappedPhaseLaplacianImageFilter< TInputImage, TOutputImage >
 ::WrappedPhaseLaplacianImageFilter() :
 m_Qual(QualType::New()),
-m_Weighted(false)
+m_Weighted(false),
+m_BatchAlongLastAxis(false),
+m_Sum(0.0),
+m_Mean(0.0)
 {}
 
 template< typename TInputImage, typename TOutputImage >
 void
 WrappedPhaseLaplacianImageFilter< TInputImage, TOutputImage >
-::GenerateData()
+::BeforeThreadedGenerateData()
+{
+
+  // The quality map is only needed for the weighted Laplacian
+  if (this->m_Weighted)
+    {
+    this->m_Qual->SetInput( this->GetInput() );
+    this->m_Qual->Update();
+    this->m_QualityImage = this->m_Qual->GetOutput();
+
+    // Zero quality outside the mask, in a copy so that the quality filter
+    // need not run again when only the mask changes
+    const MaskImageType * mask = this->GetMaskImage();
+    if (mask)
+      {
+      typename TInputImage::Pointer masked = TInputImage::New();
+      masked->CopyInformation( this->m_Qual->GetOutput() );
+      masked->SetRegions( this->m_Qual->GetOutput()->GetBufferedRegion() );
+      masked->Allocate();
+
+      ImageRegionConstIterator< TInputImage > qIt( this->m_Qual->GetOutput(), masked->GetBufferedRegion() );
+      ImageRegionConstIterator< MaskImageType > mIt( mask, masked->GetBufferedRegion() );
+      ItType oIt( masked, masked->GetBufferedRegion() );
+      for (qIt.GoToBegin(), mIt.GoToBegin(), oIt.GoToBegin(); !oIt.IsAtEnd(); ++qIt, ++mIt, ++oIt)
+        {
+        oIt.Set( mIt.Get() ? qIt.Get() : 0 );
+        }
+
+      this->m_QualityImage = masked;
+      }
+
+    const unsigned int numberOfAxes = this->m_BatchAlongLastAxis
+      ? TInputImage::ImageDimension - 1 : TInputImage::ImageDimension;
+    this->m_Operator.SetQuality( this->GetInput()->GetLargestPossibleRegion().GetSize(),
+                                 this->m_QualityImage->GetBufferPointer(),
+                                 static_cast< const typename MaskImageType::PixelType * >( ITK_NULLPTR ),
+                                 numberOfAxes,
+                                 this->GetMultiThreader(),
+                                 this->GetNumberOfThreads() );
+    }
+  else
+    {
+    this->m_Operator.Release();
+    }
+
+  this->m_ThreadSums.assign( this->GetNumberOfThreads(), 0.0 );
+
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+WrappedPhaseLaplacianImageFilter< TInputImage, TOutputImage >
+::ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                       ThreadIdType threadId)
 {
 
   typename TInputImage::ConstPointer input = this->GetInput();
   typename TInputImage::Pointer output = this->GetOutput();
-  this->AllocateOutputs();
-  output->FillBuffer( 0 );
 
-  this->m_Qual->SetInput( input );
-  this->m_Qual->Update();
+  // Only the requested region is computed, so that the filter may be streamed
+  const typename TInputImage::RegionType region = outputRegionForThread;
+
+  double sum = 0.0;
+
+  // The weighted Laplacian, line by line, from the whole input
+  if (this->m_Weighted)
+    {
+    const typename TInputImage::IndexType origin = input->GetBufferedRegion().GetIndex();
+    const SizeValueType length = region.GetSize()[0];
+    std::vector< double > line( length );
+    WrappedDifference difference;
+
+    IndexValueType index[TInputImage::ImageDimension];
+    ImageScanlineIterator< TOutputImage > outIt( output, region );
+    while ( !outIt.IsAtEnd() )
+      {
+      const typename TInputImage::IndexType lineIndex = outIt.GetIndex();
+      for (unsigned int d = 0; d < TInputImage::ImageDimension; ++d)
+        {
+        index[d] = lineIndex[d] - origin[d];
+        }
+      this->m_Operator.ApplyToLine( input->GetBufferPointer(), input->ComputeOffset( lineIndex ),
+                                    index, length, difference, &line[0] );
+      for (SizeValueType i = 0; i < length; ++i, ++outIt)
+        {
+        outIt.Set( static_cast< typename TOutputImage::PixelType >( line[i] ) );
+        sum += outIt.Get();
+        }
+      outIt.NextLine();
+      }
+
+    this->m_ThreadSums[threadId] = sum;
+    return;
+    }
 
   typename CNItType::RadiusType radius;
   radius.Fill( 1 );
 
-  CNItType inIt( radius, input, input->GetLargestPossibleRegion() );
-  CNItType qualIt( radius, this->m_Qual->GetOutput(), input->GetLargestPossibleRegion() );
-  ItType outIt( output, input->GetLargestPossibleRegion() );
+  CNItType inIt( radius, input, region );
+  ItType outIt( output, region );
 
   // p. 368-9
   typename CNItType::SizeValueType k = inIt.Size() / 2;
 
-  for (inIt.GoToBegin(), qualIt.GoToBegin(), outIt.GoToBegin();
+  const unsigned int numberOfAxes = this->m_BatchAlongLastAxis
+    ? TInputImage::ImageDimension - 1 : TInputImage::ImageDimension;
+
+  for (inIt.GoToBegin(), outIt.GoToBegin();
        !inIt.IsAtEnd();
-       ++inIt, ++qualIt, ++outIt )
+       ++inIt, ++outIt )
     {
 
-    for (unsigned int i = 0; i < TInputImage::ImageDimension; ++i)
+    outIt.Set( 0 );
+
+    for (unsigned int i = 0; i < numberOfAxes; ++i)
       {
 
       const typename TInputImage::IndexType::IndexValueType leftIndex
@@ -92,28 +183,67 @@ WrappedPhaseLaplacianImageFilter< TInputImage, TOutputImage >
 //        }
 // END NEW WAY
 
-      if (this->m_Weighted)
-        {
-        double w1 = qualIt.GetPixel( k1 );
-        double w2 = qualIt.GetPixel( k2 );
+      outIt.Value() += this->Wrap(inIt.GetPixel( k1 ) - inIt.GetCenterPixel());
+      outIt.Value() += this->Wrap(inIt.GetPixel( k2 ) - inIt.GetCenterPixel());
 
-        const double wCenter = qualIt.GetCenterPixel();
-        w1 = (wCenter*wCenter < w1*w1) ? wCenter*wCenter : w1*w1;
-        w2 = (wCenter*wCenter < w2*w2) ? wCenter*wCenter : w2*w2;
+      }
 
-        outIt.Value() += w1*this->Wrap(inIt.GetPixel( k1 ) - inIt.GetCenterPixel());
-        outIt.Value() += w2*this->Wrap(inIt.GetPixel( k2 ) - inIt.GetCenterPixel());
-        }
-      else
-        {
-        outIt.Value() += this->Wrap(inIt.GetPixel( k1 ) - inIt.GetCenterPixel());
-        outIt.Value() += this->Wrap(inIt.GetPixel( k2 ) - inIt.GetCenterPixel());
-        }
+    sum += outIt.Get();
 
-      }
+    }
+
+  this->m_ThreadSums[threadId] = sum;
+
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+WrappedPhaseLaplacianImageFilter< TInputImage, TOutputImage >
+::AfterThreadedGenerateData()
+{
+
+  // Combined in thread order, so the result does not depend on scheduling
+  this->m_Sum = 0.0;
+  for (unsigned int t = 0; t < this->m_ThreadSums.size(); ++t)
+    {
+    this->m_Sum += this->m_ThreadSums[t];
+    }
+  this->m_Mean = this->m_Sum / this->GetOutput()->GetRequestedRegion().GetNumberOfPixels();
+
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+WrappedPhaseLaplacianImageFilter< TInputImage, TOutputImage >
+::GenerateInputRequestedRegion()
+{
 
+  Superclass::GenerateInputRequestedRegion();
+
+  TInputImage * input = const_cast< TInputImage * >( this->GetInput() );
+  if ( !input )
+    {
+    return;
+    }
+
+  // The quality map is computed over the whole image
+  if (this->m_Weighted)
+    {
+    input->SetRequestedRegionToLargestPossibleRegion();
+    MaskImageType * mask = const_cast< MaskImageType * >( this->GetMaskImage() );
+    if (mask)
+      {
+      mask->SetRequestedRegionToLargestPossibleRegion();
+      }
+    return;
     }
 
+  // Otherwise, the requested region and its nearest neighbors
+  typename TInputImage::RegionType region = this->GetOutput()->GetRequestedRegion();
+  region.PadByRadius( 1 );
+  region.Crop( input->GetLargestPossibleRegion() );
+  input->SetRequestedRegion( region );
+
 }
 
 template < typename TInputImage, typename TOutputImage >
@@ -125,6 +255,9 @@ WrappedPhaseLaplacianImageFilter< TInputImage, TOutputImage >
 //  Superclass::PrintSelf(os,indent);
 
   os << indent << "Weighted: " << m_Weighted << std::endl;
+  os << indent << "Batch Along Last Axis: " << m_BatchAlongLastAxis << std::endl;
+  os << indent << "Sum: " << m_Sum << std::endl;
+  os << indent << "Mean: " << m_Mean << std::endl;
 
 }
 
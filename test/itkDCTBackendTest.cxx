@@ -0,0 +1,227 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkDCTImageFilter.h"
+#include "itkDCTPhaseUnwrappingImageFilter.h"
+#include "itkTestingMacros.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkTimeProbe.h"
+#include "itkWrapPhaseSymmetricFunctor.h"
+#include <vector>
+
+// Reports the wall time of a forward and reverse DCT by each available backend
+// for volumes of FFT friendly and awkward extents, so that the faster backend
+// may be chosen for the host.  Timings are informational; the test fails only
+// if a round trip is wrong or the backends disagree.
+int itkDCTBackendTest(int argc, char *argv[])
+{
+
+  if (argc > 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " [repeats]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const unsigned int Dimension = 3;
+
+  typedef double                                                 PixelType;
+  typedef itk::Image< PixelType, Dimension >                     ImageType;
+  typedef itk::Image< PixelType, 2 >                             SliceType;
+  typedef itk::DCTImageFilter< ImageType >                       DCTType;
+  typedef itk::DCTPhaseUnwrappingImageFilter< SliceType >        UnwrapType;
+  typedef itk::ImageRegionIteratorWithIndex< SliceType >         SliceItType;
+  typedef itk::Functor::WrapPhaseSymmetricFunctor< PixelType >   WrapType;
+
+  const unsigned int repeats = (2 == argc) ? atoi(argv[1]) : 3;
+
+  const itk::DCTBackend::BackendEnumType configured = itk::DCTBackend::GetBackend();
+
+  // FFTW is compared only if it provides double precision
+  std::vector< itk::DCTBackend::BackendEnumType > backends;
+  backends.push_back( itk::DCTBackend::Bundled );
+  itk::DCTBackend::SetBackend( itk::DCTBackend::FFTW );
+  if ( itk::DCTBackend::FFTW == DCTType::GetBackend() )
+    {
+    backends.push_back( itk::DCTBackend::FFTW );
+    }
+
+  const unsigned int numberOfSizes = 4;
+  const ImageType::SizeValueType sizes[numberOfSizes][Dimension] = {
+    {  64,  64,  32 },
+    {  67,  67,  41 },
+    { 128, 128,  64 },
+    { 120,  90,  49 } };
+
+  const int numberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+
+  for (unsigned int s = 0; s < numberOfSizes; ++s)
+    {
+
+    ImageType::SizeType size;
+    itk::SizeValueType numberOfPixels = 1;
+    for (unsigned int d = 0; d < Dimension; ++d)
+      {
+      size[d] = sizes[s][d];
+      numberOfPixels *= size[d];
+      }
+
+    std::vector< PixelType > input( numberOfPixels );
+    unsigned int seed = 1;
+    for (itk::SizeValueType i = 0; i < numberOfPixels; ++i)
+      {
+      seed = 1103515245u * seed + 12345u;
+      input[i] = ( seed >> 16 ) / 65536.0 - 0.5;
+      }
+
+    const double norm = DCTType::GetNormalizationFactor( size );
+
+    std::vector< PixelType > spectrum[2];
+    std::vector< PixelType > buffer( numberOfPixels );
+
+    std::cout << "Size: " << size;
+
+    double fastestTime = 0.0;
+    itk::DCTBackend::BackendEnumType fastest = itk::DCTBackend::Bundled;
+
+    for (unsigned int b = 0; b < backends.size(); ++b)
+      {
+
+      itk::DCTBackend::SetBackend( backends[b] );
+
+      // Forward transform, also planning outside of the timed region
+      spectrum[b] = input;
+      DCTType::TransformBuffer( size, &spectrum[b][0], &spectrum[b][0], DCTType::Forward,
+                                itk::DCTBackend::GetPlanRigor(), numberOfThreads );
+
+      itk::TimeProbe probe;
+      for (unsigned int r = 0; r < repeats; ++r)
+        {
+        buffer = input;
+        probe.Start();
+        DCTType::TransformBuffer( size, &buffer[0], &buffer[0], DCTType::Forward,
+                                  itk::DCTBackend::GetPlanRigor(), numberOfThreads );
+        DCTType::TransformBuffer( size, &buffer[0], &buffer[0], DCTType::Reverse,
+                                  itk::DCTBackend::GetPlanRigor(), numberOfThreads );
+        probe.Stop();
+        }
+
+      double maximumError = 0.0;
+      for (itk::SizeValueType i = 0; i < numberOfPixels; ++i)
+        {
+        maximumError = std::max( maximumError, std::fabs( buffer[i] / norm - input[i] ) );
+        }
+
+      std::cout << "\t" << itk::DCTBackend::GetBackendName( backends[b] )
+                << " time: " << probe.GetMean() << " s";
+
+      if ( 0 == b || probe.GetMean() < fastestTime )
+        {
+        fastestTime = probe.GetMean();
+        fastest = backends[b];
+        }
+
+      if (maximumError > 1e-10)
+        {
+        std::cerr << std::endl << "ERROR: The " << itk::DCTBackend::GetBackendName( backends[b] )
+                  << " round trip is off by " << maximumError << std::endl;
+        return EXIT_FAILURE;
+        }
+
+      }
+
+    std::cout << "\tFastest: " << itk::DCTBackend::GetBackendName( fastest ) << std::endl;
+
+    if ( 2 == backends.size() )
+      {
+      double maximumDifference = 0.0;
+      double maximumMagnitude = 0.0;
+      for (itk::SizeValueType i = 0; i < numberOfPixels; ++i)
+        {
+        maximumDifference = std::max( maximumDifference, std::fabs( spectrum[0][i] - spectrum[1][i] ) );
+        maximumMagnitude = std::max( maximumMagnitude, std::fabs( spectrum[1][i] ) );
+        }
+      if (maximumDifference > 1e-10 * maximumMagnitude)
+        {
+        std::cerr << "ERROR: The FFTW and bundled transforms differ by " << maximumDifference << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+
+    }
+
+  /////////////////////////////
+  // Rows Unwrapped by Each  //
+  /////////////////////////////
+
+    {
+    SliceType::Pointer wrapped = SliceType::New();
+    const SliceType::SizeType size = {{45,38}};
+    wrapped->SetRegions( SliceType::RegionType( size ) );
+    wrapped->Allocate();
+
+    WrapType wrap;
+    SliceItType it( wrapped, wrapped->GetLargestPossibleRegion() );
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+      {
+      const SliceType::IndexType i = it.GetIndex();
+      it.Set( wrap( 0.02 * i[0] * i[0] + i[1] / 3.0 ) );
+      }
+
+    // Each row is a frame, and the frames are transformed as one batch
+    std::vector< UnwrapType::Pointer > unwrap;
+    for (unsigned int b = 0; b < backends.size(); ++b)
+      {
+      itk::DCTBackend::SetBackend( backends[b] );
+      unwrap.push_back( UnwrapType::New() );
+      unwrap[b]->BatchAlongLastAxisOn();
+      unwrap[b]->SetInput( wrapped );
+      unwrap[b]->Update();
+      }
+
+    for (unsigned int b = 1; b < backends.size(); ++b)
+      {
+      double maximumDifference = 0.0;
+      SliceItType ait( unwrap[0]->GetOutput(), wrapped->GetLargestPossibleRegion() );
+      SliceItType bit( unwrap[b]->GetOutput(), wrapped->GetLargestPossibleRegion() );
+      for (ait.GoToBegin(), bit.GoToBegin(); !ait.IsAtEnd(); ++ait, ++bit)
+        {
+        maximumDifference = std::max( maximumDifference, std::fabs( ait.Get() - bit.Get() ) );
+        }
+
+      if (maximumDifference > 1e-8)
+        {
+        std::cerr << "ERROR: The unwrapped phases of the backends differ by "
+                  << maximumDifference << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  /////////////////////
+  // Set/Get Methods //
+  /////////////////////
+
+  itk::DCTBackend::SetBackend( itk::DCTBackend::Bundled );
+  TEST_SET_GET_VALUE( itk::DCTBackend::Bundled, itk::DCTBackend::GetBackend() );
+  TEST_SET_GET_VALUE( itk::DCTBackend::Bundled, DCTType::GetBackend() );
+
+  itk::DCTBackend::SetBackend( configured );
+
+  return EXIT_SUCCESS;
+
+}
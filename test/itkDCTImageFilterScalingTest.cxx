@@ -0,0 +1,120 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkDCTImageFilter.h"
+#include "itkTestingMacros.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMultiThreader.h"
+#include "itkTimeProbe.h"
+
+// Reports the wall time of the DCT for an increasing number of threads on a
+// synthetic volume.  Timings are informational; the test fails only if the
+// threaded result differs from the single threaded one.
+int itkDCTImageFilterScalingTest(int argc, char *argv[])
+{
+
+  if (argc > 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " [size]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const unsigned int Dimension = 3;
+
+  typedef double                                         PixelType;
+  typedef itk::Image< PixelType, Dimension >             ImageType;
+  typedef itk::DCTImageFilter< ImageType >               FilterType;
+  typedef itk::ImageRegionIteratorWithIndex< ImageType > ItType;
+
+  const unsigned int N = (2 == argc) ? atoi(argv[1]) : 96;
+  const unsigned int repeats = 5;
+
+  //////////////////////
+  // Synthetic volume //
+  //////////////////////
+
+  ImageType::Pointer image = ImageType::New();
+  ImageType::SizeType size;
+  size.Fill( N );
+  ImageType::IndexType index;
+  index.Fill( 0 );
+  image->SetRegions( ImageType::RegionType( index, size ) );
+  image->Allocate();
+
+  ItType it( image, image->GetLargestPossibleRegion() );
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+    const ImageType::IndexType idx = it.GetIndex();
+    it.Set( std::sin( 0.1 * idx[0] ) + std::cos( 0.07 * idx[1] ) + 0.01 * idx[2] );
+    }
+
+  /////////////////////////////////
+  // Time each number of threads //
+  /////////////////////////////////
+
+  const itk::ThreadIdType maxThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+
+  ImageType::Pointer reference;
+  double referenceTime = 0.0;
+
+  std::cout << "Volume: " << N << "^3, " << repeats << " transforms per measurement" << std::endl;
+
+  for (itk::ThreadIdType threads = 1; threads <= maxThreads; threads *= 2)
+    {
+
+    FilterType::Pointer dct = FilterType::New();
+    dct->SetNumberOfThreads( threads );
+    dct->SetInput( image );
+    dct->Update(); // Plan outside of the timed region
+
+    itk::TimeProbe probe;
+    for (unsigned int r = 0; r < repeats; ++r)
+      {
+      dct->Modified();
+      probe.Start();
+      dct->Update();
+      probe.Stop();
+      }
+
+    const double time = probe.GetMean();
+    if (1 == threads)
+      {
+      referenceTime = time;
+      reference = dct->GetOutput();
+      reference->DisconnectPipeline();
+      }
+
+    std::cout << "Threads: " << threads
+              << "\tTime: " << time << " s"
+              << "\tSpeedup: " << referenceTime / time << std::endl;
+
+    ItType rit( reference, reference->GetLargestPossibleRegion() );
+    ItType oit( dct->GetOutput(), reference->GetLargestPossibleRegion() );
+    for (rit.GoToBegin(), oit.GoToBegin(); !rit.IsAtEnd(); ++rit, ++oit)
+      {
+      if (std::fabs( rit.Get() - oit.Get() ) <= 10e-8 * (1.0 + std::fabs( rit.Get() ))) continue;
+      std::cerr << "ERROR: Result with " << threads << " threads differs." << std::endl;
+      std::cerr << "Index: " << rit.GetIndex() << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    }
+
+  return EXIT_SUCCESS;
+
+}
@@ -69,7 +69,7 @@ int itkDCTImageFilterTest(int argc, char *argv[])
   ////////////
 
   // Arguments: Object, Class, Superclass
-  EXERCISE_BASIC_OBJECT_METHODS( forward, DCTImageFilter, ImageToImageFilter ); 
+  EXERCISE_BASIC_OBJECT_METHODS( forward, DCTImageFilter, InPlaceImageFilter ); 
 
   /////////////////////
   // Set/Get Methods //
@@ -79,6 +79,18 @@ int itkDCTImageFilterTest(int argc, char *argv[])
   forward->SetTransformDirection( FilterType::Reverse );
   TEST_SET_GET_VALUE( FilterType::Reverse, forward->GetTransformDirection() );  
 
+  TEST_SET_GET_VALUE( true, forward->GetNormalize() );
+  forward->NormalizeOff();
+  TEST_SET_GET_VALUE( false, forward->GetNormalize() );
+  forward->NormalizeOn();
+  TEST_SET_GET_VALUE( false, forward->GetInPlace() );
+
+  TEST_SET_GET_VALUE( itk::DCTBackend::GetPlanRigor(), forward->GetPlanRigor() );
+#if defined(ITK_USE_FFTWD)
+  forward->SetPlanRigor( FFTW_MEASURE );
+  TEST_SET_GET_VALUE( FFTW_MEASURE, forward->GetPlanRigor() );
+#endif
+
   ////////////////
   // Test Image //
   ////////////////
@@ -148,6 +160,150 @@ int itkDCTImageFilterTest(int argc, char *argv[])
     return EXIT_FAILURE;
     }
 
+  /////////////////////////////////////////////////////////////////
+  // In place, unnormalized inverse: scale by NUMPIX*2^Dimension //
+  /////////////////////////////////////////////////////////////////
+
+  FilterType::Pointer inPlace = FilterType::New();
+  inPlace->SetTransformDirection( FilterType::Reverse );
+  inPlace->NormalizeOff();
+  inPlace->InPlaceOn();
+  inPlace->SetInput( forward->GetOutput() );
+  const PixelType * spectrumBuffer = forward->GetOutput()->GetBufferPointer();
+  inPlace->Update();
+
+  if (inPlace->GetOutput()->GetBufferPointer() != spectrumBuffer)
+    {
+    std::cerr << "ERROR: The in-place transform allocated a new buffer." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const double NORM = (3*2)*(4*2);
+  ItType pit(inPlace->GetOutput(), inPlace->GetOutput()->GetLargestPossibleRegion());
+  for (pit.GoToBegin(); !pit.IsAtEnd(); ++pit)
+    {
+    if (same(pit.Get()/NORM,5.)) continue;
+    std::cerr << "ERROR: The unnormalized in-place inverse is incorrect." << std::endl;
+    std::cerr << "Output: " << pit.Get() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+#if defined(ITK_USE_FFTWD)
+  /////////////////////////////////////////////////////////////////
+  // Measured plans must not overwrite the input during planning //
+  /////////////////////////////////////////////////////////////////
+
+  itk::FFTWDCTPlanCache< PixelType >::Clear();
+
+  FilterType::Pointer measured = FilterType::New();
+  measured->SetPlanRigor( FFTW_MEASURE );
+  measured->SetInput( constant );
+  measured->Update();
+
+  ItType cit(constant, constant->GetLargestPossibleRegion());
+  for (cit.GoToBegin(); !cit.IsAtEnd(); ++cit)
+    {
+    if (same(cit.Get(),5.)) continue;
+    std::cerr << "ERROR: The input was modified while planning." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  if (different(measured->GetOutput()->GetPixel(zeroIndex),dc_predicted))
+    {
+    std::cerr << "ERROR: DC component of the measured plan is incorrect." << std::endl;
+    return EXIT_FAILURE;
+    }
+#endif
+
+  ////////////////////////////////////////////////////////////
+  // Batched: each row along the last axis is its own frame //
+  ////////////////////////////////////////////////////////////
+
+  ImageType::Pointer frames = ImageType::New();
+  frames->SetRegions( region );
+  frames->Allocate();
+  ItType bit(frames, region);
+  for (bit.GoToBegin(); !bit.IsAtEnd(); ++bit)
+    {
+    bit.Set( bit.GetIndex()[1] + 1 ); // Frame y is constant, y+1
+    }
+
+  FilterType::Pointer batched = FilterType::New();
+  TEST_SET_GET_VALUE( false, batched->GetBatchAlongLastAxis() );
+  batched->BatchAlongLastAxisOn();
+  TEST_SET_GET_VALUE( true, batched->GetBatchAlongLastAxis() );
+  batched->SetInput( frames );
+  batched->Update();
+
+  // Each frame is a 1D transform of length 3; its DC component is 2*3*(y+1)
+  ItType sit(batched->GetOutput(), region);
+  for (sit.GoToBegin(); !sit.IsAtEnd(); ++sit)
+    {
+    const PixelType predicted = (0 == sit.GetIndex()[0]) ? (3*2)*(sit.GetIndex()[1] + 1) : 0;
+    if (same(sit.Get(),predicted)) continue;
+    std::cerr << "ERROR: The batched transform is incorrect." << std::endl;
+    std::cerr << "Index: " << sit.GetIndex() << std::endl;
+    std::cerr << "Measured: " << sit.Get() << std::endl;
+    std::cerr << "Predicted: " << predicted << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  FilterType::Pointer batchedInverse = FilterType::New();
+  batchedInverse->BatchAlongLastAxisOn();
+  batchedInverse->SetTransformDirection( FilterType::Reverse );
+  batchedInverse->SetInput( batched->GetOutput() );
+  batchedInverse->Update();
+
+  ItType bit2(batchedInverse->GetOutput(), region);
+  for (bit.GoToBegin(), bit2.GoToBegin(); !bit.IsAtEnd(); ++bit, ++bit2)
+    {
+    if (same(bit.Get(),bit2.Get())) continue;
+    std::cerr << "ERROR: The batched round trip is incorrect." << std::endl;
+    std::cerr << "Input: " << bit.Get() << std::endl;
+    std::cerr << "Output: " << bit2.Get() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  /////////////////////////////////////////////////////////////
+  // Single precision images are transformed in single       //
+  // precision, by fftwf or, without it, by BundledDCT       //
+  /////////////////////////////////////////////////////////////
+
+    {
+    typedef itk::Image< float, Dimension >         FloatImageType;
+    typedef itk::DCTImageFilter< FloatImageType >  FloatFilterType;
+    typedef itk::ImageRegionIteratorWithIndex< FloatImageType > FloatItType;
+
+    FloatImageType::Pointer floatConstant = FloatImageType::New();
+    floatConstant->SetRegions( region );
+    floatConstant->Allocate();
+    floatConstant->FillBuffer(5);
+
+    FloatFilterType::Pointer floatForward = FloatFilterType::New();
+    floatForward->SetInput( floatConstant );
+    floatForward->Update();
+
+    if (std::fabs(floatForward->GetOutput()->GetPixel(zeroIndex) - dc_predicted) > 10e-3)
+      {
+      std::cerr << "ERROR: DC component of the float transform is incorrect." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    FloatFilterType::Pointer floatInverse = FloatFilterType::New();
+    floatInverse->SetTransformDirection( FloatFilterType::Reverse );
+    floatInverse->SetInput( floatForward->GetOutput() );
+    floatInverse->Update();
+
+    FloatItType fit(floatInverse->GetOutput(), region);
+    for (fit.GoToBegin(); !fit.IsAtEnd(); ++fit)
+      {
+      if (std::fabs(fit.Get() - 5.0f) < 10e-4) continue;
+      std::cerr << "ERROR: The float round trip is incorrect." << std::endl;
+      std::cerr << "Output: " << fit.Get() << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
   return EXIT_SUCCESS;
 
 }
@@ -0,0 +1,169 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkDCTOutOfCorePoissonSolverImageFilter.h"
+#include "itkDCTPoissonSolverImageFilter.h"
+#include "itkDCTPhaseUnwrappingImageFilter.h"
+#include "itkWrapPhaseSymmetricFunctor.h"
+#include "itkStreamingImageFilter.h"
+#include "itkTestingMacros.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+template< typename TImage >
+static bool Agree( const TImage * a, const TImage * b, const char * name )
+{
+  typedef itk::ImageRegionConstIteratorWithIndex< TImage > ItType;
+  ItType ait( a, a->GetLargestPossibleRegion() );
+  ItType bit( b, a->GetLargestPossibleRegion() );
+  for (ait.GoToBegin(), bit.GoToBegin(); !ait.IsAtEnd(); ++ait, ++bit)
+    {
+    if (std::fabs( ait.Get() - bit.Get() ) <= 10e-8 * (1.0 + std::fabs( ait.Get() ))) continue;
+    std::cerr << "ERROR: The " << name << " differs from the in-core solution." << std::endl;
+    std::cerr << "Index: " << ait.GetIndex() << std::endl;
+    std::cerr << "In core: " << ait.Get() << std::endl;
+    std::cerr << "Out of core: " << bit.Get() << std::endl;
+    return false;
+    }
+  return true;
+}
+
+int itkDCTOutOfCorePoissonSolverImageFilterTest(int argc, char *argv[])
+{
+
+  if (argc != 1)
+    {
+    std::cerr << "Usage: " << argv[0] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////
+  // Typedefs //
+  //////////////
+
+  const unsigned int Dimension = 3;
+
+  typedef double                                                  PixelType;
+  typedef itk::Image< PixelType, Dimension >                      ImageType;
+  typedef itk::DCTOutOfCorePoissonSolverImageFilter< ImageType >  OutOfCoreType;
+  typedef itk::DCTPoissonSolverImageFilter< ImageType >           InCoreType;
+  typedef itk::DCTPhaseUnwrappingImageFilter< ImageType >         UnwrapType;
+  typedef itk::StreamingImageFilter< ImageType, ImageType >       StreamingType;
+  typedef itk::ImageRegionIteratorWithIndex< ImageType >          ItType;
+  typedef itk::Functor::WrapPhaseSymmetricFunctor< PixelType >    WrapType;
+
+  ////////////
+  // Basics //
+  ////////////
+
+  OutOfCoreType::Pointer outOfCore = OutOfCoreType::New();
+
+  EXERCISE_BASIC_OBJECT_METHODS( outOfCore, DCTOutOfCorePoissonSolverImageFilter, ImageToImageFilter );
+
+  TEST_SET_GET_VALUE( static_cast< itk::SizeValueType >( 1024*1024*1024 ), outOfCore->GetMemoryBudget() );
+  TEST_SET_GET_VALUE( false, outOfCore->GetUseImageSpacing() );
+
+  ////////////////
+  // Test Image //
+  ////////////////
+
+  const ImageType::SizeType size = {{20,18,15}};
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( ImageType::RegionType( size ) );
+  image->Allocate();
+
+  ItType it( image, image->GetLargestPossibleRegion() );
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+    const ImageType::IndexType idx = it.GetIndex();
+    it.Set( std::sin( 0.3 * idx[0] ) * std::cos( 0.2 * idx[1] ) + 0.05 * idx[2] );
+    }
+
+  InCoreType::Pointer inCore = InCoreType::New();
+  inCore->SetInput( image );
+  inCore->Update();
+
+  ////////////////////////////////////////////////////////////
+  // A budget of three slices: slabs of 1 slice, many tiles //
+  ////////////////////////////////////////////////////////////
+
+  const itk::SizeValueType slice = size[0] * size[1] * sizeof( PixelType );
+  outOfCore->SetMemoryBudget( 3 * slice );
+  TEST_SET_GET_VALUE( 3 * slice, outOfCore->GetMemoryBudget() );
+  outOfCore->SetInput( image );
+  outOfCore->Update();
+
+  if (!Agree< ImageType >( inCore->GetOutput(), outOfCore->GetOutput(), "out-of-core solution" ))
+    {
+    return EXIT_FAILURE;
+    }
+
+  ///////////////////////////////////////////
+  // Streamed output, with a larger budget //
+  ///////////////////////////////////////////
+
+  OutOfCoreType::Pointer streamedSolver = OutOfCoreType::New();
+  streamedSolver->SetMemoryBudget( 8 * slice );
+  streamedSolver->SetInput( image );
+
+  StreamingType::Pointer streamer = StreamingType::New();
+  streamer->SetNumberOfStreamDivisions( 5 );
+  streamer->SetInput( streamedSolver->GetOutput() );
+  streamer->Update();
+
+  if (!Agree< ImageType >( inCore->GetOutput(), streamer->GetOutput(), "streamed solution" ))
+    {
+    return EXIT_FAILURE;
+    }
+
+  ////////////////////////////////
+  // Out-of-core DCT unwrapping //
+  ////////////////////////////////
+
+  WrapType wrap;
+  ImageType::Pointer wrapped = ImageType::New();
+  wrapped->SetRegions( ImageType::RegionType( size ) );
+  wrapped->Allocate();
+  ItType wit( wrapped, wrapped->GetLargestPossibleRegion() );
+  for (wit.GoToBegin(); !wit.IsAtEnd(); ++wit)
+    {
+    const ImageType::IndexType idx = wit.GetIndex();
+    wit.Set( wrap( 0.5 * idx[0] + 0.3 * idx[1] + 0.2 * idx[2] ) );
+    }
+
+  UnwrapType::Pointer unwrapInCore = UnwrapType::New();
+  unwrapInCore->SetInput( wrapped );
+  unwrapInCore->Update();
+
+  UnwrapType::Pointer unwrapOutOfCore = UnwrapType::New();
+  TEST_SET_GET_VALUE( static_cast< itk::SizeValueType >( 0 ), unwrapOutOfCore->GetMemoryBudget() );
+  unwrapOutOfCore->SetMemoryBudget( 4 * slice );
+  unwrapOutOfCore->SetInput( wrapped );
+
+  StreamingType::Pointer unwrapStreamer = StreamingType::New();
+  unwrapStreamer->SetNumberOfStreamDivisions( 3 );
+  unwrapStreamer->SetInput( unwrapOutOfCore->GetOutput() );
+  unwrapStreamer->Update();
+
+  if (!Agree< ImageType >( unwrapInCore->GetOutput(), unwrapStreamer->GetOutput(), "out-of-core unwrapping" ))
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+
+}
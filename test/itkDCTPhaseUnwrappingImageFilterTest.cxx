@@ -24,6 +24,52 @@
 #include "itkImageFileReader.h"
 #include "itkRescaleIntensityImageFilter.h"
 #include "itkTestingComparisonImageFilter.h"
+#include "itkCommand.h"
+
+namespace
+{
+
+// Records the levels previewed by a progressive unwrap, and stops the
+// refinement at StopLevel
+template< typename TFilter >
+class ProgressiveObserver : public itk::Command
+{
+public:
+  typedef ProgressiveObserver         Self;
+  typedef itk::Command                Superclass;
+  typedef itk::SmartPointer< Self >   Pointer;
+
+  itkNewMacro( Self );
+
+  void Execute( itk::Object * caller, const itk::EventObject & event ) ITK_OVERRIDE
+    {
+    TFilter * filter = dynamic_cast< TFilter * >( caller );
+    if ( !filter || !itk::IterationEvent().CheckEvent( &event ) )
+      {
+      return;
+      }
+    Levels.push_back( filter->GetCurrentLevel() );
+    if ( filter->GetPreview()->GetLargestPossibleRegion() != filter->GetInput()->GetLargestPossibleRegion() )
+      {
+      PreviewsMatchInput = false;
+      }
+    if ( filter->GetCurrentLevel() == StopLevel )
+      {
+      filter->StopRefinement();
+      }
+    }
+
+  void Execute( const itk::Object *, const itk::EventObject & ) ITK_OVERRIDE {}
+
+  std::vector< unsigned int > Levels;
+  bool                        PreviewsMatchInput;
+  unsigned int                StopLevel;
+
+protected:
+  ProgressiveObserver() : PreviewsMatchInput(true), StopLevel(0) {}
+};
+
+}
 
 int itkDCTPhaseUnwrappingImageFilterTest(int argc, char *argv[])
 {
@@ -113,6 +159,390 @@ int itkDCTPhaseUnwrappingImageFilterTest(int argc, char *argv[])
 
     }
 
+  ///////////////////////////
+  // Test Padded Toy Image //
+  ///////////////////////////
+
+    {
+    ImageType::Pointer wrapped = ImageType::New();
+    WrapType wrap;
+
+    // Both extents are prime, so the solve is padded to 12x14
+    const ImageType::IndexType index = {{0,0}};
+    const ImageType::SizeType size = {{11,13}};
+    const ImageType::RegionType region(index,size);
+    wrapped->SetRegions( region );
+    wrapped->Allocate();
+
+    ItType it(wrapped, wrapped->GetLargestPossibleRegion());
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+      it.Set(wrap(it.GetIndex()[0]/2.0 + it.GetIndex()[1]/3.0));
+
+    UnwrapType::Pointer unwrap = UnwrapType::New();
+    TEST_SET_GET_VALUE( false, unwrap->GetPadToEfficientSize() );
+    unwrap->PadToEfficientSizeOn();
+    TEST_SET_GET_VALUE( true, unwrap->GetPadToEfficientSize() );
+    unwrap->SetInput( wrapped );
+    unwrap->Update();
+
+    if (unwrap->GetOutput()->GetLargestPossibleRegion() != region)
+      {
+      std::cerr << "ERROR: The padded solution was not cropped to the input region." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    ImageType::SizeType itSize = {{10,12}};
+    ImageType::RegionType itRegion(index,itSize);
+    ImageType::SizeType itRadius = {{1,1}};
+
+    NItType uit(itRadius, unwrap->GetOutput(), itRegion);
+    unsigned int num_wraps = 0;
+    for (uit.GoToBegin(); !uit.IsAtEnd(); ++uit)
+      {
+      PixelType c = uit.GetCenterPixel();
+      PixelType x = uit.GetNext(0);
+      PixelType y = uit.GetNext(1);
+      if (std::fabs(c-x) < vnl_math::pi && std::fabs(c - y) < vnl_math::pi) continue;
+      ++num_wraps;
+      }
+
+    if (0 < num_wraps)
+      {
+      std::cerr << "ERROR: " << num_wraps << " wraps were found in the padded solution." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    }
+
+  ///////////////////////////////////
+  // Test Batched Series of Frames //
+  ///////////////////////////////////
+
+    {
+    typedef itk::Image< PixelType, Dimension + 1 >              SeriesType;
+    typedef itk::DCTPhaseUnwrappingImageFilter< SeriesType >     SeriesUnwrapType;
+    typedef itk::ImageRegionIteratorWithIndex< SeriesType >      SeriesItType;
+    typedef itk::NeighborhoodIterator< SeriesType >              SeriesNItType;
+
+    // Three 10x10 frames, with ramps of increasing slope
+    SeriesType::Pointer wrapped = SeriesType::New();
+    WrapType wrap;
+
+    const SeriesType::IndexType index = {{0,0,0}};
+    const SeriesType::SizeType size = {{10,10,3}};
+    const SeriesType::RegionType region(index,size);
+    wrapped->SetRegions( region );
+    wrapped->Allocate();
+
+    SeriesItType it(wrapped, region);
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+      it.Set(wrap(it.GetIndex()[0]*(it.GetIndex()[2] + 1)/4.0));
+
+    SeriesUnwrapType::Pointer unwrap = SeriesUnwrapType::New();
+    TEST_SET_GET_VALUE( false, unwrap->GetBatchAlongLastAxis() );
+    unwrap->BatchAlongLastAxisOn();
+    TEST_SET_GET_VALUE( true, unwrap->GetBatchAlongLastAxis() );
+    unwrap->SetInput( wrapped );
+    unwrap->Update();
+
+    // No wraps within any frame
+    const SeriesType::SizeType itSize = {{9,9,3}};
+    const SeriesType::RegionType itRegion(index,itSize);
+    SeriesType::SizeType itRadius;
+    itRadius.Fill(1);
+
+    SeriesNItType uit(itRadius, unwrap->GetOutput(), itRegion);
+    unsigned int num_wraps = 0;
+    for (uit.GoToBegin(); !uit.IsAtEnd(); ++uit)
+      {
+      PixelType c = uit.GetCenterPixel();
+      PixelType x = uit.GetNext(0);
+      PixelType y = uit.GetNext(1);
+      if (std::fabs(c-x) < vnl_math::pi && std::fabs(c - y) < vnl_math::pi) continue;
+      ++num_wraps;
+      }
+
+    if (0 < num_wraps)
+      {
+      std::cerr << "ERROR: " << num_wraps << " wraps were found in the batched series." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    // Each frame matches the unwrapping of that frame alone
+    for (itk::IndexValueType f = 0; f < static_cast< itk::IndexValueType >( size[2] ); ++f)
+      {
+      ImageType::Pointer frame = ImageType::New();
+      const ImageType::SizeType frameSize = {{10,10}};
+      frame->SetRegions( ImageType::RegionType( frameSize ) );
+      frame->Allocate();
+      ItType fit(frame, frame->GetLargestPossibleRegion());
+      for (fit.GoToBegin(); !fit.IsAtEnd(); ++fit)
+        {
+        const SeriesType::IndexType sidx = {{fit.GetIndex()[0], fit.GetIndex()[1], f}};
+        fit.Set( wrapped->GetPixel( sidx ) );
+        }
+
+      UnwrapType::Pointer single = UnwrapType::New();
+      single->SetInput( frame );
+      single->Update();
+
+      // Solutions are defined up to a constant
+      const ImageType::IndexType origin = {{0,0}};
+      const SeriesType::IndexType sorigin = {{0,0,f}};
+      const PixelType offset = single->GetOutput()->GetPixel( origin )
+                             - unwrap->GetOutput()->GetPixel( sorigin );
+      for (fit.GoToBegin(); !fit.IsAtEnd(); ++fit)
+        {
+        const SeriesType::IndexType sidx = {{fit.GetIndex()[0], fit.GetIndex()[1], f}};
+        const PixelType expected = single->GetOutput()->GetPixel( fit.GetIndex() ) - offset;
+        if (std::fabs( unwrap->GetOutput()->GetPixel( sidx ) - expected ) < 10e-6) continue;
+        std::cerr << "ERROR: Frame " << f << " differs from the unbatched solution." << std::endl;
+        std::cerr << "Index: " << fit.GetIndex() << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+
+    }
+
+  ////////////////////////////////
+  // Test Progressive Unwrapping //
+  ////////////////////////////////
+
+    {
+    typedef itk::Image< PixelType, Dimension + 1 >              VolumeType;
+    typedef itk::DCTPhaseUnwrappingImageFilter< VolumeType >     VolumeUnwrapType;
+    typedef itk::ImageRegionIteratorWithIndex< VolumeType >      VolumeItType;
+    typedef ProgressiveObserver< VolumeUnwrapType >              ObserverType;
+
+    VolumeType::Pointer truth = VolumeType::New();
+    VolumeType::Pointer wrapped = VolumeType::New();
+    WrapType wrap;
+
+    const VolumeType::IndexType index = {{0,0,0}};
+    const VolumeType::SizeType size = {{40,36,20}};
+    const VolumeType::RegionType region(index,size);
+    truth->SetRegions( region );
+    truth->Allocate();
+    wrapped->SetRegions( region );
+    wrapped->Allocate();
+
+    VolumeItType tIt(truth, region);
+    VolumeItType wIt(wrapped, region);
+    for (tIt.GoToBegin(), wIt.GoToBegin(); !tIt.IsAtEnd(); ++tIt, ++wIt)
+      {
+      const double x = tIt.GetIndex()[0] - 20.0;
+      const double y = tIt.GetIndex()[1] - 18.0;
+      tIt.Set( 0.01 * ( x * x + y * y ) + 0.2 * tIt.GetIndex()[2] );
+      wIt.Set( wrap( tIt.Get() ) );
+      }
+
+    // Refine through every level
+    VolumeUnwrapType::Pointer unwrap = VolumeUnwrapType::New();
+    TEST_SET_GET_VALUE( 1u, unwrap->GetNumberOfLevels() );
+    unwrap->SetNumberOfLevels( 3 );
+    TEST_SET_GET_VALUE( 3u, unwrap->GetNumberOfLevels() );
+
+    ObserverType::Pointer observer = ObserverType::New();
+    unwrap->AddObserver( itk::IterationEvent(), observer );
+    unwrap->SetInput( wrapped );
+    unwrap->Update();
+
+    if ( observer->Levels.size() != 2 || observer->Levels[0] != 2 || observer->Levels[1] != 1
+         || !observer->PreviewsMatchInput )
+      {
+      std::cerr << "ERROR: The previews were not of levels 2 and 1 at full size." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    // The result is congruent, so it differs from the truth by a constant
+    // multiple of 2 pi
+    const PixelType offset = unwrap->GetOutput()->GetPixel( index ) - truth->GetPixel( index );
+    double maximumError = 0.0;
+    for (tIt.GoToBegin(); !tIt.IsAtEnd(); ++tIt)
+      {
+      const PixelType value = unwrap->GetOutput()->GetPixel( tIt.GetIndex() );
+      maximumError = std::max( maximumError, std::fabs( value - tIt.Get() - offset ) );
+      }
+
+    if ( maximumError > 1e-6 || std::fabs( wrap( offset ) ) > 1e-6 )
+      {
+      std::cerr << "ERROR: The progressive solution differs from the truth by " << maximumError
+                << " beyond an offset of " << offset << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    // Stop at the coarsest preview, which then becomes the output
+    ObserverType::Pointer stopper = ObserverType::New();
+    stopper->StopLevel = 2;
+    VolumeUnwrapType::Pointer preview = VolumeUnwrapType::New();
+    preview->SetNumberOfLevels( 3 );
+    preview->AddObserver( itk::IterationEvent(), stopper );
+    preview->SetInput( wrapped );
+    preview->Update();
+
+    if ( stopper->Levels.size() != 1 || preview->GetOutput()->GetLargestPossibleRegion() != region )
+      {
+      std::cerr << "ERROR: The refinement did not stop at the coarsest level." << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  ////////////////////////////////////
+  // Test Congruent Iterative Unwrap //
+  ////////////////////////////////////
+
+    {
+    ImageType::Pointer wrapped = ImageType::New();
+    WrapType wrap;
+
+    const ImageType::IndexType index = {{0,0}};
+    const ImageType::SizeType size = {{48,40}};
+    const ImageType::RegionType region(index,size);
+    wrapped->SetRegions( region );
+    wrapped->Allocate();
+
+    // A ramp with a patch of noise, whose residues bias the least squares
+    // solution around it
+    unsigned int seed = 7;
+    ItType it(wrapped, region);
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+      {
+      const ImageType::IndexType i = it.GetIndex();
+      PixelType value = 1.2 * i[0] + 0.3 * i[1];
+      if ( i[0] >= 20 && i[0] < 26 && i[1] >= 15 && i[1] < 21 )
+        {
+        seed = 1103515245u * seed + 12345u;
+        value = 2 * vnl_math::pi * ( seed >> 16 ) / 65536.0;
+        }
+      it.Set( wrap( value ) );
+      }
+
+    UnwrapType::Pointer unwrap = UnwrapType::New();
+    TEST_SET_GET_VALUE( 0u, unwrap->GetNumberOfCongruentIterations() );
+    unwrap->SetNumberOfCongruentIterations( 20 );
+    TEST_SET_GET_VALUE( 20u, unwrap->GetNumberOfCongruentIterations() );
+    unwrap->SetChangedPixelsThreshold( 2 );
+    TEST_SET_GET_VALUE( 2u, unwrap->GetChangedPixelsThreshold() );
+    unwrap->SetInput( wrapped );
+    unwrap->Update();
+
+    std::cout << "Congruent iterations: " << unwrap->GetElapsedCongruentIterations()
+              << "\tChanged pixels: " << unwrap->GetNumberOfChangedPixels() << std::endl;
+
+    if ( 0 == unwrap->GetElapsedCongruentIterations()
+         || unwrap->GetElapsedCongruentIterations() > 20
+         || ( unwrap->GetElapsedCongruentIterations() < 20 && unwrap->GetNumberOfChangedPixels() > 2 ) )
+      {
+      std::cerr << "ERROR: The congruent iterations did not stop as expected." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    // The output is congruent, and away from the noise follows the ramp
+    double maximumIncongruence = 0.0;
+    unsigned int num_wraps = 0;
+    ItType uit(unwrap->GetOutput(), region);
+    for (uit.GoToBegin(), it.GoToBegin(); !uit.IsAtEnd(); ++uit, ++it)
+      {
+      maximumIncongruence = std::max( maximumIncongruence, std::fabs( wrap( uit.Get() - it.Get() ) ) );
+      ImageType::IndexType next = uit.GetIndex();
+      ++next[1];
+      if ( next[1] < 40 && ( next[0] < 8 || next[0] > 38 ) )
+        {
+        if ( std::fabs( unwrap->GetOutput()->GetPixel( next ) - uit.Get() - 0.3 ) > 1e-6 )
+          {
+          ++num_wraps;
+          }
+        }
+      }
+
+    if ( maximumIncongruence > 1e-6 || 0 < num_wraps )
+      {
+      std::cerr << "ERROR: The iterative solution is incongruent by " << maximumIncongruence
+                << ", and has " << num_wraps << " wraps away from the noise." << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  ///////////////////////////////////////
+  // Test Float Input and Double Output //
+  ///////////////////////////////////////
+
+    {
+    typedef itk::Image< float, Dimension >                                FloatImageType;
+    typedef itk::DCTPhaseUnwrappingImageFilter< FloatImageType, ImageType > MixedUnwrapType;
+    typedef MixedUnwrapType::MaskImageType                                MaskImageType;
+    typedef itk::ImageRegionIteratorWithIndex< FloatImageType >           FloatItType;
+
+    const ImageType::IndexType index = {{0,0}};
+    const ImageType::SizeType size = {{32,24}};
+    const ImageType::RegionType region(index,size);
+    WrapType wrap;
+
+    ImageType::Pointer wrapped = ImageType::New();
+    wrapped->SetRegions( region );
+    wrapped->Allocate();
+    FloatImageType::Pointer floatWrapped = FloatImageType::New();
+    floatWrapped->SetRegions( region );
+    floatWrapped->Allocate();
+
+    // A bowl, rounded to float before it is unwrapped in double
+    FloatItType fit(floatWrapped, region);
+    ItType dit(wrapped, region);
+    for (fit.GoToBegin(), dit.GoToBegin(); !fit.IsAtEnd(); ++fit, ++dit)
+      {
+      const double x = fit.GetIndex()[0] - 16.0;
+      const double y = fit.GetIndex()[1] - 12.0;
+      fit.Set( static_cast< float >( wrap( 0.05 * ( x * x + y * y ) ) ) );
+      dit.Set( fit.Get() );
+      }
+
+    MaskImageType::Pointer mask = MaskImageType::New();
+    mask->SetRegions( region );
+    mask->Allocate();
+    mask->FillBuffer( 0 );
+    itk::ImageRegionIteratorWithIndex< MaskImageType > mit(mask, region);
+    for (mit.GoToBegin(); !mit.IsAtEnd(); ++mit)
+      {
+      const MaskImageType::IndexType i = mit.GetIndex();
+      mit.Set( ( i[0] >= 4 && i[0] < 28 && i[1] >= 6 && i[1] < 20 ) ? 1 : 0 );
+      }
+
+    // Unmasked, the solution is cast into the output, and masked, it is
+    // pasted into it
+    for (unsigned int masked = 0; masked < 2; ++masked)
+      {
+      UnwrapType::Pointer unwrap = UnwrapType::New();
+      unwrap->SetInput( wrapped );
+      MixedUnwrapType::Pointer mixed = MixedUnwrapType::New();
+      mixed->SetInput( floatWrapped );
+      if ( masked )
+        {
+        unwrap->SetMaskImage( mask );
+        mixed->SetMaskImage( mask );
+        }
+      unwrap->Update();
+      mixed->Update();
+
+      double maximumDifference = 0.0;
+      ItType uit(unwrap->GetOutput(), region);
+      ItType mxit(mixed->GetOutput(), region);
+      for (uit.GoToBegin(), mxit.GoToBegin(); !uit.IsAtEnd(); ++uit, ++mxit)
+        {
+        maximumDifference = std::max( maximumDifference, std::fabs( uit.Get() - mxit.Get() ) );
+        }
+
+      std::cout << "Float to double" << ( masked ? ", masked" : "" )
+                << ":\tMaximum difference from double: " << maximumDifference << std::endl;
+
+      if ( maximumDifference > 1e-3 )
+        {
+        std::cerr << "ERROR: The float to double unwrap differs from the double unwrap by "
+                  << maximumDifference << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
   ////////////////////
   // Test SWI Image //
   ////////////////////
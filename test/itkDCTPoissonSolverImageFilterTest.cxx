@@ -69,6 +69,11 @@ int itkDCTPoissonSolverImageFilterTest(int argc, char *argv[])
 
   EXERCISE_BASIC_OBJECT_METHODS( solver, SolverType ); 
 
+  // The Laplacian below is in physical units
+  TEST_SET_GET_VALUE( false, solver->GetUseImageSpacing() );
+  solver->UseImageSpacingOn();
+  TEST_SET_GET_VALUE( true, solver->GetUseImageSpacing() );
+
   ////////////////
   // Test Image //
   ////////////////
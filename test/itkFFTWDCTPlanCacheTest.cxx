@@ -0,0 +1,145 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkFFTWDCTPlanCache.h"
+#include "itkDCTImageFilter.h"
+#include "itkTestingMacros.h"
+#include "itkImageRegionIterator.h"
+
+int itkFFTWDCTPlanCacheTest(int argc, char *argv[])
+{
+
+  if (argc != 1)
+    {
+    std::cerr << "Usage: " << argv[0] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////
+  // Typedefs //
+  //////////////
+
+  const unsigned int Dimension = 2;
+
+  typedef double                                 PixelType;
+  typedef itk::Image< PixelType, Dimension >     ImageType;
+  typedef itk::DCTImageFilter< ImageType >       FilterType;
+  typedef itk::FFTWDCTPlanCache< PixelType >      CacheType;
+  typedef itk::ImageRegionIterator< ImageType >  ItType;
+
+  CacheType::Clear();
+  TEST_EXPECT_EQUAL( CacheType::GetNumberOfPlans(), 0 );
+
+  ////////////////
+  // Test Image //
+  ////////////////
+
+  ImageType::Pointer image = ImageType::New();
+
+  const ImageType::IndexType index = {{0,0}};
+  const ImageType::SizeType size = {{16,12}};
+  const ImageType::RegionType region(index,size);
+  image->SetRegions( region );
+  image->Allocate();
+
+  ItType it( image, region );
+  PixelType value = 0;
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+    it.Set( value );
+    value += 0.25;
+    }
+
+  /////////////////////////////////////////////////////////////
+  // Repeated requests for one transform share a single plan //
+  /////////////////////////////////////////////////////////////
+
+  const int n[Dimension] = {12, 16};
+  const fftw_r2r_kind kind[Dimension] = {FFTW_REDFT10, FFTW_REDFT10};
+
+  // fftw_malloc guarantees identical alignment for both pairs of arrays.
+  double * in1  = static_cast< double * >( fftw_malloc( sizeof(double) * 12 * 16 ) );
+  double * out1 = static_cast< double * >( fftw_malloc( sizeof(double) * 12 * 16 ) );
+  double * in2  = static_cast< double * >( fftw_malloc( sizeof(double) * 12 * 16 ) );
+  double * out2 = static_cast< double * >( fftw_malloc( sizeof(double) * 12 * 16 ) );
+
+  CacheType::PlanPointer plan1 = CacheType::GetPlan( Dimension, n, kind, in1, out1, FFTW_ESTIMATE );
+  CacheType::PlanPointer plan2 = CacheType::GetPlan( Dimension, n, kind, in2, out2, FFTW_ESTIMATE );
+  CacheType::PlanPointer plan3 = CacheType::GetPlan( Dimension, n, kind, in1, in1, FFTW_ESTIMATE );
+
+  TEST_EXPECT_TRUE( plan1.GetPointer() == plan2.GetPointer() );
+  TEST_EXPECT_TRUE( plan1.GetPointer() != plan3.GetPointer() ); // In-place differs
+  TEST_EXPECT_EQUAL( CacheType::GetNumberOfPlans(), 2 );
+
+  plan1 = ITK_NULLPTR;
+  plan2 = ITK_NULLPTR;
+  plan3 = ITK_NULLPTR;
+
+  fftw_free( in1 );
+  fftw_free( out1 );
+  fftw_free( in2 );
+  fftw_free( out2 );
+
+  //////////////////////////////////////////////////
+  // Results obtained through a cached plan agree //
+  //////////////////////////////////////////////////
+
+  FilterType::Pointer first = FilterType::New();
+  first->SetInput( image );
+  first->Update();
+
+  FilterType::Pointer second = FilterType::New();
+  second->SetInput( image );
+  second->Update();
+
+  ItType fit( first->GetOutput(), region );
+  ItType sit( second->GetOutput(), region );
+  for (fit.GoToBegin(), sit.GoToBegin(); !fit.IsAtEnd(); ++fit, ++sit)
+    {
+    if (fit.Get() == sit.Get()) continue;
+    std::cerr << "ERROR: Cached plan produced a different result." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ///////////////////////////////
+  // The cache can be bounded. //
+  ///////////////////////////////
+
+  CacheType::SetMaximumNumberOfPlans( 1 );
+  TEST_EXPECT_EQUAL( CacheType::GetMaximumNumberOfPlans(), 1 );
+  TEST_EXPECT_TRUE( CacheType::GetNumberOfPlans() <= 1 );
+
+  FilterType::Pointer inverse = FilterType::New();
+  inverse->SetTransformDirection( FilterType::Reverse );
+  inverse->SetInput( first->GetOutput() );
+  inverse->Update();
+
+  TEST_EXPECT_EQUAL( CacheType::GetNumberOfPlans(), 1 );
+
+  ///////////////////////////////
+  // The cache can be cleared. //
+  ///////////////////////////////
+
+  CacheType::Clear();
+  TEST_EXPECT_EQUAL( CacheType::GetNumberOfPlans(), 0 );
+
+  CacheType::SetMaximumNumberOfPlans( 32 );
+
+  return EXIT_SUCCESS;
+
+}
@@ -17,7 +17,10 @@
  *=========================================================================*/
 
 #include "itkHelmholtzDecompositionImageFilter.h"
+#include "itkDCTPhaseUnwrappingImageFilter.h"
 #include "itkTestingMacros.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkWrapPhaseSymmetricFunctor.h"
 
 int itkHelmholtzDecompositionImageFilterTest(int argc, char *argv[])
 {
@@ -33,15 +36,85 @@ int itkHelmholtzDecompositionImageFilterTest(int argc, char *argv[])
 
   typedef itk::Image< PixelType, Dimension > ImageType;
 
-  typedef itk::HelmholtzDecompositionImageFilter< ImageType > FilterType;
+  typedef itk::HelmholtzDecompositionImageFilter< ImageType >    FilterType;
+  typedef itk::DCTPhaseUnwrappingImageFilter< ImageType >        UnwrapType;
+  typedef itk::ImageRegionIteratorWithIndex< ImageType >         ItType;
+  typedef itk::Functor::WrapPhaseSymmetricFunctor< PixelType >   WrapType;
+
+  WrapType wrap;
+
+  ////////////////////////////////
+  // A Bowl with a Vortex Pair  //
+  ////////////////////////////////
+
+  const ImageType::IndexType index = {{0,0}};
+  const ImageType::SizeType size = {{53,47}};
+  const ImageType::RegionType region(index,size);
+
+  ImageType::Pointer wrapped = ImageType::New();
+  wrapped->SetRegions( region );
+  wrapped->Allocate();
+
+  ItType wIt(wrapped, region);
+  for (wIt.GoToBegin(); !wIt.IsAtEnd(); ++wIt)
+    {
+    const ImageType::IndexType i = wIt.GetIndex();
+    const double x = i[0] - 26.3;
+    const double y = i[1] - 23.7;
+    wIt.Set( wrap( 0.01 * ( x * x + y * y )
+                   + std::atan2( y, x - 8.0 ) - std::atan2( y, x + 8.0 ) ) );
+    }
 
   FilterType::Pointer filter = FilterType::New();
+  filter->SetInput( wrapped );
+  filter->Update();
+
+  ////////////////////////////////////
+  // Compare to the Separate Passes //
+  ////////////////////////////////////
+
+  // The irrotational component is the wrapped unwrapping solution, and the
+  // rotational is the wrapped remainder
+  UnwrapType::Pointer unwrap = UnwrapType::New();
+  unwrap->SetInput( wrapped );
+  unwrap->Update();
+
+  double maximumDifference = 0.0;
+  ItType uIt(unwrap->GetOutput(), region);
+  ItType iIt(filter->GetIrrotational(), region);
+  ItType rIt(filter->GetRotational(), region);
+  for (wIt.GoToBegin(), uIt.GoToBegin(), iIt.GoToBegin(), rIt.GoToBegin();
+       !wIt.IsAtEnd();
+       ++wIt, ++uIt, ++iIt, ++rIt)
+    {
+    const PixelType irrotational = wrap( uIt.Get() );
+    const PixelType rotational = wrap( wIt.Get() - irrotational );
+    maximumDifference = std::max( maximumDifference, std::fabs( iIt.Get() - irrotational ) );
+    maximumDifference = std::max( maximumDifference, std::fabs( rIt.Get() - rotational ) );
+    }
+
+  if (maximumDifference > 1e-12)
+    {
+    std::cerr << "ERROR: The decomposition differs from the separate passes by "
+              << maximumDifference << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  if (filter->GetRotational()->GetBufferPointer() == filter->GetIrrotational()->GetBufferPointer())
+    {
+    std::cerr << "ERROR: The outputs share a buffer." << std::endl;
+    return EXIT_FAILURE;
+    }
 
   ////////////
   // Basics //
   ////////////
 
-  EXERCISE_BASIC_OBJECT_METHODS( filter, FilterType ); 
+  EXERCISE_BASIC_OBJECT_METHODS( filter,
+                                 HelmholtzDecompositionImageFilter,
+                                 PhaseImageToImageFilter );
+
+  TEST_SET_GET_VALUE( UnwrapType::DCTSolver, filter->GetPoissonSolver() );
 
   return EXIT_SUCCESS;
 
@@ -0,0 +1,212 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkLaplacianPhaseUnwrappingImageFilter.h"
+#include "itkTestingMacros.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkNeighborhoodIterator.h"
+#include "itkWrapPhaseSymmetricFunctor.h"
+
+int itkLaplacianPhaseUnwrappingImageFilterTest(int argc, char *argv[])
+{
+
+  if (argc != 1)
+    {
+    std::cerr << "Usage: " << argv[0] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////
+  // Typedefs //
+  //////////////
+
+  typedef double                                                  PixelType;
+  typedef itk::Image< PixelType, 2 >                              ImageType;
+  typedef itk::Image< PixelType, 3 >                              VolumeType;
+  typedef itk::LaplacianPhaseUnwrappingImageFilter< ImageType >   UnwrapType;
+  typedef itk::LaplacianPhaseUnwrappingImageFilter< VolumeType >  VolumeUnwrapType;
+  typedef itk::ImageRegionIteratorWithIndex< ImageType >          ItType;
+  typedef itk::ImageRegionIteratorWithIndex< VolumeType >         VolumeItType;
+  typedef itk::NeighborhoodIterator< VolumeType >                 VolumeNItType;
+  typedef itk::Functor::WrapPhaseSymmetricFunctor< PixelType >    WrapType;
+
+  WrapType wrap;
+
+  ///////////////////////////////
+  // Smooth Volume, No Wraps   //
+  ///////////////////////////////
+
+  const VolumeType::IndexType index = {{0,0,0}};
+  const VolumeType::SizeType size = {{48,40,12}};
+  const VolumeType::RegionType region(index,size);
+
+  VolumeType::Pointer truth = VolumeType::New();
+  VolumeType::Pointer wrapped = VolumeType::New();
+  truth->SetRegions( region );
+  truth->Allocate();
+  wrapped->SetRegions( region );
+  wrapped->Allocate();
+
+  // A bowl spanning several cycles, with small gradients everywhere
+  VolumeItType tIt(truth, region);
+  VolumeItType wIt(wrapped, region);
+  for (tIt.GoToBegin(), wIt.GoToBegin(); !tIt.IsAtEnd(); ++tIt, ++wIt)
+    {
+    const VolumeType::IndexType i = tIt.GetIndex();
+    const double x = i[0] - 24.0;
+    const double y = i[1] - 20.0;
+    const PixelType value = 0.004 * ( x * x + y * y ) + 0.1 * i[2];
+    tIt.Set( value );
+    wIt.Set( wrap( value ) );
+    }
+
+  VolumeUnwrapType::Pointer unwrap = VolumeUnwrapType::New();
+  unwrap->SetInput( wrapped );
+  unwrap->Update();
+
+  if (unwrap->GetOutput()->GetLargestPossibleRegion() != region)
+    {
+    std::cerr << "ERROR: The output region differs from the input region." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  VolumeType::SizeType itSize = size;
+  for (unsigned int d = 0; d < 3; ++d)
+    {
+    itSize[d] -= 1;
+    }
+  const VolumeType::SizeType radius = {{1,1,1}};
+
+  VolumeNItType uit(radius, unwrap->GetOutput(), VolumeType::RegionType(index,itSize));
+  unsigned int numberOfWraps = 0;
+  for (uit.GoToBegin(); !uit.IsAtEnd(); ++uit)
+    {
+    const PixelType c = uit.GetCenterPixel();
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      if (std::fabs( c - uit.GetNext(d) ) >= vnl_math::pi)
+        {
+        ++numberOfWraps;
+        }
+      }
+    }
+
+  if (0 < numberOfWraps)
+    {
+    std::cerr << "ERROR: " << numberOfWraps << " wraps were found." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // sin(d) underestimates the larger differences slightly, so require only
+  // that the solution is strongly correlated with the truth
+  double sum[2] = { 0.0, 0.0 };
+  double sumSquares[2] = { 0.0, 0.0 };
+  double sumProducts = 0.0;
+  VolumeItType uIt(unwrap->GetOutput(), region);
+  for (uIt.GoToBegin(), tIt.GoToBegin(); !uIt.IsAtEnd(); ++uIt, ++tIt)
+    {
+    sum[0] += uIt.Get();
+    sum[1] += tIt.Get();
+    sumSquares[0] += uIt.Get() * uIt.Get();
+    sumSquares[1] += tIt.Get() * tIt.Get();
+    sumProducts += uIt.Get() * tIt.Get();
+    }
+  const double n = region.GetNumberOfPixels();
+  const double correlation = ( sumProducts - sum[0] * sum[1] / n )
+    / std::sqrt( ( sumSquares[0] - sum[0] * sum[0] / n ) * ( sumSquares[1] - sum[1] * sum[1] / n ) );
+
+  if (!(correlation > 0.99))
+    {
+    std::cerr << "ERROR: The unwrapped phase disagrees with the truth." << std::endl;
+    std::cerr << "Correlation: " << correlation << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ///////////////////////////////////
+  // Batched Frames Match 2D Solve //
+  ///////////////////////////////////
+
+    {
+    VolumeUnwrapType::Pointer batch = VolumeUnwrapType::New();
+    TEST_SET_GET_VALUE( false, batch->GetBatchAlongLastAxis() );
+    batch->BatchAlongLastAxisOn();
+    TEST_SET_GET_VALUE( true, batch->GetBatchAlongLastAxis() );
+    batch->SetInput( wrapped );
+    batch->Update();
+
+    const ImageType::IndexType sliceIndex = {{0,0}};
+    const ImageType::SizeType sliceSize = {{size[0],size[1]}};
+    const ImageType::RegionType sliceRegion(sliceIndex,sliceSize);
+
+    const VolumeType::IndexValueType frames[2] = { 0, 11 };
+    for (unsigned int f = 0; f < 2; ++f)
+      {
+
+      ImageType::Pointer slice = ImageType::New();
+      slice->SetRegions( sliceRegion );
+      slice->Allocate();
+
+      ItType sIt(slice, sliceRegion);
+      for (sIt.GoToBegin(); !sIt.IsAtEnd(); ++sIt)
+        {
+        const VolumeType::IndexType i = {{sIt.GetIndex()[0],sIt.GetIndex()[1],frames[f]}};
+        sIt.Set( wrapped->GetPixel( i ) );
+        }
+
+      UnwrapType::Pointer sliceUnwrap = UnwrapType::New();
+      sliceUnwrap->SetInput( slice );
+      sliceUnwrap->Update();
+
+      double maximumDifference = 0.0;
+      ItType oIt(sliceUnwrap->GetOutput(), sliceRegion);
+      for (oIt.GoToBegin(); !oIt.IsAtEnd(); ++oIt)
+        {
+        const VolumeType::IndexType i = {{oIt.GetIndex()[0],oIt.GetIndex()[1],frames[f]}};
+        maximumDifference = std::max( maximumDifference,
+                                      std::fabs( oIt.Get() - batch->GetOutput()->GetPixel( i ) ) );
+        }
+
+      if (maximumDifference > 1e-8)
+        {
+        std::cerr << "ERROR: Frame " << frames[f] << " of the batch differs from its 2D solve by "
+                  << maximumDifference << std::endl;
+        return EXIT_FAILURE;
+        }
+
+      }
+    }
+
+  ////////////
+  // Basics //
+  ////////////
+
+  EXERCISE_BASIC_OBJECT_METHODS( unwrap,
+                                 LaplacianPhaseUnwrappingImageFilter,
+                                 PhaseImageToImageFilter );
+
+  /////////////////////
+  // Set/Get Methods //
+  /////////////////////
+
+  TEST_SET_GET_VALUE( false, unwrap->GetPadToEfficientSize() );
+  unwrap->PadToEfficientSizeOn();
+  TEST_SET_GET_VALUE( true, unwrap->GetPadToEfficientSize() );
+
+  return EXIT_SUCCESS;
+
+}
@@ -0,0 +1,238 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkMultigridPhaseUnwrappingImageFilter.h"
+#include "itkTestingMacros.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkWrapPhaseSymmetricFunctor.h"
+
+int itkMultigridPhaseUnwrappingImageFilterTest(int argc, char *argv[])
+{
+
+  if (argc != 1)
+    {
+    std::cerr << "Usage: " << argv[0] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////
+  // Typedefs //
+  //////////////
+
+  typedef double                                                 PixelType;
+  typedef itk::Image< PixelType, 2 >                             ImageType;
+  typedef itk::Image< PixelType, 3 >                             VolumeType;
+  typedef itk::MultigridPhaseUnwrappingImageFilter< ImageType >  UnwrapType;
+  typedef itk::MultigridPhaseUnwrappingImageFilter< VolumeType > VolumeUnwrapType;
+  typedef itk::ImageRegionIteratorWithIndex< ImageType >         ItType;
+  typedef itk::ImageRegionIteratorWithIndex< VolumeType >        VolumeItType;
+  typedef itk::Functor::WrapPhaseSymmetricFunctor< PixelType >   WrapType;
+
+  WrapType wrap;
+
+  /////////////////////////////////////
+  // Recover a Ramp with Every Cycle //
+  /////////////////////////////////////
+
+    {
+    // Odd extents, so that the last coarse cells have a single child
+    ImageType::Pointer truth = ImageType::New();
+    ImageType::Pointer wrapped = ImageType::New();
+
+    const ImageType::IndexType index = {{0,0}};
+    const ImageType::SizeType size = {{37,29}};
+    const ImageType::RegionType region(index,size);
+    truth->SetRegions( region );
+    truth->Allocate();
+    wrapped->SetRegions( region );
+    wrapped->Allocate();
+
+    double mean = 0.0;
+    ItType tIt(truth, region);
+    ItType wIt(wrapped, region);
+    for (tIt.GoToBegin(), wIt.GoToBegin(); !tIt.IsAtEnd(); ++tIt, ++wIt)
+      {
+      const PixelType value = tIt.GetIndex()[0]/2.0 + tIt.GetIndex()[1]/3.0;
+      tIt.Set( value );
+      wIt.Set( wrap( value ) );
+      mean += value;
+      }
+    mean /= region.GetNumberOfPixels();
+
+    const UnwrapType::CycleEnumType cycles[3] = { UnwrapType::VCycle, UnwrapType::WCycle, UnwrapType::FullMultigrid };
+
+    for (unsigned int c = 0; c < 3; ++c)
+      {
+
+      UnwrapType::Pointer unwrap = UnwrapType::New();
+      unwrap->SetInput( wrapped );
+      unwrap->WeightedOff();
+      unwrap->SetCycleType( cycles[c] );
+      unwrap->SetTolerance( 1e-8 );
+      unwrap->SetNumberOfCycles( 40 );
+      unwrap->Update();
+
+      if (unwrap->GetRelativeResidual() > unwrap->GetTolerance())
+        {
+        std::cerr << "ERROR: Cycle " << cycles[c] << " stopped at a relative residual of "
+                  << unwrap->GetRelativeResidual() << " after "
+                  << unwrap->GetElapsedCycles() << " cycles." << std::endl;
+        return EXIT_FAILURE;
+        }
+
+      double maximumError = 0.0;
+      ItType uIt(unwrap->GetOutput(), region);
+      for (uIt.GoToBegin(), tIt.GoToBegin(); !uIt.IsAtEnd(); ++uIt, ++tIt)
+        {
+        maximumError = std::max( maximumError, std::fabs( uIt.Get() - ( tIt.Get() - mean ) ) );
+        }
+
+      if (maximumError > 1e-4)
+        {
+        std::cerr << "ERROR: Cycle " << cycles[c] << " differs from the ramp by "
+                  << maximumError << std::endl;
+        return EXIT_FAILURE;
+        }
+
+      }
+
+    }
+
+  ///////////////////////////////
+  // Weighted, Noisy Toy Image //
+  ///////////////////////////////
+
+    {
+    ImageType::Pointer wrapped = ImageType::New();
+
+    const ImageType::IndexType index = {{0,0}};
+    const ImageType::SizeType size = {{32,32}};
+    const ImageType::RegionType region(index,size);
+    wrapped->SetRegions( region );
+    wrapped->Allocate();
+
+    // A ramp with a little deterministic noise, so that the quality varies
+    ItType it(wrapped, region);
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+      {
+      const ImageType::IndexType i = it.GetIndex();
+      const double noise = 0.3 * std::sin( 12.9898 * i[0] + 78.233 * i[1] );
+      it.Set( wrap( i[0]/2.0 + noise ) );
+      }
+
+    UnwrapType::Pointer unwrap = UnwrapType::New();
+    unwrap->SetInput( wrapped );
+    unwrap->SetNumberOfCycles( 50 );
+    unwrap->Update();
+
+    // Pixels of zero quality are undetermined, so only the residual is checked
+    if (unwrap->GetRelativeResidual() > unwrap->GetTolerance())
+      {
+      std::cerr << "ERROR: The weighted solve stopped at a relative residual of "
+                << unwrap->GetRelativeResidual() << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    if (unwrap->GetElapsedCycles() >= unwrap->GetNumberOfCycles())
+      {
+      std::cerr << "ERROR: The weighted solve did not stop early." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    ////////////
+    // Basics //
+    ////////////
+
+    EXERCISE_BASIC_OBJECT_METHODS( unwrap,
+                                   MultigridPhaseUnwrappingImageFilter,
+                                   PhaseImageToImageFilter );
+
+    /////////////////////
+    // Set/Get Methods //
+    /////////////////////
+
+    unwrap = UnwrapType::New();
+    TEST_SET_GET_VALUE( UnwrapType::VCycle, unwrap->GetCycleType() );
+    unwrap->SetCycleType( UnwrapType::WCycle );
+    TEST_SET_GET_VALUE( UnwrapType::WCycle, unwrap->GetCycleType() );
+    TEST_SET_GET_VALUE( true, unwrap->GetWeighted() );
+    unwrap->WeightedOff();
+    TEST_SET_GET_VALUE( false, unwrap->GetWeighted() );
+    TEST_SET_GET_VALUE( 2u, unwrap->GetNumberOfPreSmoothingIterations() );
+    unwrap->SetNumberOfPreSmoothingIterations( 3 );
+    TEST_SET_GET_VALUE( 3u, unwrap->GetNumberOfPreSmoothingIterations() );
+    TEST_SET_GET_VALUE( 0u, unwrap->GetMaximumNumberOfLevels() );
+    unwrap->SetMaximumNumberOfLevels( 2 );
+    TEST_SET_GET_VALUE( 2u, unwrap->GetMaximumNumberOfLevels() );
+
+    }
+
+  //////////////////////////////////
+  // Anisotropic Volume, 3 Levels //
+  //////////////////////////////////
+
+    {
+    VolumeType::Pointer wrapped = VolumeType::New();
+
+    // The short last axis stops being coarsened before the others
+    const VolumeType::IndexType index = {{0,0,0}};
+    const VolumeType::SizeType size = {{24,20,3}};
+    const VolumeType::RegionType region(index,size);
+    wrapped->SetRegions( region );
+    wrapped->Allocate();
+
+    double mean = 0.0;
+    VolumeItType it(wrapped, region);
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+      {
+      const VolumeType::IndexType i = it.GetIndex();
+      const double value = i[0]/2.0 + i[1]/4.0 + i[2];
+      it.Set( wrap( value ) );
+      mean += value;
+      }
+    mean /= region.GetNumberOfPixels();
+
+    VolumeUnwrapType::Pointer unwrap = VolumeUnwrapType::New();
+    unwrap->SetInput( wrapped );
+    unwrap->WeightedOff();
+    unwrap->SetMaximumNumberOfLevels( 3 );
+    unwrap->SetTolerance( 1e-8 );
+    unwrap->SetNumberOfCycles( 60 );
+    unwrap->Update();
+
+    double maximumError = 0.0;
+    VolumeItType uIt(unwrap->GetOutput(), region);
+    for (uIt.GoToBegin(); !uIt.IsAtEnd(); ++uIt)
+      {
+      const VolumeType::IndexType i = uIt.GetIndex();
+      const double value = i[0]/2.0 + i[1]/4.0 + i[2] - mean;
+      maximumError = std::max( maximumError, std::fabs( uIt.Get() - value ) );
+      }
+
+    if (maximumError > 1e-4)
+      {
+      std::cerr << "ERROR: The volume differs from the ramp by " << maximumError
+                << " after " << unwrap->GetElapsedCycles() << " cycles." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    }
+
+  return EXIT_SUCCESS;
+
+}
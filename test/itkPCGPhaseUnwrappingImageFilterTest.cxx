@@ -0,0 +1,586 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkPCGPhaseUnwrappingImageFilter.h"
+#include "itkWrappedPhaseLaplacianImageFilter.h"
+#include "itkTestingMacros.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkWrapPhaseSymmetricFunctor.h"
+#include "itkCommand.h"
+
+namespace
+{
+
+// Records what a PCG unwrap reports at each IterationEvent
+template< typename TFilter >
+class IterationObserver : public itk::Command
+{
+public:
+  typedef IterationObserver           Self;
+  typedef itk::Command                Superclass;
+  typedef itk::SmartPointer< Self >   Pointer;
+
+  itkNewMacro( Self );
+
+  void Execute( itk::Object * caller, const itk::EventObject & event ) ITK_OVERRIDE
+    {
+    this->Execute( static_cast< const itk::Object * >( caller ), event );
+    }
+
+  void Execute( const itk::Object * caller, const itk::EventObject & event ) ITK_OVERRIDE
+    {
+    const TFilter * filter = dynamic_cast< const TFilter * >( caller );
+    if ( !filter || !itk::IterationEvent().CheckEvent( &event ) )
+      {
+      return;
+      }
+    Iterations.push_back( filter->GetElapsedIterations() );
+    Residuals.push_back( filter->GetRelativeResidual() );
+    Times.push_back( filter->GetElapsedTime() );
+    if ( !( filter->GetAlpha() > 0 ) || !( filter->GetBeta() > 0 ) )
+      {
+      StepsPositive = false;
+      }
+    }
+
+  std::vector< unsigned int > Iterations;
+  std::vector< double >       Residuals;
+  std::vector< double >       Times;
+  bool                        StepsPositive;
+
+protected:
+  IterationObserver() : StepsPositive(true) {}
+};
+
+}
+
+int itkPCGPhaseUnwrappingImageFilterTest(int argc, char *argv[])
+{
+
+  if (argc != 1)
+    {
+    std::cerr << "Usage: " << argv[0] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////
+  // Typedefs //
+  //////////////
+
+  typedef double                                                 PixelType;
+  typedef itk::Image< PixelType, 2 >                             ImageType;
+  typedef itk::PCGPhaseUnwrappingImageFilter< ImageType >        UnwrapType;
+  typedef itk::ImageRegionIteratorWithIndex< ImageType >         ItType;
+  typedef itk::Functor::WrapPhaseSymmetricFunctor< PixelType >   WrapType;
+
+  WrapType wrap;
+
+  ///////////////////////////////////
+  // A Bowl on a Ramp              //
+  ///////////////////////////////////
+
+  const ImageType::IndexType index = {{0,0}};
+  const ImageType::SizeType size = {{72,60}};
+  const ImageType::RegionType region(index,size);
+
+  ImageType::Pointer wrapped = ImageType::New();
+  wrapped->SetRegions( region );
+  wrapped->Allocate();
+
+  ItType wIt(wrapped, region);
+  for (wIt.GoToBegin(); !wIt.IsAtEnd(); ++wIt)
+    {
+    const ImageType::IndexType i = wIt.GetIndex();
+    const double x = i[0] - 36.0;
+    const double y = i[1] - 30.0;
+    wIt.Set( wrap( 0.005 * ( x * x + y * y ) + i[1] / 5.0 ) );
+    }
+
+  typedef IterationObserver< UnwrapType > ObserverType;
+  ObserverType::Pointer observer = ObserverType::New();
+
+  UnwrapType::Pointer unwrap = UnwrapType::New();
+  unwrap->SetMaximumIterations( 50 );
+  unwrap->SetInput( wrapped );
+  unwrap->AddObserver( itk::IterationEvent(), observer );
+  unwrap->Update();
+
+  std::cout << "Double:\tIterations: " << unwrap->GetElapsedIterations()
+            << "\tRelative residual: " << unwrap->GetRelativeResidual() << std::endl;
+
+  if ( 0 == unwrap->GetElapsedIterations() || unwrap->GetElapsedIterations() > 50 )
+    {
+    std::cerr << "ERROR: " << unwrap->GetElapsedIterations() << " iterations were reported." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ////////////////////////
+  // Iteration Events   //
+  ////////////////////////
+
+    {
+    const UnwrapType::ConvergenceHistoryType & history = unwrap->GetConvergenceHistory();
+    bool matches = observer->StepsPositive
+      && observer->Iterations.size() == unwrap->GetElapsedIterations()
+      && history.size() == unwrap->GetElapsedIterations()
+      && history.back() == unwrap->GetRelativeResidual();
+    for (unsigned int i = 0; matches && i < observer->Iterations.size(); ++i)
+      {
+      matches = observer->Iterations[i] == i + 1
+        && observer->Residuals[i] == history[i]
+        && ( 0 == i || observer->Times[i] >= observer->Times[i-1] );
+      }
+
+    std::cout << "Events:\t" << observer->Iterations.size()
+              << "\tElapsed time: " << unwrap->GetElapsedTime() << " s" << std::endl;
+
+    if ( !matches )
+      {
+      std::cerr << "ERROR: The iteration events do not match the convergence history." << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  //////////////////////////////////////
+  // Same Solution at Any Thread Count //
+  //////////////////////////////////////
+
+    {
+    // FFTW may choose other algorithms for other thread counts, so the
+    // preconditioner uses the bundled DCT, which transforms each line alike
+    const itk::DCTBackend::BackendEnumType backend = itk::DCTBackend::GetBackend();
+    itk::DCTBackend::SetBackend( itk::DCTBackend::Bundled );
+
+    UnwrapType::Pointer serial = UnwrapType::New();
+    serial->SetMaximumIterations( 50 );
+    serial->SetNumberOfThreads( 1 );
+    serial->SetInput( wrapped );
+    serial->Update();
+
+    UnwrapType::Pointer threaded = UnwrapType::New();
+    threaded->SetMaximumIterations( 50 );
+    threaded->SetNumberOfThreads( 5 );
+    threaded->SetInput( wrapped );
+    threaded->Update();
+
+    itk::DCTBackend::SetBackend( backend );
+
+    unsigned int numberOfDifferences = 0;
+    ItType sIt(serial->GetOutput(), region);
+    ItType tIt(threaded->GetOutput(), region);
+    for (sIt.GoToBegin(), tIt.GoToBegin(); !sIt.IsAtEnd(); ++sIt, ++tIt)
+      {
+      if ( sIt.Get() != tIt.Get() )
+        {
+        ++numberOfDifferences;
+        }
+      }
+
+    if ( 0 < numberOfDifferences
+         || serial->GetElapsedIterations() != threaded->GetElapsedIterations() )
+      {
+      std::cerr << "ERROR: The solution depends on the number of threads ("
+                << numberOfDifferences << " pixels differ)." << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  ////////////////////////////////
+  // The Solution Is the Phase  //
+  ////////////////////////////////
+
+    {
+    // The bowl has no residues, so the solve recovers the phase up to a
+    // constant, not its negative
+    UnwrapType::Pointer converged = UnwrapType::New();
+    converged->SetMaximumIterations( 500 );
+    converged->SetInput( wrapped );
+    converged->Update();
+
+    double truthMean = 0.0;
+    ItType cIt(converged->GetOutput(), region);
+    for (cIt.GoToBegin(); !cIt.IsAtEnd(); ++cIt)
+      {
+      const ImageType::IndexType i = cIt.GetIndex();
+      const double x = i[0] - 36.0;
+      const double y = i[1] - 30.0;
+      truthMean += 0.005 * ( x * x + y * y ) + i[1] / 5.0;
+      }
+    truthMean /= region.GetNumberOfPixels();
+
+    double maximumError = 0.0;
+    for (cIt.GoToBegin(); !cIt.IsAtEnd(); ++cIt)
+      {
+      const ImageType::IndexType i = cIt.GetIndex();
+      const double x = i[0] - 36.0;
+      const double y = i[1] - 30.0;
+      const double phase = 0.005 * ( x * x + y * y ) + i[1] / 5.0;
+      maximumError = std::max( maximumError, std::fabs( cIt.Get() - ( phase - truthMean ) ) );
+      }
+
+    std::cout << "Phase:\tIterations: " << converged->GetElapsedIterations()
+              << "\tMaximum error: " << maximumError << std::endl;
+
+    if ( maximumError > 0.5 )
+      {
+      std::cerr << "ERROR: The solution is off the phase by up to " << maximumError << "." << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  ////////////////////////////////////////
+  // Warm Start on a Slowly Varying Series //
+  ////////////////////////////////////////
+
+    {
+    // The bowl deepens by 1% a frame.  Each frame is solved from zero, and
+    // from the solution of the previous frame.
+    const unsigned int numberOfFrames = 5;
+    const unsigned int maximumIterations = 500;
+
+    ImageType::Pointer previous;
+    ImageType::Pointer frame;
+    unsigned int coldIterations = 0;
+    unsigned int warmIterations = 0;
+    double maximumError = 0.0;
+
+    for (unsigned int k = 0; k < numberOfFrames; ++k)
+      {
+
+      frame = ImageType::New();
+      frame->SetRegions( region );
+      frame->Allocate();
+
+      ImageType::Pointer truth = ImageType::New();
+      truth->SetRegions( region );
+      truth->Allocate();
+
+      double truthMean = 0.0;
+      ItType fIt(frame, region);
+      ItType tIt(truth, region);
+      for (fIt.GoToBegin(), tIt.GoToBegin(); !fIt.IsAtEnd(); ++fIt, ++tIt)
+        {
+        const ImageType::IndexType i = fIt.GetIndex();
+        const double x = i[0] - 36.0;
+        const double y = i[1] - 30.0;
+        const double phase = 0.005 * ( 1.0 + 0.01 * k ) * ( x * x + y * y ) + i[1] / 5.0;
+        fIt.Set( wrap( phase ) );
+        tIt.Set( phase );
+        truthMean += phase;
+        }
+      truthMean /= region.GetNumberOfPixels();
+
+      UnwrapType::Pointer cold = UnwrapType::New();
+      cold->SetMaximumIterations( maximumIterations );
+      cold->SetInput( frame );
+      cold->Update();
+
+      // The solution has zero mean
+      ItType cIt(cold->GetOutput(), region);
+      for (cIt.GoToBegin(), tIt.GoToBegin(); !cIt.IsAtEnd(); ++cIt, ++tIt)
+        {
+        maximumError = std::max( maximumError, std::fabs( cIt.Get() - ( tIt.Get() - truthMean ) ) );
+        }
+
+      if ( previous )
+        {
+        UnwrapType::Pointer warm = UnwrapType::New();
+        warm->SetMaximumIterations( maximumIterations );
+        warm->SetInput( frame );
+        warm->SetInitialSolution( previous );
+        warm->Update();
+
+        TEST_SET_GET_VALUE( previous.GetPointer(), warm->GetInitialSolution() );
+
+        std::cout << "Frame " << k << ":\tCold iterations: " << cold->GetElapsedIterations()
+                  << "\tWarm iterations: " << warm->GetElapsedIterations() << std::endl;
+
+        coldIterations += cold->GetElapsedIterations();
+        warmIterations += warm->GetElapsedIterations();
+
+        previous = warm->GetOutput();
+        previous->DisconnectPipeline();
+        }
+      else
+        {
+        previous = cold->GetOutput();
+        previous->DisconnectPipeline();
+        }
+
+      }
+
+    std::cout << "Warm start:\t" << warmIterations << " of " << coldIterations
+              << " iterations\tMaximum error: " << maximumError << std::endl;
+
+    if ( warmIterations >= coldIterations )
+      {
+      std::cerr << "ERROR: Warm starts took " << warmIterations << " iterations, and cold starts "
+                << coldIterations << "." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    if ( maximumError > 0.5 )
+      {
+      std::cerr << "ERROR: The solution is off the phase by up to " << maximumError << "." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    // A start which already meets MinimumEpsilon is written out as it is
+    UnwrapType::Pointer tight = UnwrapType::New();
+    tight->SetMaximumIterations( maximumIterations );
+    tight->SetMinimumEpsilon( 1e-2 * tight->GetMinimumEpsilon() );
+    tight->SetInput( frame );
+    tight->SetInitialSolution( previous );
+    tight->Update();
+
+    UnwrapType::Pointer converged = UnwrapType::New();
+    converged->SetMaximumIterations( maximumIterations );
+    converged->SetInput( frame );
+    converged->SetInitialSolution( tight->GetOutput() );
+    converged->Update();
+
+    std::cout << "Converged start:\tIterations: " << converged->GetElapsedIterations()
+              << "\tRelative residual: " << converged->GetRelativeResidual() << std::endl;
+
+    if ( 0 != converged->GetElapsedIterations() || !converged->GetConverged()
+      || !( converged->GetRelativeResidual() <= converged->GetMinimumEpsilon() ) )
+      {
+      std::cerr << "ERROR: A converged start took " << converged->GetElapsedIterations()
+                << " iterations." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    double maximumChange = 0.0;
+    ItType sIt(tight->GetOutput(), region);
+    ItType oIt(converged->GetOutput(), region);
+    for (sIt.GoToBegin(), oIt.GoToBegin(); !sIt.IsAtEnd(); ++sIt, ++oIt)
+      {
+      maximumChange = std::max( maximumChange, std::fabs( oIt.Get() - sIt.Get() ) );
+      }
+
+    if ( maximumChange > 1e-9 )
+      {
+      std::cerr << "ERROR: A converged start changed by up to " << maximumChange << "." << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  //////////////////////////////////
+  // A Flat Phase                 //
+  //////////////////////////////////
+
+    {
+    // Without a right hand side there is nothing to solve, and the solution
+    // is zero whatever the initial solution
+    ImageType::Pointer flat = ImageType::New();
+    flat->SetRegions( region );
+    flat->Allocate();
+    flat->FillBuffer( 1.0 );
+
+    UnwrapType::Pointer unwrapFlat = UnwrapType::New();
+    unwrapFlat->SetInput( flat );
+    unwrapFlat->SetInitialSolution( unwrap->GetOutput() );
+    unwrapFlat->Update();
+
+    if ( 0 != unwrapFlat->GetElapsedIterations() || !unwrapFlat->GetConverged() )
+      {
+      std::cerr << "ERROR: A flat phase took " << unwrapFlat->GetElapsedIterations()
+                << " iterations." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    ItType flatIt(unwrapFlat->GetOutput(), region);
+    for (flatIt.GoToBegin(); !flatIt.IsAtEnd(); ++flatIt)
+      {
+      if ( 0.0 != flatIt.Get() )
+        {
+        std::cerr << "ERROR: A flat phase unwrapped to " << flatIt.Get() << "." << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  //////////////////////////////////
+  // An Oblique Image             //
+  //////////////////////////////////
+
+    {
+    // The geometry is carried through the work images, and does not change
+    // the solution, which is computed in index units
+    ImageType::DirectionType direction;
+    direction[0][0] = 0.6;
+    direction[0][1] = -0.8;
+    direction[1][0] = 0.8;
+    direction[1][1] = 0.6;
+
+    ImageType::Pointer oblique = ImageType::New();
+    oblique->Graft( wrapped );
+    oblique->SetDirection( direction );
+
+    for (unsigned int mixedPrecision = 0; mixedPrecision < 2; ++mixedPrecision)
+      {
+      UnwrapType::Pointer obliqueUnwrap = UnwrapType::New();
+      obliqueUnwrap->SetMaximumIterations( 50 );
+      obliqueUnwrap->SetMixedPrecision( mixedPrecision );
+      obliqueUnwrap->SetInput( oblique );
+      obliqueUnwrap->Update();
+
+      UnwrapType::Pointer alignedUnwrap = UnwrapType::New();
+      alignedUnwrap->SetMaximumIterations( 50 );
+      alignedUnwrap->SetMixedPrecision( mixedPrecision );
+      alignedUnwrap->SetInput( wrapped );
+      alignedUnwrap->Update();
+
+      double maximumDifference = 0.0;
+      ItType oIt(obliqueUnwrap->GetOutput(), region);
+      ItType aIt(alignedUnwrap->GetOutput(), region);
+      for (oIt.GoToBegin(), aIt.GoToBegin(); !oIt.IsAtEnd(); ++oIt, ++aIt)
+        {
+        maximumDifference = std::max( maximumDifference, std::fabs( oIt.Get() - aIt.Get() ) );
+        }
+
+      if ( maximumDifference > 0.0 || obliqueUnwrap->GetOutput()->GetDirection() != direction )
+        {
+        std::cerr << "ERROR: The oblique image was unwrapped differently, by up to "
+                  << maximumDifference << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  //////////////////////////////////
+  // Mixed Precision Convergence  //
+  //////////////////////////////////
+
+    {
+    UnwrapType::Pointer mixed = UnwrapType::New();
+    mixed->MixedPrecisionOn();
+    mixed->SetMaximumIterations( 50 );
+    mixed->SetInput( wrapped );
+    mixed->Update();
+
+    double maximumDifference = 0.0;
+    ItType dIt(unwrap->GetOutput(), region);
+    ItType mIt(mixed->GetOutput(), region);
+    for (dIt.GoToBegin(), mIt.GoToBegin(); !dIt.IsAtEnd(); ++dIt, ++mIt)
+      {
+      maximumDifference = std::max( maximumDifference, std::fabs( dIt.Get() - mIt.Get() ) );
+      }
+
+    const bool matches =
+      mixed->GetConverged() == unwrap->GetConverged()
+      && mixed->GetElapsedIterations() <= unwrap->GetElapsedIterations() + 1
+      && maximumDifference < 1e-3;
+
+    std::cout << "Mixed:\tIterations: " << mixed->GetElapsedIterations()
+              << "\tRelative residual: " << mixed->GetRelativeResidual()
+              << "\tConverged: " << (mixed->GetConverged() ? "Yes" : "No")
+              << "\tMaximum difference: " << maximumDifference
+              << "\tConvergence matches double: " << (matches ? "Yes" : "No") << std::endl;
+
+    if ( !matches )
+      {
+      std::cerr << "ERROR: The mixed precision solve did not converge like the double solve." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    // A solve cut short of MinimumEpsilon is not converged
+    mixed->SetMaximumIterations( 2 );
+    mixed->SetMinimumEpsilon( 1e-12 );
+    mixed->Update();
+    if ( mixed->GetConverged() || mixed->GetRelativeResidual() <= mixed->GetMinimumEpsilon() )
+      {
+      std::cerr << "ERROR: A solve stopped after " << mixed->GetElapsedIterations()
+                << " iterations, at a relative residual of " << mixed->GetRelativeResidual()
+                << ", was reported as converged." << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  //////////////////////////////////
+  // Q Has the Edge Weights of L  //
+  //////////////////////////////////
+
+    {
+    typedef itk::WrappedPhaseLaplacianImageFilter< ImageType, ImageType > LaplacianType;
+    typedef UnwrapType::OperatorType                                    OperatorType;
+
+    LaplacianType::Pointer laplacian = LaplacianType::New();
+    laplacian->SetInput( wrapped );
+    laplacian->SetWeighted( true );
+    laplacian->Update();
+
+    const OperatorType & q = unwrap->GetWeightedLaplacianOperator();
+    const OperatorType & l = laplacian->GetWeightedLaplacianOperator();
+
+    bool sameWeights = ( q.GetNumberOfPixels() == region.GetNumberOfPixels() );
+    for (unsigned int d = 0; sameWeights && d < 2; ++d)
+      {
+      for (itk::SizeValueType p = 0; p < q.GetNumberOfPixels(); ++p)
+        {
+        sameWeights = sameWeights && ( q.GetWeights( d )[p] == l.GetWeights( d )[p] );
+        }
+      }
+
+    // Q has the Neumann form, so it annihilates a constant
+    const std::vector< PixelType > ones( region.GetNumberOfPixels(), 1.0 );
+    std::vector< double > qOnes( size[0] );
+    double maximumQOnes = 0.0;
+    for (itk::IndexValueType y = 0; y < static_cast< itk::IndexValueType >( size[1] ); ++y)
+      {
+      const itk::IndexValueType lineIndex[2] = { 0, y };
+      q.ApplyToLine( &ones[0], y * size[0], lineIndex, size[0], OperatorType::Difference(), &qOnes[0] );
+      for (unsigned int x = 0; x < size[0]; ++x)
+        {
+        maximumQOnes = std::max( maximumQOnes, std::fabs( qOnes[x] ) );
+        }
+      }
+
+    std::cout << "Q:	Same weights as L: " << (sameWeights ? "Yes" : "No")
+              << "	Maximum of Q1: " << maximumQOnes << std::endl;
+
+    if ( !sameWeights || maximumQOnes > 1e-12 )
+      {
+      std::cerr << "ERROR: Q does not have the edge weights and null space of the weighted Laplacian." << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  ////////////
+  // Basics //
+  ////////////
+
+  EXERCISE_BASIC_OBJECT_METHODS( unwrap,
+                                 PCGPhaseUnwrappingImageFilter,
+                                 PhaseImageToImageFilter );
+
+  /////////////////////
+  // Set/Get Methods //
+  /////////////////////
+
+  TEST_SET_GET_VALUE( 50u, unwrap->GetMaximumIterations() );
+  TEST_SET_GET_VALUE( false, unwrap->GetMixedPrecision() );
+  unwrap->MixedPrecisionOn();
+  TEST_SET_GET_VALUE( true, unwrap->GetMixedPrecision() );
+  TEST_SET_GET_VALUE( UnwrapType::DCTPreconditioner, unwrap->GetPreconditioner() );
+  unwrap->SetPreconditioner( UnwrapType::MultigridPreconditioner );
+  TEST_SET_GET_VALUE( UnwrapType::MultigridPreconditioner, unwrap->GetPreconditioner() );
+
+  return EXIT_SUCCESS;
+
+}
@@ -0,0 +1,218 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkPCGPhaseUnwrappingImageFilter.h"
+#include "itkTestingMacros.h"
+#include "itkImageFileReader.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkTimeProbe.h"
+
+// Unwraps an SWI slice by PCG with each preconditioner, unmasked and under a
+// mask with holes of zero quality.  Every preconditioner must reach
+// MinimumEpsilon within MaximumIterations, the multigrid solution must match
+// the DCT preconditioned one, unmasked the DCT inverse of the unweighted Q
+// must take fewer iterations than Jacobi, and under the mask multigrid must
+// take fewer iterations than Jacobi.  The time of each solve is reported
+// alongside.
+int itkPCGPreconditionerTest(int argc, char *argv[])
+{
+
+  if (argc < 2 || argc > 3)
+    {
+    std::cerr << "Usage: " << argv[0] << " <wrapped_image> [repeats]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const unsigned int Dimension = 2;
+
+  typedef double                                                 PixelType;
+  typedef itk::Image< PixelType, Dimension >                     ImageType;
+  typedef itk::PCGPhaseUnwrappingImageFilter< ImageType >        UnwrapType;
+  typedef UnwrapType::MaskImageType                              MaskImageType;
+  typedef itk::ImageRegionIteratorWithIndex< MaskImageType >     MaskItType;
+  typedef itk::ImageRegionConstIterator< ImageType >             ItType;
+  typedef itk::ImageRegionConstIterator< MaskImageType >         MaskConstItType;
+  typedef itk::ImageFileReader< ImageType >                      ReaderType;
+
+  const unsigned int repeats = (3 == argc) ? atoi(argv[2]) : 3;
+  const unsigned int maximumIterations = 2000;
+  const double minimumEpsilon = 1e-6;
+
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( argv[1] );
+  reader->Update();
+
+  const ImageType::RegionType region = reader->GetOutput()->GetLargestPossibleRegion();
+  const ImageType::SizeType size = region.GetSize();
+
+  ////////////////////////
+  // Mask With Holes    //
+  ////////////////////////
+
+  // A grid of round holes, a tenth of the shorter side across, every fifth of
+  // each side
+  MaskImageType::Pointer mask = MaskImageType::New();
+  mask->CopyInformation( reader->GetOutput() );
+  mask->SetRegions( region );
+  mask->Allocate();
+
+  const double radius = 0.05 * std::min( size[0], size[1] );
+  MaskItType mIt( mask, region );
+  for (mIt.GoToBegin(); !mIt.IsAtEnd(); ++mIt)
+    {
+    const MaskImageType::IndexType i = mIt.GetIndex();
+    double x = std::fmod( 5.0 * i[0] / size[0], 1.0 ) - 0.5;
+    double y = std::fmod( 5.0 * i[1] / size[1], 1.0 ) - 0.5;
+    x *= size[0] / 5.0;
+    y *= size[1] / 5.0;
+    mIt.Set( ( x * x + y * y < radius * radius ) ? 0 : 1 );
+    }
+
+  ////////////////////////////////
+  // Converge With Each One     //
+  ////////////////////////////////
+
+  const unsigned int numberOfPreconditioners = 3;
+  const UnwrapType::PreconditionerEnumType preconditioners[numberOfPreconditioners] = {
+    UnwrapType::DCTPreconditioner,
+    UnwrapType::JacobiPreconditioner,
+    UnwrapType::MultigridPreconditioner };
+  const char * names[numberOfPreconditioners] = { "DCT", "Jacobi", "Multigrid" };
+
+  for (unsigned int masked = 0; masked < 2; ++masked)
+    {
+
+    std::cout << ( masked ? "Mask with holes:" : "Unmasked:" ) << std::endl;
+
+    UnwrapType::Pointer unwraps[numberOfPreconditioners];
+    for (unsigned int k = 0; k < numberOfPreconditioners; ++k)
+      {
+
+      unwraps[k] = UnwrapType::New();
+      unwraps[k]->SetInput( reader->GetOutput() );
+      if ( masked )
+        {
+        unwraps[k]->SetMaskImage( mask );
+        }
+      unwraps[k]->SetMaximumIterations( maximumIterations );
+      unwraps[k]->SetMinimumEpsilon( minimumEpsilon );
+      unwraps[k]->SetPreconditioner( preconditioners[k] );
+      TEST_SET_GET_VALUE( minimumEpsilon, unwraps[k]->GetMinimumEpsilon() );
+      TEST_SET_GET_VALUE( preconditioners[k], unwraps[k]->GetPreconditioner() );
+      unwraps[k]->Update(); // Plan outside of the timed region
+
+      itk::TimeProbe probe;
+      for (unsigned int r = 0; r < repeats; ++r)
+        {
+        unwraps[k]->Modified();
+        probe.Start();
+        unwraps[k]->Update();
+        probe.Stop();
+        }
+
+      const unsigned int iterations = unwraps[k]->GetElapsedIterations();
+      const double residual = unwraps[k]->GetRelativeResidual();
+
+      std::cout << "  " << names[k]
+                << "\tIterations: " << iterations
+                << "\tRelative residual: " << residual
+                << "\tTime: " << probe.GetMean() << " s"
+                << "\tPer iteration: " << probe.GetMean() / std::max( 1u, iterations ) << " s" << std::endl;
+
+      if ( !( residual <= minimumEpsilon ) || iterations > maximumIterations )
+        {
+        std::cerr << "ERROR: The " << names[k] << " preconditioned solve left a relative residual of "
+                  << residual << " after " << iterations << " iterations." << std::endl;
+        return EXIT_FAILURE;
+        }
+
+      }
+
+    // The solutions are compared where the mask is set, up to a constant,
+    // since the pixels of zero quality do not fix it
+    const ImageType * dct = unwraps[0]->GetOutput();
+    const ImageType * multigrid = unwraps[2]->GetOutput();
+
+    double count = 0.0;
+    double meanDifference = 0.0;
+    double meanSolution = 0.0;
+    ItType dIt( dct, region );
+    ItType gIt( multigrid, region );
+    MaskConstItType cIt( mask, region );
+    for (dIt.GoToBegin(), gIt.GoToBegin(), cIt.GoToBegin(); !dIt.IsAtEnd(); ++dIt, ++gIt, ++cIt)
+      {
+      if ( !masked || cIt.Get() )
+        {
+        count += 1.0;
+        meanDifference += gIt.Get() - dIt.Get();
+        meanSolution += dIt.Get();
+        }
+      }
+    meanDifference /= count;
+    meanSolution /= count;
+
+    double squaredDifference = 0.0;
+    double squaredSolution = 0.0;
+    for (dIt.GoToBegin(), gIt.GoToBegin(), cIt.GoToBegin(); !dIt.IsAtEnd(); ++dIt, ++gIt, ++cIt)
+      {
+      if ( !masked || cIt.Get() )
+        {
+        const double difference = gIt.Get() - dIt.Get() - meanDifference;
+        const double solution = dIt.Get() - meanSolution;
+        squaredDifference += difference * difference;
+        squaredSolution += solution * solution;
+        }
+      }
+    const double rmsDifference = std::sqrt( squaredDifference / count );
+    const double rmsSolution = std::sqrt( squaredSolution / count );
+
+    std::cout << "  RMS difference of the multigrid and DCT solutions: " << rmsDifference
+              << " (RMS solution " << rmsSolution << ")" << std::endl;
+
+    if ( !( rmsDifference <= 1e-2 * rmsSolution ) )
+      {
+      std::cerr << "ERROR: The multigrid and DCT preconditioned solutions differ by " << rmsDifference
+                << " RMS." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    // The unweighted inverse carries the residual across the image, which
+    // Jacobi does not
+    if ( !masked && unwraps[0]->GetElapsedIterations() >= unwraps[1]->GetElapsedIterations() )
+      {
+      std::cerr << "ERROR: DCT took " << unwraps[0]->GetElapsedIterations()
+                << " iterations, and Jacobi " << unwraps[1]->GetElapsedIterations()
+                << "." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    // Multigrid follows the holes, which Jacobi only sees locally
+    if ( masked && unwraps[2]->GetElapsedIterations() >= unwraps[1]->GetElapsedIterations() )
+      {
+      std::cerr << "ERROR: Multigrid took " << unwraps[2]->GetElapsedIterations()
+                << " iterations under the mask, and Jacobi " << unwraps[1]->GetElapsedIterations()
+                << "." << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    }
+
+  return EXIT_SUCCESS;
+
+}
@@ -0,0 +1,204 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkDCTPhaseUnwrappingImageFilter.h"
+#include "itkPCGPhaseUnwrappingImageFilter.h"
+#include "itkTestingMacros.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkWrapPhaseSymmetricFunctor.h"
+
+namespace
+{
+
+// Checks that a masked unwrap keeps the input region, is zero outside the mask
+// and has no wraps between neighbouring pixels of the mask.
+template< typename TImage, typename TMask >
+bool
+CheckMaskedSolution( const TImage * output, const TMask * mask, const char * name )
+{
+
+  typedef itk::ImageRegionConstIteratorWithIndex< TImage > ItType;
+
+  if ( output->GetLargestPossibleRegion() != mask->GetLargestPossibleRegion() )
+    {
+    std::cerr << "ERROR: The " << name << " output region differs from the input region." << std::endl;
+    return false;
+    }
+
+  const typename TImage::RegionType region = output->GetLargestPossibleRegion();
+
+  unsigned int numberOfNonzeros = 0;
+  unsigned int numberOfWraps = 0;
+  ItType it( output, region );
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+    const typename TImage::IndexType index = it.GetIndex();
+    if ( !mask->GetPixel( index ) )
+      {
+      if ( 0 != it.Get() )
+        {
+        ++numberOfNonzeros;
+        }
+      continue;
+      }
+    for (unsigned int d = 0; d < TImage::ImageDimension; ++d)
+      {
+      typename TImage::IndexType next = index;
+      ++next[d];
+      if ( region.IsInside( next ) && mask->GetPixel( next )
+           && std::fabs( it.Get() - output->GetPixel( next ) ) >= vnl_math::pi )
+        {
+        ++numberOfWraps;
+        }
+      }
+    }
+
+  if ( 0 < numberOfNonzeros )
+    {
+    std::cerr << "ERROR: The " << name << " output has " << numberOfNonzeros
+              << " nonzero pixels outside the mask." << std::endl;
+    return false;
+    }
+
+  if ( 0 < numberOfWraps )
+    {
+    std::cerr << "ERROR: " << numberOfWraps << " wraps were found in the " << name << " output." << std::endl;
+    return false;
+    }
+
+  return true;
+
+}
+
+}
+
+int itkPhaseUnwrappingMaskTest(int argc, char *argv[])
+{
+
+  if (argc != 1)
+    {
+    std::cerr << "Usage: " << argv[0] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////
+  // Typedefs //
+  //////////////
+
+  typedef double                                                 PixelType;
+  typedef itk::Image< PixelType, 2 >                             ImageType;
+  typedef itk::DCTPhaseUnwrappingImageFilter< ImageType >        DCTType;
+  typedef itk::PCGPhaseUnwrappingImageFilter< ImageType >        PCGType;
+  typedef DCTType::MaskImageType                                 MaskType;
+  typedef itk::ImageRegionIteratorWithIndex< ImageType >         ItType;
+  typedef itk::ImageRegionIteratorWithIndex< MaskType >          MaskItType;
+  typedef itk::Functor::WrapPhaseSymmetricFunctor< PixelType >   WrapType;
+
+  WrapType wrap;
+
+  ///////////////////////////////////
+  // A Disc in a Field of Noise    //
+  ///////////////////////////////////
+
+  // The disc covers a small part of the image, and the background is noise,
+  // which would leave residues in the solve were it not cropped away
+  const ImageType::IndexType index = {{0,0}};
+  const ImageType::SizeType size = {{96,80}};
+  const ImageType::RegionType region(index,size);
+
+  ImageType::Pointer wrapped = ImageType::New();
+  wrapped->SetRegions( region );
+  wrapped->Allocate();
+
+  MaskType::Pointer mask = MaskType::New();
+  mask->SetRegions( region );
+  mask->Allocate();
+
+  ItType wIt(wrapped, region);
+  MaskItType mIt(mask, region);
+  unsigned int seed = 1;
+  for (wIt.GoToBegin(), mIt.GoToBegin(); !wIt.IsAtEnd(); ++wIt, ++mIt)
+    {
+    const ImageType::IndexType i = wIt.GetIndex();
+    const double x = i[0] - 30.0;
+    const double y = i[1] - 50.0;
+    const bool inside = x * x + y * y <= 14.0 * 14.0;
+    seed = 1103515245u * seed + 12345u;
+    const double noise = 2 * vnl_math::pi * ( seed >> 16 ) / 65536.0;
+    wIt.Set( wrap( inside ? 0.01 * ( x * x + y * y ) + i[0] / 4.0 : noise ) );
+    mIt.Set( inside ? 1 : 0 );
+    }
+
+  ////////////////////////
+  // DCT, Cropped       //
+  ////////////////////////
+
+  DCTType::Pointer dct = DCTType::New();
+  TEST_SET_GET_VALUE( 2u, dct->GetMaskMargin() );
+  dct->SetMaskMargin( 3 );
+  TEST_SET_GET_VALUE( 3u, dct->GetMaskMargin() );
+  dct->SetInput( wrapped );
+  dct->SetMaskImage( mask );
+  dct->Update();
+
+  if ( !CheckMaskedSolution( dct->GetOutput(), mask.GetPointer(), "DCT" ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // The out-of-core solve does not crop
+  dct->SetMemoryBudget( 1 << 20 );
+  TRY_EXPECT_EXCEPTION( dct->Update() );
+  dct->SetMemoryBudget( 0 );
+
+  ////////////////////////
+  // PCG, Cropped       //
+  ////////////////////////
+
+  PCGType::Pointer pcg = PCGType::New();
+  TEST_SET_GET_VALUE( 2u, pcg->GetMaskMargin() );
+  pcg->SetMaximumIterations( 20 );
+  pcg->SetInput( wrapped );
+  pcg->SetMaskImage( mask );
+  pcg->Update();
+
+  if ( !CheckMaskedSolution( pcg->GetOutput(), mask.GetPointer(), "PCG" ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  ////////////////////////
+  // Empty Mask         //
+  ////////////////////////
+
+  MaskType::Pointer empty = MaskType::New();
+  empty->SetRegions( region );
+  empty->Allocate();
+  empty->FillBuffer( 0 );
+
+  dct->SetMaskImage( empty );
+  dct->Update();
+
+  if ( !CheckMaskedSolution( dct->GetOutput(), empty.GetPointer(), "empty mask" ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+
+}
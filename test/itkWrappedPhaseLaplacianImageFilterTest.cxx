@@ -108,6 +108,76 @@ int itkWrappedPhaseLaplacianImageFilterTest(int argc, char *argv[])
     return EXIT_FAILURE;
     }
 
+  //////////////////
+  // Sum and Mean //
+  //////////////////
+
+  double sum = 0.0;
+  ItType sIt(wrappedLaplacian->GetOutput(), region);
+  for (sIt.GoToBegin(); !sIt.IsAtEnd(); ++sIt)
+    {
+    sum += sIt.Get();
+    }
+
+  if (std::fabs(sum - wrappedLaplacian->GetSum()) > 10e-6
+      || std::fabs(sum/region.GetNumberOfPixels() - wrappedLaplacian->GetMean()) > 10e-6)
+    {
+    std::cerr << "ERROR: Sum " << wrappedLaplacian->GetSum()
+              << " and mean " << wrappedLaplacian->GetMean()
+              << " do not match the output sum " << sum << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ///////////////////////
+  // Weighted Laplacian //
+  ///////////////////////
+
+    {
+    WrappedLaplacianType::Pointer weighted = WrappedLaplacianType::New();
+    weighted->SetInput( wrapped );
+    weighted->SetWeighted( true );
+    weighted->SetNumberOfThreads( 3 );
+    weighted->Update();
+
+    // Each difference weighted by min(q_c^2, q_n^2), and none leaving the image
+    const ImageType * quality = weighted->GetQualityImage();
+    unsigned int misses = 0;
+    ItType oIt(weighted->GetOutput(), region);
+    for (oIt.GoToBegin(); !oIt.IsAtEnd(); ++oIt)
+      {
+      const ImageType::IndexType c = oIt.GetIndex();
+      const double qc = quality->GetPixel( c ) * quality->GetPixel( c );
+      double expected = 0.0;
+      for (unsigned int d = 0; d < Dimension; ++d)
+        {
+        for (int step = -1; step <= 1; step += 2)
+          {
+          ImageType::IndexType n = c;
+          n[d] += step;
+          if ( !region.IsInside( n ) )
+            {
+            continue;
+            }
+          const double qn = quality->GetPixel( n ) * quality->GetPixel( n );
+          const double difference = wrapped->GetPixel( n ) - wrapped->GetPixel( c );
+          expected += std::min( qc, qn ) * vnl_math::angle_minuspi_to_pi( difference );
+          }
+        }
+      if (std::fabs(expected - oIt.Get()) > 10e-6)
+        {
+        ++misses;
+        }
+      }
+
+    // The symmetric form sums to zero over the image
+    if (0 < misses || std::fabs(weighted->GetSum()) > 10e-6)
+      {
+      std::cerr << "ERROR: " << misses << " pixels of the weighted Laplacian are wrong, and its sum is "
+                << weighted->GetSum() << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
   ////////////
   // Basics //
   ////////////